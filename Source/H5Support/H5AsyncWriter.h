@@ -0,0 +1,351 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5MemoryBudget.h"
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5AsyncWriter class moves HDF5 writes off the calling thread. It owns one
+ * I/O thread that performs the queued writes in the order they were submitted, so the
+ * caller can keep computing while the previous results are written. The queue is
+ * bounded: submitting blocks while it is full, which keeps the memory held by pending
+ * buffers in check.
+ *
+ * The data of a write is moved or copied into the queue, so the caller may reuse its
+ * buffers right away. Queued data is reserved against H5MemoryBudget::global() until it
+ * has been written; a write whose data cannot be reserved fails without being queued.
+ * The file and group ids passed in have to stay open until the write has finished.
+ * Unless the HDF5 library is thread-safe the caller must not make HDF5 calls of its
+ * own while writes are pending; call drain() first.
+ */
+class H5AsyncWriter
+{
+public:
+  /**
+   * @brief Starts the I/O thread
+   * @param queueCapacity Maximum number of writes waiting in the queue. Zero is treated as one.
+   */
+  explicit H5AsyncWriter(size_t queueCapacity = 16)
+  : m_Capacity(std::max<size_t>(queueCapacity, 1))
+  {
+    m_Thread = std::thread([this]() { run(); });
+  }
+
+  /**
+   * @brief Finishes all queued writes and stops the I/O thread
+   */
+  ~H5AsyncWriter()
+  {
+    drain();
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stopping = true;
+    }
+    m_TaskAvailable.notify_all();
+    m_Thread.join();
+  }
+
+  H5AsyncWriter(const H5AsyncWriter&) = delete;            // Copy Constructor Not Implemented
+  H5AsyncWriter(H5AsyncWriter&&) = delete;                 // Move Constructor Not Implemented
+  H5AsyncWriter& operator=(const H5AsyncWriter&) = delete; // Copy Assignment Not Implemented
+  H5AsyncWriter& operator=(H5AsyncWriter&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Queues any operation that returns a HDF5 error condition. Blocks while the queue is full.
+   * @param operation The callable to run on the I/O thread
+   * @return A future that holds the error condition of the operation
+   */
+  template <typename Func>
+  std::future<herr_t> submit(Func&& operation)
+  {
+    auto promise = std::make_shared<std::promise<herr_t>>();
+    std::future<herr_t> result = promise->get_future();
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_SpaceAvailable.wait(lock, [this]() { return m_Tasks.size() < m_Capacity; });
+      m_Tasks.emplace_back([promise, operation = std::forward<Func>(operation)]() mutable {
+        herr_t error = operation();
+        promise->set_value(error);
+        return error;
+      });
+    }
+    m_TaskAvailable.notify_one();
+    return result;
+  }
+
+  /**
+   * @brief Queues H5Lite::writeVectorDataset. The data is moved into the queue.
+   * @param locationID
+   * @param datasetName
+   * @param dims
+   * @param data
+   * @param options
+   * @return A future that holds the error condition of the write
+   */
+  template <typename T>
+  std::future<herr_t> writeVectorDataset(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, std::vector<T>&& data,
+                                         const H5Lite::DatasetCreationOptions& options = H5Lite::DatasetCreationOptions())
+  {
+    auto reservation = reserve(data.size() * sizeof(T));
+    return queueVectorDataset(reservation, locationID, datasetName, dims, std::move(data), options);
+  }
+
+  /**
+   * @brief Queues H5Lite::writeVectorDataset with a copy of the data
+   * @param locationID
+   * @param datasetName
+   * @param dims
+   * @param data
+   * @param options
+   * @return A future that holds the error condition of the write
+   */
+  template <typename T>
+  std::future<herr_t> writeVectorDataset(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, const std::vector<T>& data,
+                                         const H5Lite::DatasetCreationOptions& options = H5Lite::DatasetCreationOptions())
+  {
+    auto reservation = reserve(data.size() * sizeof(T));
+    return reservation ? queueVectorDataset(reservation, locationID, datasetName, dims, std::vector<T>(data), options) : rejected();
+  }
+
+  /**
+   * @brief Queues H5Lite::writePointerDataset with a copy of the data
+   * @param locationID
+   * @param datasetName
+   * @param rank
+   * @param dims
+   * @param data
+   * @param options
+   * @return A future that holds the error condition of the write
+   */
+  template <typename T>
+  std::future<herr_t> writePointerDataset(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data,
+                                          const H5Lite::DatasetCreationOptions& options = H5Lite::DatasetCreationOptions())
+  {
+    std::vector<hsize_t> datasetDims(dims, dims + rank);
+    size_t numElements = std::accumulate(datasetDims.begin(), datasetDims.end(), static_cast<size_t>(1), std::multiplies<size_t>());
+    auto reservation = reserve(numElements * sizeof(T));
+    return reservation ? queueVectorDataset(reservation, locationID, datasetName, datasetDims, std::vector<T>(data, data + numElements), options) : rejected();
+  }
+
+  /**
+   * @brief Queues H5Lite::writeVectorDatasetCompressed. The data is moved into the queue.
+   * @param locationID
+   * @param datasetName
+   * @param dims
+   * @param data
+   * @param cDims The chunk dimensions
+   * @param compressionLevel
+   * @param options
+   * @return A future that holds the error condition of the write
+   */
+  template <typename T>
+  std::future<herr_t> writeVectorDatasetCompressed(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, std::vector<T>&& data, const std::vector<hsize_t>& cDims,
+                                                   int32_t compressionLevel, const H5Lite::DatasetCreationOptions& options = H5Lite::DatasetCreationOptions())
+  {
+    auto reservation = reserve(data.size() * sizeof(T));
+    return queueVectorDatasetCompressed(reservation, locationID, datasetName, dims, std::move(data), cDims, compressionLevel, options);
+  }
+
+  /**
+   * @brief Queues H5Lite::writeVectorDatasetCompressed with a copy of the data
+   * @param locationID
+   * @param datasetName
+   * @param dims
+   * @param data
+   * @param cDims The chunk dimensions
+   * @param compressionLevel
+   * @param options
+   * @return A future that holds the error condition of the write
+   */
+  template <typename T>
+  std::future<herr_t> writeVectorDatasetCompressed(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, const std::vector<T>& data, const std::vector<hsize_t>& cDims,
+                                                   int32_t compressionLevel, const H5Lite::DatasetCreationOptions& options = H5Lite::DatasetCreationOptions())
+  {
+    auto reservation = reserve(data.size() * sizeof(T));
+    return reservation ? queueVectorDatasetCompressed(reservation, locationID, datasetName, dims, std::vector<T>(data), cDims, compressionLevel, options) : rejected();
+  }
+
+  /**
+   * @brief Waits until every queued write has finished
+   * @return Negative if any write that finished since the last drain() failed
+   */
+  herr_t drain()
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Idle.wait(lock, [this]() { return m_Tasks.empty() && !m_Busy; });
+    herr_t error = m_Error;
+    m_Error = 0;
+    return error;
+  }
+
+  /**
+   * @brief Waits until every queued write has finished and then flushes the file
+   * @param fileID Any object in the file to flush
+   * @return Negative if any write since the last drain() or the flush failed
+   */
+  herr_t flush(hid_t fileID)
+  {
+    submit([fileID]() { return H5Fflush(fileID, H5F_SCOPE_LOCAL); });
+    return drain();
+  }
+
+  /**
+   * @brief Returns the number of writes that are queued or running
+   * @return
+   */
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Tasks.size() + (m_Busy ? 1 : 0);
+  }
+
+private:
+  size_t m_Capacity = 1;
+  std::deque<std::function<herr_t()>> m_Tasks;
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_TaskAvailable;
+  std::condition_variable m_SpaceAvailable;
+  std::condition_variable m_Idle;
+  std::thread m_Thread;
+  herr_t m_Error = 0;
+  bool m_Busy = false;
+  bool m_Stopping = false;
+
+  /**
+   * @brief Reserves the size of queued data against the global memory budget
+   * @return The reservation, or nullptr if the bytes could not be reserved
+   */
+  static std::shared_ptr<H5MemoryBudget::Reservation> reserve(size_t bytes)
+  {
+    auto reservation = std::make_shared<H5MemoryBudget::Reservation>(bytes);
+    return reservation->isValid() ? reservation : nullptr;
+  }
+
+  /**
+   * @brief Returns the result of a write that was not queued
+   */
+  static std::future<herr_t> rejected()
+  {
+    std::promise<herr_t> promise;
+    promise.set_value(-1);
+    return promise.get_future();
+  }
+
+  template <typename T>
+  std::future<herr_t> queueVectorDataset(std::shared_ptr<H5MemoryBudget::Reservation> reservation, hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims,
+                                         std::vector<T>&& data, const H5Lite::DatasetCreationOptions& options)
+  {
+    if(!reservation)
+    {
+      return rejected();
+    }
+    return submit([locationID, datasetName, dims, data = std::move(data), options, reservation]() {
+      herr_t error = H5Lite::writeVectorDataset(locationID, datasetName, dims, data, options);
+      reservation->release();
+      return error;
+    });
+  }
+
+  template <typename T>
+  std::future<herr_t> queueVectorDatasetCompressed(std::shared_ptr<H5MemoryBudget::Reservation> reservation, hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims,
+                                                   std::vector<T>&& data, const std::vector<hsize_t>& cDims, int32_t compressionLevel, const H5Lite::DatasetCreationOptions& options)
+  {
+    if(!reservation)
+    {
+      return rejected();
+    }
+    return submit([locationID, datasetName, dims, data = std::move(data), cDims, compressionLevel, options, reservation]() {
+      herr_t error = H5Lite::writeVectorDatasetCompressed(locationID, datasetName, dims, data, cDims, compressionLevel, options);
+      reservation->release();
+      return error;
+    });
+  }
+
+  void run()
+  {
+    while(true)
+    {
+      std::function<herr_t()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_TaskAvailable.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+        if(m_Tasks.empty())
+        {
+          return;
+        }
+        task = std::move(m_Tasks.front());
+        m_Tasks.pop_front();
+        m_Busy = true;
+      }
+      m_SpaceAvailable.notify_one();
+      herr_t error = task();
+      if(error < 0)
+      {
+        // The error stack is per thread; leaving it filled on the I/O thread keeps HDF5 from shutting down cleanly
+        H5Eclear2(H5E_DEFAULT);
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Error = std::min(m_Error, error);
+        m_Busy = false;
+      }
+      m_Idle.notify_all();
+    }
+  }
+};
+
+}; // namespace H5Support
@@ -0,0 +1,189 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5BulkLoadSession class speeds up creating large numbers of small groups,
+ * datasets and attributes in one file. While the session is alive the metadata cache of
+ * the file is held at a large fixed size with evictions turned off, so nothing is written
+ * to disk until the session ends, and new datasets get minimized object headers. When the
+ * session goes out of scope the file is flushed once and the previous cache settings
+ * are restored.
+ *
+ * The cache is allowed to grow past its size while evictions are off, so the memory
+ * used by the session grows with the amount of metadata created in it.
+ */
+class H5BulkLoadSession
+{
+public:
+  /**
+   * @brief Session settings
+   */
+  struct Config
+  {
+    size_t cacheSize = 64 * 1024 * 1024; // Size the metadata cache is fixed at during the session (at most 128 MB)
+    bool minimizeObjectHeaders = true;   // Create datasets without space reserved for attributes
+  };
+
+  /**
+   * @brief Puts the file into bulk load mode with the default settings
+   * @param fileID The file to load objects into. The session does not take ownership.
+   */
+  explicit H5BulkLoadSession(hid_t fileID)
+  : H5BulkLoadSession(fileID, Config())
+  {
+  }
+
+  /**
+   * @brief Puts the file into bulk load mode
+   * @param fileID The file to load objects into. The session does not take ownership.
+   * @param config
+   */
+  H5BulkLoadSession(hid_t fileID, const Config& config)
+  : m_FileID(fileID)
+  {
+    m_SavedCacheConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    if(H5Fget_mdc_config(m_FileID, &m_SavedCacheConfig) < 0)
+    {
+      std::cout << "H5BulkLoadSession: Error reading the metadata cache configuration" << std::endl;
+      return;
+    }
+    H5Fget_mdc_size(m_FileID, &m_SavedCacheSize, nullptr, nullptr, nullptr);
+
+    // HDF5 rejects metadata cache sizes above 128 MB
+    const size_t cacheSize = std::min<size_t>(config.cacheSize, 128 * 1024 * 1024);
+    H5AC_cache_config_t cacheConfig = m_SavedCacheConfig;
+    cacheConfig.set_initial_size = 1;
+    cacheConfig.initial_size = cacheSize;
+    cacheConfig.min_size = std::min(cacheConfig.min_size, cacheSize);
+    cacheConfig.max_size = std::max(cacheConfig.max_size, cacheSize);
+    cacheConfig.incr_mode = H5C_incr__off;
+    cacheConfig.flash_incr_mode = H5C_flash_incr__off;
+    cacheConfig.decr_mode = H5C_decr__off;
+    cacheConfig.evictions_enabled = 0;
+    if(H5Fset_mdc_config(m_FileID, &cacheConfig) < 0)
+    {
+      std::cout << "H5BulkLoadSession: Error configuring the metadata cache" << std::endl;
+      return;
+    }
+    m_Active = true;
+
+#if H5_VERSION_GE(1, 10, 5)
+    if(config.minimizeObjectHeaders)
+    {
+      hbool_t minimize = 0;
+      H5Fget_dset_no_attrs_hint(m_FileID, &minimize);
+      m_SavedMinimizeHeaders = (minimize != 0);
+      m_RestoreMinimizeHeaders = (H5Fset_dset_no_attrs_hint(m_FileID, 1) >= 0);
+    }
+#endif
+  }
+
+  ~H5BulkLoadSession()
+  {
+    end();
+  }
+
+  H5BulkLoadSession(const H5BulkLoadSession&) = delete;            // Copy Constructor Not Implemented
+  H5BulkLoadSession(H5BulkLoadSession&&) = delete;                 // Move Constructor Not Implemented
+  H5BulkLoadSession& operator=(const H5BulkLoadSession&) = delete; // Copy Assignment Not Implemented
+  H5BulkLoadSession& operator=(H5BulkLoadSession&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Returns true if the file is in bulk load mode
+   * @return
+   */
+  bool isActive() const
+  {
+    return m_Active;
+  }
+
+  /**
+   * @brief Ends the session before the object goes out of scope: flushes the file and
+   * restores the previous settings. Calling it more than once has no effect.
+   * @return Standard HDF5 error condition
+   */
+  herr_t end()
+  {
+    if(!m_Active)
+    {
+      return 0;
+    }
+    m_Active = false;
+
+    herr_t error = H5Fflush(m_FileID, H5F_SCOPE_LOCAL);
+    if(error < 0)
+    {
+      std::cout << "H5BulkLoadSession: Error flushing the file" << std::endl;
+    }
+#if H5_VERSION_GE(1, 10, 5)
+    if(m_RestoreMinimizeHeaders && H5Fset_dset_no_attrs_hint(m_FileID, m_SavedMinimizeHeaders ? 1 : 0) < 0)
+    {
+      error = -1;
+    }
+#endif
+    H5AC_cache_config_t cacheConfig = m_SavedCacheConfig;
+    cacheConfig.set_initial_size = 1;
+    cacheConfig.initial_size = std::max(cacheConfig.min_size, std::min(m_SavedCacheSize, cacheConfig.max_size));
+    if(H5Fset_mdc_config(m_FileID, &cacheConfig) < 0)
+    {
+      std::cout << "H5BulkLoadSession: Error restoring the metadata cache configuration" << std::endl;
+      error = -1;
+    }
+    return error;
+  }
+
+private:
+  hid_t m_FileID = -1;
+  bool m_Active = false;
+  bool m_SavedMinimizeHeaders = false;
+  bool m_RestoreMinimizeHeaders = false;
+  size_t m_SavedCacheSize = 0;
+  H5AC_cache_config_t m_SavedCacheConfig = {};
+};
+
+}; // namespace H5Support
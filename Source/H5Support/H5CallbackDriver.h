@@ -0,0 +1,338 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Support.h"
+
+#ifdef H5Support_USE_QT
+#include <QtCore/QIODevice>
+#endif
+
+namespace H5Support
+{
+
+/**
+ * @brief Read only HDF5 virtual file driver that gets its bytes from user supplied
+ * callbacks instead of the file system. This allows HDF5 files that live inside an
+ * archive, an embedded resource or any other random access byte source to be opened
+ * without extracting them to disk first. The file name given to H5Fopen is only used
+ * by HDF5 for reporting.
+ *
+ * Adapters are provided for std::istream and, when Qt support is enabled, QIODevice.
+ */
+namespace H5CallbackDriver
+{
+
+/**
+ * @brief Driver settings stored in the file access property list
+ */
+struct Config
+{
+  // Copies size bytes starting at offset into buffer. Negative value is error.
+  std::function<herr_t(uint64_t offset, size_t size, void* buffer)> read;
+  // Returns the total number of bytes in the source
+  std::function<uint64_t()> size;
+};
+
+namespace detail
+{
+
+inline constexpr haddr_t k_MaxAddress = (static_cast<haddr_t>(1) << 63) - 1;
+
+/**
+ * @brief Per-file driver state. The H5FD_t member must stay first so HDF5 can
+ * treat a pointer to this struct as a pointer to its public file struct.
+ */
+struct File
+{
+  H5FD_t pub;
+  haddr_t eoa;
+  haddr_t eof;
+  Config* config;
+};
+
+inline File* toFile(H5FD_t* file)
+{
+  return reinterpret_cast<File*>(file);
+}
+
+inline const File* toFile(const H5FD_t* file)
+{
+  return reinterpret_cast<const File*>(file);
+}
+
+inline void* faplGet(H5FD_t* file)
+{
+  return new Config(*toFile(file)->config);
+}
+
+inline void* faplCopy(const void* fapl)
+{
+  return new Config(*reinterpret_cast<const Config*>(fapl));
+}
+
+inline herr_t faplFree(void* fapl)
+{
+  delete reinterpret_cast<Config*>(fapl);
+  return 0;
+}
+
+inline H5FD_t* open(const char* /*name*/, unsigned flags, hid_t fapl, haddr_t maxaddr)
+{
+  if((flags & (H5F_ACC_RDWR | H5F_ACC_TRUNC | H5F_ACC_CREAT)) != 0 || maxaddr == 0 || maxaddr == HADDR_UNDEF)
+  {
+    return nullptr;
+  }
+  const void* driverInfo = H5Pget_driver_info(fapl);
+  if(driverInfo == nullptr)
+  {
+    return nullptr;
+  }
+  const auto& config = *reinterpret_cast<const Config*>(driverInfo);
+  if(!config.read || !config.size)
+  {
+    return nullptr;
+  }
+
+  File* file = new File{};
+  file->config = new Config(config);
+  file->eof = static_cast<haddr_t>(config.size());
+  return &file->pub;
+}
+
+inline herr_t close(H5FD_t* h5File)
+{
+  File* file = toFile(h5File);
+  delete file->config;
+  delete file;
+  return 0;
+}
+
+inline int compare(const H5FD_t* h5File1, const H5FD_t* h5File2)
+{
+  // Every source is treated as a distinct file
+  if(h5File1 == h5File2)
+  {
+    return 0;
+  }
+  return std::less<const H5FD_t*>()(h5File1, h5File2) ? -1 : 1;
+}
+
+inline herr_t query(const H5FD_t* /*file*/, unsigned long* flags)
+{
+  if(flags != nullptr)
+  {
+    *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA;
+  }
+  return 0;
+}
+
+inline haddr_t getEoa(const H5FD_t* file, H5FD_mem_t /*type*/)
+{
+  return toFile(file)->eoa;
+}
+
+inline herr_t setEoa(H5FD_t* file, H5FD_mem_t /*type*/, haddr_t addr)
+{
+  toFile(file)->eoa = addr;
+  return 0;
+}
+
+inline haddr_t getEof(const H5FD_t* file, H5FD_mem_t /*type*/)
+{
+  return toFile(file)->eof;
+}
+
+inline herr_t read(H5FD_t* h5File, H5FD_mem_t /*type*/, hid_t /*dxpl*/, haddr_t addr, size_t size, void* buffer)
+{
+  File* file = toFile(h5File);
+  if(addr == HADDR_UNDEF || addr + size > file->eoa)
+  {
+    return -1;
+  }
+  // Bytes past the end of the source read back as zeros like they do with the sec2 driver
+  size_t available = addr < file->eof ? static_cast<size_t>(std::min<haddr_t>(size, file->eof - addr)) : 0;
+  if(available > 0 && file->config->read(addr, available, buffer) < 0)
+  {
+    return -1;
+  }
+  std::memset(reinterpret_cast<unsigned char*>(buffer) + available, 0, size - available);
+  return 0;
+}
+
+inline herr_t write(H5FD_t* /*file*/, H5FD_mem_t /*type*/, hid_t /*dxpl*/, haddr_t /*addr*/, size_t /*size*/, const void* /*buffer*/)
+{
+  return -1;
+}
+
+/**
+ * @brief Returns the class description registered with HDF5
+ */
+inline const H5FD_class_t& driverClass()
+{
+  static const H5FD_class_t s_Class = []() {
+    H5FD_class_t driver{};
+#if H5_VERSION_GE(1, 13, 2)
+    driver.version = H5FD_CLASS_VERSION;
+    driver.value = static_cast<H5FD_class_value_t>(H5SUPPORT_CALLBACK_DRIVER_VALUE);
+#endif
+    driver.name = "h5support_callback";
+    driver.maxaddr = k_MaxAddress;
+    driver.fc_degree = H5F_CLOSE_WEAK;
+    driver.fapl_size = sizeof(Config);
+    driver.fapl_get = faplGet;
+    driver.fapl_copy = faplCopy;
+    driver.fapl_free = faplFree;
+    driver.open = open;
+    driver.close = close;
+    driver.cmp = compare;
+    driver.query = query;
+    driver.get_eoa = getEoa;
+    driver.set_eoa = setEoa;
+    driver.get_eof = getEof;
+    driver.read = read;
+    driver.write = write;
+    const H5FD_mem_t freeListMap[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+    std::copy(freeListMap, freeListMap + H5FD_MEM_NTYPES, driver.fl_map);
+    return driver;
+  }();
+  return s_Class;
+}
+} // namespace detail
+
+/**
+ * @brief Registers the driver with HDF5 (once per library initialization) and returns its id
+ * @return The driver id. Negative value is error.
+ */
+inline hid_t driverID()
+{
+  static std::mutex s_Mutex;
+  static hid_t s_DriverID = -1;
+  std::lock_guard<std::mutex> lock(s_Mutex);
+  if(H5Iget_type(s_DriverID) != H5I_VFL)
+  {
+    s_DriverID = H5FDregister(&detail::driverClass());
+  }
+  return s_DriverID;
+}
+
+/**
+ * @brief Selects the callback driver on a file access property list
+ * @param fileAccessPropertyList The file access property list to modify
+ * @param config The read and size callbacks
+ * @return Standard HDF5 error condition
+ */
+inline herr_t setFileAccessProperties(hid_t fileAccessPropertyList, const Config& config)
+{
+  hid_t driver = driverID();
+  if(driver < 0)
+  {
+    return static_cast<herr_t>(driver);
+  }
+  return H5Pset_driver(fileAccessPropertyList, driver, &config);
+}
+
+/**
+ * @brief Creates callbacks that read from a seekable std::istream. The stream is
+ * shared by every copy of the callbacks and accesses to it are serialized.
+ * @param stream The stream to read from. It must support seekg and tellg.
+ * @return
+ */
+inline Config createStreamConfig(std::shared_ptr<std::istream> stream)
+{
+  auto mutex = std::make_shared<std::mutex>();
+  Config config;
+  config.read = [stream, mutex](uint64_t offset, size_t size, void* buffer) -> herr_t {
+    std::lock_guard<std::mutex> lock(*mutex);
+    stream->clear();
+    if(!stream->seekg(static_cast<std::streamoff>(offset), std::ios::beg))
+    {
+      return -1;
+    }
+    stream->read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size));
+    return stream->gcount() == static_cast<std::streamsize>(size) ? 0 : -1;
+  };
+  config.size = [stream, mutex]() -> uint64_t {
+    std::lock_guard<std::mutex> lock(*mutex);
+    stream->clear();
+    stream->seekg(0, std::ios::end);
+    std::streamoff end = stream->tellg();
+    return end < 0 ? 0 : static_cast<uint64_t>(end);
+  };
+  return config;
+}
+
+#ifdef H5Support_USE_QT
+/**
+ * @brief Creates callbacks that read from an open, random access QIODevice such as a
+ * QFile, QBuffer or Qt resource file. The caller must keep the device open for as long
+ * as the HDF5 file is open.
+ * @param device The device to read from
+ * @return
+ */
+inline Config createDeviceConfig(QIODevice* device)
+{
+  auto mutex = std::make_shared<std::mutex>();
+  Config config;
+  config.read = [device, mutex](uint64_t offset, size_t size, void* buffer) -> herr_t {
+    std::lock_guard<std::mutex> lock(*mutex);
+    if(!device->seek(static_cast<qint64>(offset)))
+    {
+      return -1;
+    }
+    return device->read(reinterpret_cast<char*>(buffer), static_cast<qint64>(size)) == static_cast<qint64>(size) ? 0 : -1;
+  };
+  config.size = [device, mutex]() -> uint64_t {
+    std::lock_guard<std::mutex> lock(*mutex);
+    return static_cast<uint64_t>(device->size());
+  };
+  return config;
+}
+#endif
+
+} // namespace H5CallbackDriver
+
+}; // namespace H5Support
@@ -0,0 +1,425 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Support.h"
+#include "H5Support/H5Utilities.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5FilePool class keeps files open read-only between uses so that code which opens
+ * the same files over and over skips the cost of opening them. Files are found by their canonical
+ * path and handed out as leases. A file stays open while it is leased; once it is idle it may be
+ * closed again to keep the pool within its capacity, least recently used first.
+ *
+ * Every acquire compares the modification time, size and inode of the file with the ones it had
+ * when it was opened. A file that was replaced by a new one is opened again; leases on the old
+ * file keep working until they are released. A file rewritten in place keeps its inode, and HDF5
+ * would hand back the file it already has open together with its stale metadata, so such a file
+ * can only be acquired again once all leases on it are released. Until then acquire fails. The
+ * same holds for files that are open in HDF5 outside of the pool. All methods may be called from
+ * any thread, and the pool is not locked while a file is being opened, but the pool must outlive
+ * its leases.
+ */
+class H5FilePool
+{
+  struct Entry;
+
+public:
+  /**
+   * @brief Counters describing how well the pool is working
+   */
+  struct Statistics
+  {
+    size_t hits = 0;      // Acquires served by a file that was already open
+    size_t misses = 0;    // Acquires that had to open the file
+    size_t evictions = 0; // Idle files closed to stay within the capacity
+    size_t reopens = 0;   // Files opened again because they changed on disk
+  };
+
+  /**
+   * @brief A file that was handed out by the pool. The file goes back to the pool when
+   * the lease is released or destroyed.
+   */
+  class Lease
+  {
+  public:
+    Lease() = default;
+
+    ~Lease()
+    {
+      release();
+    }
+
+    Lease(const Lease&) = delete;            // Copy Constructor Not Implemented
+    Lease& operator=(const Lease&) = delete; // Copy Assignment Not Implemented
+
+    Lease(Lease&& other) noexcept
+    : m_Pool(other.m_Pool)
+    , m_Entry(other.m_Entry)
+    {
+      other.m_Pool = nullptr;
+      other.m_Entry = nullptr;
+    }
+
+    Lease& operator=(Lease&& other) noexcept
+    {
+      if(this != &other)
+      {
+        release();
+        m_Pool = other.m_Pool;
+        m_Entry = other.m_Entry;
+        other.m_Pool = nullptr;
+        other.m_Entry = nullptr;
+      }
+      return *this;
+    }
+
+    /**
+     * @brief Returns the id of the open file or a negative value for an empty lease
+     * @return
+     */
+    hid_t id() const
+    {
+      return m_Entry != nullptr ? m_Entry->fileID : -1;
+    }
+
+    /**
+     * @brief Returns true if the lease holds an open file
+     * @return
+     */
+    bool isValid() const
+    {
+      return m_Entry != nullptr;
+    }
+
+    /**
+     * @brief Hands the file back to the pool. The lease is empty afterwards.
+     */
+    void release()
+    {
+      if(m_Pool != nullptr)
+      {
+        m_Pool->release(m_Entry);
+      }
+      m_Pool = nullptr;
+      m_Entry = nullptr;
+    }
+
+  private:
+    friend class H5FilePool;
+
+    Lease(H5FilePool* pool, Entry* entry)
+    : m_Pool(pool)
+    , m_Entry(entry)
+    {
+    }
+
+    H5FilePool* m_Pool = nullptr;
+    Entry* m_Entry = nullptr;
+  };
+
+  /**
+   * @brief Creates an empty pool
+   * @param capacity Number of files that may stay open while idle
+   * @param options Options used to open every file
+   */
+  explicit H5FilePool(size_t capacity = 16, const H5Utilities::FileOptions& options = H5Utilities::FileOptions())
+  : m_Capacity(capacity)
+  , m_Options(options)
+  {
+  }
+
+  ~H5FilePool()
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for(auto& entry : m_Entries)
+    {
+      closeEntry(entry);
+    }
+    for(auto& entry : m_Retired)
+    {
+      closeEntry(entry);
+    }
+  }
+
+  H5FilePool(const H5FilePool&) = delete;            // Copy Constructor Not Implemented
+  H5FilePool(H5FilePool&&) = delete;                 // Move Constructor Not Implemented
+  H5FilePool& operator=(const H5FilePool&) = delete; // Copy Assignment Not Implemented
+  H5FilePool& operator=(H5FilePool&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Hands out a file, opening it read-only if it is not open yet or if it changed on disk
+   * @param filePath Path of the file
+   * @return The lease. It is empty if the file could not be opened or was rewritten in place while leased.
+   */
+  Lease acquire(const std::string& filePath)
+  {
+    std::error_code errorCode;
+    std::string path = std::filesystem::canonical(filePath, errorCode).string();
+    FileIdentity identity;
+    if(errorCode || !identify(path, identity))
+    {
+      std::cout << "H5FilePool: Error finding file '" << filePath << "'" << std::endl;
+      return Lease();
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    auto found = m_Index.find(path);
+    bool changed = false;
+    if(found != m_Index.end())
+    {
+      auto entry = found->second;
+      if(entry->identity == identity)
+      {
+        m_Statistics.hits++;
+        entry->leases++;
+        m_Entries.splice(m_Entries.begin(), m_Entries, entry);
+        return Lease(this, &(*entry));
+      }
+      if(entry->leases > 0 && entry->identity.device == identity.device && entry->identity.inode == identity.inode)
+      {
+        // Opening the same inode again would only return the file HDF5 already has open
+        std::cout << "H5FilePool: File '" << path << "' was rewritten in place while it is leased" << std::endl;
+        return Lease();
+      }
+      // The file was replaced on disk. Leased ids keep working until they are released.
+      changed = true;
+      m_Index.erase(found);
+      if(entry->leases == 0)
+      {
+        closeEntry(*entry);
+        m_Entries.erase(entry);
+      }
+      else
+      {
+        m_Retired.splice(m_Retired.begin(), m_Entries, entry);
+      }
+    }
+
+    // Opening can take a while, so other files are served in the meantime
+    lock.unlock();
+    hid_t fileID = H5Utilities::openFile(path, true, m_Options);
+    lock.lock();
+    if(fileID < 0)
+    {
+      std::cout << "H5FilePool: Error opening file '" << path << "'" << std::endl;
+      return Lease();
+    }
+    found = m_Index.find(path);
+    if(found != m_Index.end())
+    {
+      // Another thread opened the same file in the meantime
+      Entry duplicate{path, fileID, identity, 0};
+      closeEntry(duplicate);
+      m_Statistics.hits++;
+      auto entry = found->second;
+      entry->leases++;
+      m_Entries.splice(m_Entries.begin(), m_Entries, entry);
+      return Lease(this, &(*entry));
+    }
+    if(changed)
+    {
+      m_Statistics.reopens++;
+    }
+    m_Statistics.misses++;
+    m_Entries.push_front({path, fileID, identity, 1});
+    m_Index[path] = m_Entries.begin();
+    evictIdle();
+    return Lease(this, &m_Entries.front());
+  }
+
+  /**
+   * @brief Closes every idle file. Leased files stay open.
+   */
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size_t capacity = m_Capacity;
+    m_Capacity = 0;
+    evictIdle();
+    m_Capacity = capacity;
+  }
+
+  /**
+   * @brief Returns the number of open files, leased or idle
+   * @return
+   */
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Entries.size() + m_Retired.size();
+  }
+
+  /**
+   * @brief Returns the counters collected since the pool was created
+   * @return
+   */
+  Statistics statistics() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Statistics;
+  }
+
+private:
+  /**
+   * @brief What a file looked like on disk when it was opened
+   */
+  struct FileIdentity
+  {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t size = 0;
+    int64_t modified = 0; // Nanoseconds where the platform provides them
+
+    bool operator==(const FileIdentity& other) const
+    {
+      return device == other.device && inode == other.inode && size == other.size && modified == other.modified;
+    }
+  };
+
+  struct Entry
+  {
+    std::string path;
+    hid_t fileID = -1;
+    FileIdentity identity;
+    size_t leases = 0;
+  };
+
+  size_t m_Capacity = 16;
+  H5Utilities::FileOptions m_Options;
+  mutable std::mutex m_Mutex;
+  std::list<Entry> m_Entries; // Current files, most recently used first
+  std::list<Entry> m_Retired; // Leased files that changed on disk
+  std::map<std::string, std::list<Entry>::iterator> m_Index;
+  Statistics m_Statistics;
+
+  /**
+   * @brief Reads the identity of a file from the file system
+   */
+  static bool identify(const std::string& path, FileIdentity& identity)
+  {
+    struct stat fileStats;
+    if(::stat(path.c_str(), &fileStats) != 0)
+    {
+      return false;
+    }
+    identity.device = static_cast<uint64_t>(fileStats.st_dev);
+    identity.inode = static_cast<uint64_t>(fileStats.st_ino);
+    identity.size = static_cast<int64_t>(fileStats.st_size);
+#if defined(_WIN32)
+    identity.modified = static_cast<int64_t>(fileStats.st_mtime) * 1000000000;
+#elif defined(__APPLE__)
+    identity.modified = static_cast<int64_t>(fileStats.st_mtimespec.tv_sec) * 1000000000 + fileStats.st_mtimespec.tv_nsec;
+#else
+    identity.modified = static_cast<int64_t>(fileStats.st_mtim.tv_sec) * 1000000000 + fileStats.st_mtim.tv_nsec;
+#endif
+    return true;
+  }
+
+  /**
+   * @brief Closes the file of an entry. Unlike H5Utilities::closeFile this does not look for
+   * objects left open, which would cost more than the open the pool saves.
+   */
+  static void closeEntry(Entry& entry)
+  {
+    if(entry.fileID >= 0 && H5Fclose(entry.fileID) < 0)
+    {
+      std::cout << "H5FilePool: Error closing file '" << entry.path << "'" << std::endl;
+    }
+    entry.fileID = -1;
+  }
+
+  /**
+   * @brief Closes idle files, least recently used first, until the pool is within its capacity
+   */
+  void evictIdle()
+  {
+    for(auto entry = m_Entries.end(); entry != m_Entries.begin() && m_Entries.size() > m_Capacity;)
+    {
+      --entry;
+      if(entry->leases == 0)
+      {
+        m_Index.erase(entry->path);
+        closeEntry(*entry);
+        entry = m_Entries.erase(entry);
+        m_Statistics.evictions++;
+      }
+    }
+  }
+
+  /**
+   * @brief Called by a lease to hand its file back
+   */
+  void release(Entry* entry)
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    entry->leases--;
+    if(entry->leases > 0)
+    {
+      return;
+    }
+    for(auto retired = m_Retired.begin(); retired != m_Retired.end(); ++retired)
+    {
+      if(&(*retired) == entry)
+      {
+        closeEntry(*retired);
+        m_Retired.erase(retired);
+        return;
+      }
+    }
+    evictIdle();
+  }
+};
+
+}; // namespace H5Support
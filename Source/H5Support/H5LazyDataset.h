@@ -0,0 +1,488 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5MemoryBudget.h"
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5LazyDataset class gives element access to a dataset without reading all of it.
+ * Elements are read a block at a time into a least recently used cache of a fixed size. The
+ * blocks are the chunks of a chunked dataset, so every chunk is decompressed at most once while
+ * it stays cached. Other datasets are split into blocks of about 1 MB that run along the fastest
+ * dimensions. The HDF5 chunk cache of the dataset is turned off since it would only hold a
+ * second copy of the same data. Cached blocks are reserved against H5MemoryBudget::global();
+ * when the budget is exhausted the cache gives up its own least recently used blocks first.
+ *
+ * The class is not thread-safe.
+ */
+template <typename T>
+class H5LazyDataset
+{
+public:
+  /**
+   * @brief Counters describing how well the cache is working
+   */
+  struct Statistics
+  {
+    size_t hits = 0;        // Element reads served from the cache
+    size_t misses = 0;      // Element reads that had to read a block
+    size_t prefetched = 0;  // Blocks read by prefetch
+    size_t evictions = 0;   // Blocks dropped to stay within the cache size or the memory budget
+    size_t cachedBytes = 0; // Bytes currently held by the cache
+  };
+
+  /**
+   * @brief Opens a dataset
+   * @param locationID The parent location of the dataset
+   * @param datasetName The name of the dataset
+   * @param cacheSize Number of bytes the cache may hold. At least one block is always kept.
+   */
+  H5LazyDataset(hid_t locationID, const std::string& datasetName, size_t cacheSize = 64 * 1024 * 1024)
+  : m_CacheSize(cacheSize)
+  {
+    hid_t dapl = H5Pcreate(H5P_DATASET_ACCESS);
+    H5Pset_chunk_cache(dapl, H5D_CHUNK_CACHE_NSLOTS_DEFAULT, 0, H5D_CHUNK_CACHE_W0_DEFAULT);
+    m_DatasetID = H5Dopen(locationID, datasetName.c_str(), dapl);
+    H5Pclose(dapl);
+    if(m_DatasetID < 0)
+    {
+      std::cout << "H5LazyDataset: Error opening dataset '" << datasetName << "'" << std::endl;
+      return;
+    }
+    hid_t dataspaceID = H5Dget_space(m_DatasetID);
+    m_Dims.resize(std::max(H5Sget_simple_extent_ndims(dataspaceID), 0));
+    H5Sget_simple_extent_dims(dataspaceID, m_Dims.data(), nullptr);
+    H5Sclose(dataspaceID);
+    m_Scalar = m_Dims.empty();
+    if(m_Scalar)
+    {
+      m_Dims.push_back(1);
+    }
+
+    m_BlockDims.resize(m_Dims.size());
+    hid_t dcpl = H5Dget_create_plist(m_DatasetID);
+    bool chunked = H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_chunk(dcpl, static_cast<int32_t>(m_BlockDims.size()), m_BlockDims.data()) >= 0;
+    H5Pclose(dcpl);
+    if(!chunked)
+    {
+      size_t remaining = std::max<size_t>(H5Lite::detail::k_ChunkMax / sizeof(T), 1);
+      for(size_t i = m_Dims.size(); i-- > 0;)
+      {
+        m_BlockDims[i] = std::clamp<hsize_t>(remaining, 1, std::max<hsize_t>(m_Dims[i], 1));
+        remaining = std::max<size_t>(remaining / m_BlockDims[i], 1);
+      }
+    }
+    m_NumBlocks.resize(m_Dims.size());
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      m_NumBlocks[i] = (m_Dims[i] + m_BlockDims[i] - 1) / m_BlockDims[i];
+    }
+  }
+
+  ~H5LazyDataset()
+  {
+    if(m_DatasetID >= 0)
+    {
+      H5Dclose(m_DatasetID);
+    }
+  }
+
+  H5LazyDataset(const H5LazyDataset&) = delete;            // Copy Constructor Not Implemented
+  H5LazyDataset(H5LazyDataset&&) = delete;                 // Move Constructor Not Implemented
+  H5LazyDataset& operator=(const H5LazyDataset&) = delete; // Copy Assignment Not Implemented
+  H5LazyDataset& operator=(H5LazyDataset&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Returns true if the dataset was opened
+   * @return
+   */
+  bool isValid() const
+  {
+    return m_DatasetID >= 0;
+  }
+
+  /**
+   * @brief Returns the dimensions of the dataset. A scalar dataset has the dimensions {1}.
+   * @return
+   */
+  const std::vector<hsize_t>& dims() const
+  {
+    return m_Dims;
+  }
+
+  /**
+   * @brief Returns the dimensions of the cached blocks
+   * @return
+   */
+  const std::vector<hsize_t>& blockDims() const
+  {
+    return m_BlockDims;
+  }
+
+  /**
+   * @brief Returns the number of elements in the dataset
+   * @return
+   */
+  size_t size() const
+  {
+    return isValid() ? static_cast<size_t>(numElements(m_Dims)) : 0;
+  }
+
+  /**
+   * @brief Reads one element
+   * @param coords The position of the element, one value per dimension
+   * @param value Set to the element
+   * @return Standard HDF5 error condition. Positions outside of the dataset are an error.
+   */
+  herr_t get(const hsize_t* coords, T& value)
+  {
+    if(!isValid())
+    {
+      return -1;
+    }
+    size_t blockIndex = 0;
+    size_t offset = 0;
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      if(coords[i] >= m_Dims[i])
+      {
+        std::cout << "H5LazyDataset: Position " << coords[i] << " is outside of dimension " << i << " with size " << m_Dims[i] << std::endl;
+        return -1;
+      }
+      blockIndex = blockIndex * m_NumBlocks[i] + coords[i] / m_BlockDims[i];
+    }
+    Block* block = findBlock(blockIndex);
+    if(block != nullptr)
+    {
+      m_Statistics.hits++;
+    }
+    else
+    {
+      m_Statistics.misses++;
+      block = loadBlock(blockIndex);
+      if(block == nullptr)
+      {
+        return -1;
+      }
+    }
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      offset = offset * block->count[i] + (coords[i] - block->start[i]);
+    }
+    value = block->data[offset];
+    return 0;
+  }
+
+  /**
+   * @brief Reads one element
+   * @param coords The position of the element, one value per dimension
+   * @param value Set to the element
+   * @return Standard HDF5 error condition
+   */
+  herr_t get(const std::vector<hsize_t>& coords, T& value)
+  {
+    return coords.size() == m_Dims.size() ? get(coords.data(), value) : -1;
+  }
+
+  /**
+   * @brief Returns the element at a row major index, or a default value if it cannot be read
+   * @param index
+   * @return
+   */
+  T operator[](size_t index)
+  {
+    std::vector<hsize_t> coords(m_Dims.size());
+    for(size_t i = m_Dims.size(); i-- > 0;)
+    {
+      coords[i] = index % m_Dims[i];
+      index /= m_Dims[i];
+    }
+    T value = T();
+    if(index > 0 || get(coords, value) < 0)
+    {
+      return T();
+    }
+    return value;
+  }
+
+  /**
+   * @brief Returns the element at a position, or a default value if it cannot be read.
+   * Takes one index per dimension.
+   * @return
+   */
+  template <typename... Indices>
+  T operator()(Indices... indices)
+  {
+    std::array<hsize_t, sizeof...(Indices)> coords = {static_cast<hsize_t>(indices)...};
+    T value = T();
+    if(coords.size() != m_Dims.size() || get(coords.data(), value) < 0)
+    {
+      return T();
+    }
+    return value;
+  }
+
+  /**
+   * @brief Reads the blocks that cover a region into the cache ahead of use. Blocks that are
+   * already cached are kept. Stops once the region no longer fits into the cache.
+   * @param start The first position of the region
+   * @param count The size of the region
+   * @return Standard HDF5 error condition
+   */
+  herr_t prefetch(const std::vector<hsize_t>& start, const std::vector<hsize_t>& count)
+  {
+    if(!isValid() || start.size() != m_Dims.size() || count.size() != m_Dims.size())
+    {
+      return -1;
+    }
+    std::vector<hsize_t> first(m_Dims.size());
+    std::vector<hsize_t> last(m_Dims.size());
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      if(count[i] == 0 || start[i] >= m_Dims[i])
+      {
+        return 0;
+      }
+      first[i] = start[i] / m_BlockDims[i];
+      last[i] = (std::min(start[i] + count[i], m_Dims[i]) - 1) / m_BlockDims[i];
+    }
+    size_t loadedBytes = 0;
+    std::vector<hsize_t> position = first;
+    while(true)
+    {
+      size_t blockIndex = 0;
+      for(size_t i = 0; i < m_Dims.size(); i++)
+      {
+        blockIndex = blockIndex * m_NumBlocks[i] + position[i];
+      }
+      if(findBlock(blockIndex) == nullptr)
+      {
+        if(loadedBytes > 0 && loadedBytes + blockBytes(blockIndex) > m_CacheSize)
+        {
+          return 0;
+        }
+        if(loadBlock(blockIndex) == nullptr)
+        {
+          return -1;
+        }
+        m_Statistics.prefetched++;
+      }
+      loadedBytes += blockBytes(blockIndex);
+      size_t i = m_Dims.size();
+      while(i-- > 0)
+      {
+        if(++position[i] <= last[i])
+        {
+          break;
+        }
+        position[i] = first[i];
+      }
+      if(i == static_cast<size_t>(-1))
+      {
+        return 0;
+      }
+    }
+  }
+
+  /**
+   * @brief Returns the cache counters
+   * @return
+   */
+  Statistics statistics() const
+  {
+    return m_Statistics;
+  }
+
+  /**
+   * @brief Drops every cached block
+   */
+  void clearCache()
+  {
+    m_Blocks.clear();
+    m_Index.clear();
+    m_Statistics.cachedBytes = 0;
+  }
+
+private:
+  struct Block
+  {
+    size_t index = 0;
+    std::vector<hsize_t> start;
+    std::vector<hsize_t> count;
+    std::vector<T> data;
+    H5MemoryBudget::Reservation reservation;
+  };
+
+  hid_t m_DatasetID = -1;
+  bool m_Scalar = false;
+  size_t m_CacheSize = 0;
+  std::vector<hsize_t> m_Dims;
+  std::vector<hsize_t> m_BlockDims;
+  std::vector<hsize_t> m_NumBlocks;
+  std::list<Block> m_Blocks; // Most recently used first
+  std::unordered_map<size_t, typename std::list<Block>::iterator> m_Index;
+  Statistics m_Statistics;
+
+  static hsize_t numElements(const std::vector<hsize_t>& dims)
+  {
+    return std::accumulate(dims.begin(), dims.end(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
+  }
+
+  /**
+   * @brief Returns the region of a block, clipped to the dataset
+   */
+  void blockRegion(size_t blockIndex, std::vector<hsize_t>& start, std::vector<hsize_t>& count) const
+  {
+    start.resize(m_Dims.size());
+    count.resize(m_Dims.size());
+    for(size_t i = m_Dims.size(); i-- > 0;)
+    {
+      start[i] = (blockIndex % m_NumBlocks[i]) * m_BlockDims[i];
+      count[i] = std::min(m_BlockDims[i], m_Dims[i] - start[i]);
+      blockIndex /= m_NumBlocks[i];
+    }
+  }
+
+  size_t blockBytes(size_t blockIndex) const
+  {
+    std::vector<hsize_t> start;
+    std::vector<hsize_t> count;
+    blockRegion(blockIndex, start, count);
+    return static_cast<size_t>(numElements(count)) * sizeof(T);
+  }
+
+  /**
+   * @brief Looks a block up in the cache and marks it as most recently used
+   */
+  Block* findBlock(size_t blockIndex)
+  {
+    auto found = m_Index.find(blockIndex);
+    if(found == m_Index.end())
+    {
+      return nullptr;
+    }
+    m_Blocks.splice(m_Blocks.begin(), m_Blocks, found->second);
+    return &m_Blocks.front();
+  }
+
+  /**
+   * @brief Drops the least recently used blocks that leave no room for a new block and reads it into the cache
+   */
+  Block* loadBlock(size_t blockIndex)
+  {
+    Block block;
+    block.index = blockIndex;
+    blockRegion(blockIndex, block.start, block.count);
+    const size_t bytes = static_cast<size_t>(numElements(block.count)) * sizeof(T);
+    while(!m_Blocks.empty() && m_Statistics.cachedBytes + bytes > m_CacheSize)
+    {
+      dropLeastRecentlyUsed();
+    }
+    // Give up cached blocks before waiting for memory that others hold
+    block.reservation = H5MemoryBudget::Reservation::tryReserve(bytes);
+    while(!block.reservation.isValid() && !m_Blocks.empty())
+    {
+      dropLeastRecentlyUsed();
+      block.reservation = H5MemoryBudget::Reservation::tryReserve(bytes);
+    }
+    if(!block.reservation.isValid())
+    {
+      block.reservation = H5MemoryBudget::Reservation(bytes);
+      if(!block.reservation.isValid())
+      {
+        std::cout << "H5LazyDataset: Error reserving memory for block " << blockIndex << std::endl;
+        return nullptr;
+      }
+    }
+
+    block.data.resize(static_cast<size_t>(numElements(block.count)));
+    herr_t error = 0;
+    if(m_Scalar)
+    {
+      error = H5Dread(m_DatasetID, H5Lite::HDFTypeForPrimitive<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, block.data.data());
+    }
+    else
+    {
+      hid_t fileSpaceID = H5Dget_space(m_DatasetID);
+      hid_t memorySpaceID = H5Screate_simple(static_cast<int32_t>(block.count.size()), block.count.data(), nullptr);
+      error = H5Sselect_hyperslab(fileSpaceID, H5S_SELECT_SET, block.start.data(), nullptr, block.count.data(), nullptr);
+      error = error < 0 ? error : H5Dread(m_DatasetID, H5Lite::HDFTypeForPrimitive<T>(), memorySpaceID, fileSpaceID, H5P_DEFAULT, block.data.data());
+      H5Sclose(memorySpaceID);
+      H5Sclose(fileSpaceID);
+    }
+    if(error < 0)
+    {
+      std::cout << "H5LazyDataset: Error reading block " << blockIndex << std::endl;
+      return nullptr;
+    }
+
+    m_Blocks.push_front(std::move(block));
+    m_Index[blockIndex] = m_Blocks.begin();
+    m_Statistics.cachedBytes += bytes;
+    return &m_Blocks.front();
+  }
+
+  /**
+   * @brief Drops the least recently used block from the cache
+   */
+  void dropLeastRecentlyUsed()
+  {
+    m_Statistics.cachedBytes -= m_Blocks.back().data.size() * sizeof(T);
+    m_Index.erase(m_Blocks.back().index);
+    m_Blocks.pop_back();
+    m_Statistics.evictions++;
+  }
+};
+
+}; // namespace H5Support
@@ -39,17 +39,21 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <string>
 #include <type_traits>
 #include <typeinfo>
+#include <utility>
 #include <vector>
 
 #include <hdf5.h>
 
 #include "H5Support/H5Macros.h"
+#include "H5Support/H5MemoryBudget.h"
 #include "H5Support/H5Support.h"
 
 /**
@@ -70,6 +74,9 @@ inline constexpr std::false_type always_false = {};
 inline constexpr size_t k_ChunkBase = 16 * 1024;
 inline constexpr size_t k_ChunkMin = 8 * 1024;
 inline constexpr size_t k_ChunkMax = 1024 * 1024;
+
+// Compact data is stored in the object header, which is limited to 64 KB
+inline constexpr size_t k_CompactMax = 60 * 1024;
 } // namespace detail
 
 /*-------------------------------------------------------------------------
@@ -577,6 +584,351 @@ inline bool datasetExists(hid_t locationID, const std::string& datasetName)
   return error >= 0;
 }
 
+/**
+ * @brief Returns a guess for the vector of chunk dimensions based on the input parameters.
+ * @param dims The vector dimensions of the dataset
+ * @param typeSize The size of the data type for the dataset
+ * @return The vector of chunk dimensions guess
+ */
+inline std::vector<hsize_t> guessChunkSize(const std::vector<hsize_t>& dims, size_t typeSize)
+{
+  std::vector<hsize_t> chunks(dims.cbegin(), dims.cend());
+  size_t chunksSize = chunks.size();
+
+  hsize_t product = std::accumulate(chunks.cbegin(), chunks.cend(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
+  hsize_t datasetSize = product * typeSize;
+  double percentage = std::pow(2.0, std::log10(static_cast<double>(datasetSize) / (1024.0 * 1024.0)));
+  hsize_t targetSize = static_cast<hsize_t>(static_cast<double>(detail::k_ChunkBase) * percentage);
+  targetSize = std::clamp(targetSize, static_cast<hsize_t>(detail::k_ChunkMin), static_cast<hsize_t>(detail::k_ChunkMax));
+
+  size_t index = 0;
+
+  bool foundChunkSize = false;
+
+  while(!foundChunkSize)
+  {
+    product = std::accumulate(chunks.cbegin(), chunks.cend(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
+    hsize_t chunkBytes = product * typeSize;
+    if(chunkBytes < targetSize)
+    {
+      break;
+    }
+
+    if(chunkBytes < detail::k_ChunkMax && static_cast<double>(chunkBytes - targetSize) / static_cast<double>(targetSize) < 0.5)
+    {
+      break;
+    }
+
+    if(product == 1)
+    {
+      break;
+    }
+
+    size_t i = index % chunksSize;
+
+    chunks[i] = static_cast<hsize_t>(std::ceil(static_cast<double>(chunks[i]) / 2.0));
+    ++index;
+  }
+
+  return chunks;
+}
+
+/**
+ * @brief Returns a guess for the vector of chunk dimensions based on the input parameters.
+ * @param rank The number of dimensions
+ * @param dims The dimensions of the dataset
+ * @param typeSize The size of the data type for the dataset
+ * @return The vector of chunk dimensions guess
+ */
+inline std::vector<hsize_t> guessChunkSize(int32_t rank, const hsize_t* dims, size_t typeSize)
+{
+  std::vector<hsize_t> vDims(rank, 0);
+  std::copy(dims, dims + rank, vDims.data());
+  return guessChunkSize(vDims, typeSize);
+}
+
+/**
+ * @brief When HDF5 allocates the file space of a dataset
+ */
+enum class AllocationTime : int32_t
+{
+  Default = 0,    // HDF5 picks based on the layout (late for contiguous, incremental for chunked)
+  Early = 1,      // When the dataset is created
+  Late = 2,       // When the dataset is first written
+  Incremental = 3 // Chunk by chunk as chunks are written. Chunked datasets only
+};
+
+/**
+ * @brief When HDF5 writes fill values into the allocated space of a dataset
+ */
+enum class FillWrite : int32_t
+{
+  Default = 0,   // Only if the application set a fill value
+  Never = 1,     // Never. Unwritten elements have undefined values
+  Allocation = 2 // Always when the space is allocated
+};
+
+/**
+ * @brief Storage layout of the (unchunked) datasets written by H5Lite
+ */
+enum class DatasetLayout : int32_t
+{
+  Automatic = 0,  // Compact if the data fits under the compact threshold, contiguous otherwise
+  Contiguous = 1, // Data is stored in its own block of the file
+  Compact = 2     // Data is stored inside the object header. Only for data smaller than about 60 KB
+};
+
+/**
+ * @brief Creation settings for the datasets written by H5Lite. The write functions write the
+ * whole dataset right after creating it, so by default no fill values are written; they
+ * would be overwritten immediately and only cost an extra pass over the disk.
+ *
+ * Small datasets are stored compact by default so reading them back needs a single
+ * metadata read instead of a header read plus a data read.
+ */
+struct DatasetCreationOptions
+{
+  AllocationTime allocationTime = AllocationTime::Default;
+  FillWrite fillWrite = FillWrite::Never;
+  DatasetLayout layout = DatasetLayout::Automatic;
+  size_t compactThreshold = 16 * 1024; // Largest data size in bytes stored compact by the automatic layout
+  bool extendible = false;             // Create chunked with unlimited dimensions so replacePointerDataset can resize it in place
+};
+
+/**
+ * @brief Applies the dataset creation options to a dataset creation property list
+ * @param datasetCreationPropertyList
+ * @param options
+ * @return Standard HDF5 error condition
+ */
+inline herr_t setDatasetCreationOptions(hid_t datasetCreationPropertyList, const DatasetCreationOptions& options)
+{
+  herr_t error = 0;
+  switch(options.allocationTime)
+  {
+  case AllocationTime::Early:
+    error = H5Pset_alloc_time(datasetCreationPropertyList, H5D_ALLOC_TIME_EARLY);
+    break;
+  case AllocationTime::Late:
+    error = H5Pset_alloc_time(datasetCreationPropertyList, H5D_ALLOC_TIME_LATE);
+    break;
+  case AllocationTime::Incremental:
+    error = H5Pset_alloc_time(datasetCreationPropertyList, H5D_ALLOC_TIME_INCR);
+    break;
+  case AllocationTime::Default:
+    break;
+  }
+  if(error < 0)
+  {
+    return error;
+  }
+
+  switch(options.fillWrite)
+  {
+  case FillWrite::Never:
+    error = H5Pset_fill_time(datasetCreationPropertyList, H5D_FILL_TIME_NEVER);
+    break;
+  case FillWrite::Allocation:
+    error = H5Pset_fill_time(datasetCreationPropertyList, H5D_FILL_TIME_ALLOC);
+    break;
+  case FillWrite::Default:
+    break;
+  }
+  return error;
+}
+
+/**
+ * @brief Returns true if a dataset holding dataSize bytes would be stored compact
+ * @param options
+ * @param dataSize The size of the data in bytes
+ * @return
+ */
+inline bool useCompactLayout(const DatasetCreationOptions& options, hsize_t dataSize)
+{
+  if(options.extendible)
+  {
+    return false;
+  }
+  // Compact data is always allocated when the dataset is created
+  if(options.allocationTime != AllocationTime::Default && options.allocationTime != AllocationTime::Early)
+  {
+    return false;
+  }
+  switch(options.layout)
+  {
+  case DatasetLayout::Compact:
+    return true;
+  case DatasetLayout::Automatic:
+    return dataSize > 0 && dataSize <= std::min(options.compactThreshold, detail::k_CompactMax);
+  case DatasetLayout::Contiguous:
+    break;
+  }
+  return false;
+}
+
+/**
+ * @brief Creates a dataset creation property list with the given options applied.
+ * The caller is responsible for closing the returned property list.
+ * @param options
+ * @param rank The number of dimensions of the dataset
+ * @param dims The dimensions of the dataset. Used to pick the layout and chunk size.
+ * @param typeSize The size of the data type in bytes
+ * @return The property list id. Negative value is error.
+ */
+inline hid_t createDatasetCreationPropertyList(const DatasetCreationOptions& options, int32_t rank = 0, const hsize_t* dims = nullptr, size_t typeSize = 0)
+{
+  hid_t datasetCreationPropertyList = H5Pcreate(H5P_DATASET_CREATE);
+  if(datasetCreationPropertyList < 0)
+  {
+    return datasetCreationPropertyList;
+  }
+  hsize_t dataSize = (dims == nullptr) ? 0 : std::accumulate(dims, dims + rank, static_cast<hsize_t>(typeSize), std::multiplies<hsize_t>());
+  herr_t error = 0;
+  if(options.extendible && rank > 0 && dims != nullptr)
+  {
+    std::vector<hsize_t> chunkDims = guessChunkSize(rank, dims, typeSize);
+    for(auto& chunkDim : chunkDims)
+    {
+      chunkDim = std::max<hsize_t>(chunkDim, 1);
+    }
+    error = H5Pset_chunk(datasetCreationPropertyList, rank, chunkDims.data());
+  }
+  else if(useCompactLayout(options, dataSize))
+  {
+    error = H5Pset_layout(datasetCreationPropertyList, H5D_COMPACT);
+  }
+  if(error < 0 || setDatasetCreationOptions(datasetCreationPropertyList, options) < 0)
+  {
+    H5Pclose(datasetCreationPropertyList);
+    return -1;
+  }
+  return datasetCreationPropertyList;
+}
+
+/**
+ * @brief Settings for how the data of a read or write moves between memory and the file. By
+ * default the whole dataset is transferred with one call. Transfers above splitThreshold are
+ * split into slabs along the slowest dimension instead, so HDF5 only ever needs temporary
+ * buffers for one slab and the caller gets a chance to report progress or cancel in between.
+ * A write that fails or is cancelled removes the dataset it created again, so no dataset with
+ * partly undefined values is left behind. The space the slabs took up in the file is only
+ * reclaimed by repacking the file.
+ */
+struct TransferOptions
+{
+  size_t splitThreshold = 0;                        // Transfers of more bytes than this are split into slabs. Zero never splits.
+  size_t slabSize = 64 * 1024 * 1024;               // Approximate number of bytes per slab
+  size_t conversionBufferSize = 0;                  // Size of the type conversion buffer, reused by every slab. Zero uses the HDF5 default.
+  std::function<void(uint64_t, uint64_t)> progress; // Optional. Called after each slab with the bytes done and the total bytes.
+  std::function<bool()> cancel;                     // Optional. Checked before each slab; returning true stops the transfer.
+};
+
+namespace detail
+{
+/**
+ * @brief Reads or writes a whole dataset, slab by slab if the options ask for it
+ * @param datasetID
+ * @param memoryType The type of the elements in memory
+ * @param typeSize The size of one element in memory
+ * @param data The elements. Only read from when writing.
+ * @param write
+ * @param options
+ * @return Standard HDF5 error condition
+ */
+inline herr_t transferDataset(hid_t datasetID, hid_t memoryType, size_t typeSize, void* data, bool write, const TransferOptions& options)
+{
+  hid_t transferPropertyList = H5P_DEFAULT;
+  std::vector<uint8_t> conversionBuffer;
+  std::vector<uint8_t> backgroundBuffer;
+  if(options.conversionBufferSize > 0)
+  {
+    // Buffers handed to H5Pset_buffer are used as they are, so every slab shares them
+    conversionBuffer.resize(options.conversionBufferSize);
+    backgroundBuffer.resize(options.conversionBufferSize);
+    transferPropertyList = H5Pcreate(H5P_DATASET_XFER);
+    if(transferPropertyList < 0 || H5Pset_buffer(transferPropertyList, options.conversionBufferSize, conversionBuffer.data(), backgroundBuffer.data()) < 0)
+    {
+      std::cout << "Error setting the type conversion buffer" << std::endl;
+      if(transferPropertyList >= 0)
+      {
+        H5Pclose(transferPropertyList);
+      }
+      return -1;
+    }
+  }
+
+  hid_t fileSpaceID = H5Dget_space(datasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(fileSpaceID);
+  std::vector<hsize_t> dims(std::max(rank, 0));
+  H5Sget_simple_extent_dims(fileSpaceID, dims.data(), nullptr);
+  const uint64_t totalBytes = std::accumulate(dims.begin(), dims.end(), static_cast<uint64_t>(typeSize), std::multiplies<uint64_t>());
+
+  herr_t error = 0;
+  bool cancelled = false;
+  if(rank <= 0 || dims[0] == 0 || options.splitThreshold == 0 || totalBytes <= options.splitThreshold)
+  {
+    cancelled = options.cancel && options.cancel();
+    if(cancelled)
+    {
+      error = -1;
+    }
+    else
+    {
+      error = write ? H5Dwrite(datasetID, memoryType, H5S_ALL, H5S_ALL, transferPropertyList, data) : H5Dread(datasetID, memoryType, H5S_ALL, H5S_ALL, transferPropertyList, data);
+      if(error >= 0 && options.progress)
+      {
+        options.progress(totalBytes, totalBytes);
+      }
+    }
+  }
+  else
+  {
+    const uint64_t rowBytes = totalBytes / dims[0];
+    const hsize_t rowsPerSlab = std::max<hsize_t>(1, options.slabSize / std::max<uint64_t>(rowBytes, 1));
+    std::vector<hsize_t> start(rank, 0);
+    std::vector<hsize_t> count = dims;
+    for(hsize_t row = 0; row < dims[0] && error >= 0; row += rowsPerSlab)
+    {
+      cancelled = options.cancel && options.cancel();
+      if(cancelled)
+      {
+        error = -1;
+        break;
+      }
+      start[0] = row;
+      count[0] = std::min(rowsPerSlab, dims[0] - row);
+      uint8_t* slab = static_cast<uint8_t*>(data) + row * rowBytes;
+      hid_t memorySpaceID = H5Screate_simple(rank, count.data(), nullptr);
+      error = H5Sselect_hyperslab(fileSpaceID, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+      if(error >= 0 && write)
+      {
+        error = H5Dwrite(datasetID, memoryType, memorySpaceID, fileSpaceID, transferPropertyList, slab);
+      }
+      else if(error >= 0)
+      {
+        error = H5Dread(datasetID, memoryType, memorySpaceID, fileSpaceID, transferPropertyList, slab);
+      }
+      H5Sclose(memorySpaceID);
+      if(error >= 0 && options.progress)
+      {
+        options.progress((row + count[0]) * rowBytes, totalBytes);
+      }
+    }
+  }
+  if(cancelled)
+  {
+    std::cout << "The transfer was cancelled" << std::endl;
+  }
+
+  H5Sclose(fileSpaceID);
+  if(transferPropertyList != H5P_DEFAULT)
+  {
+    H5Pclose(transferPropertyList);
+  }
+  return error;
+}
+} // namespace detail
+
 /**
  * @brief Writes the data of a pointer to an HDF5 file
  * @param locationID The hdf5 object id of the parent
@@ -584,10 +936,13 @@ inline bool datasetExists(hid_t locationID, const std::string& datasetName)
  * @param rank The number of dimensions
  * @param dims The sizes of each dimension
  * @param data The data to be written.
+ * @param options The dataset creation options
+ * @param transfer Controls splitting the write into slabs. A failed or cancelled write removes the dataset again.
  * @return Standard hdf5 error condition.
  */
 template <typename T>
-inline herr_t writePointerDataset(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data)
+inline herr_t writePointerDataset(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data, const DatasetCreationOptions& options = DatasetCreationOptions(),
+                                  const TransferOptions& transfer = TransferOptions())
 {
   H5SUPPORT_MUTEX_LOCK()
   herr_t returnError = 0;
@@ -602,17 +957,27 @@ inline herr_t writePointerDataset(hid_t locationID, const std::string& datasetNa
     return -1;
   }
   // Create the DataSpace
-  hid_t dataspaceID = H5Screate_simple(rank, dims, nullptr);
+  std::vector<hsize_t> maxDims(rank, H5S_UNLIMITED);
+  hid_t dataspaceID = H5Screate_simple(rank, dims, options.extendible ? maxDims.data() : nullptr);
   if(dataspaceID < 0)
   {
     return static_cast<herr_t>(dataspaceID);
   }
+  hid_t propertyListID = createDatasetCreationPropertyList(options, rank, dims, sizeof(T));
+  if(propertyListID < 0)
+  {
+    H5Sclose(dataspaceID);
+    return static_cast<herr_t>(propertyListID);
+  }
   // Create the Dataset
   // This will fail if datasetName contains a "/"!
-  hid_t datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, propertyListID, H5P_DEFAULT);
+  H5Pclose(propertyListID);
   if(datasetID >= 0)
   {
-    herr_t error = H5Dwrite(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    // The data is only read from during a write
+    herr_t error = detail::transferDataset(datasetID, dataType, sizeof(T), const_cast<T*>(data), true, transfer);
+    const bool written = error >= 0;
     if(error < 0)
     {
       std::cout << "Error Writing Data '" << datasetName << "'" << std::endl;
@@ -634,6 +999,11 @@ inline herr_t writePointerDataset(hid_t locationID, const std::string& datasetNa
       std::cout << "Error Closing Dataset." << std::endl;
       returnError = error;
     }
+    // Whatever the failed write did not reach is undefined, so the dataset must not stay behind
+    if(!written && H5Ldelete(locationID, datasetName.c_str(), H5P_DEFAULT) < 0)
+    {
+      std::cout << "Error Removing Dataset '" << datasetName << "'" << std::endl;
+    }
   }
   else
   {
@@ -649,17 +1019,85 @@ inline herr_t writePointerDataset(hid_t locationID, const std::string& datasetNa
   return returnError;
 }
 
+/**
+ * @brief Prepares an existing dataset to be overwritten with data of the given type and
+ * dimensions. Datasets with the same type and dimensions can be used as they are and
+ * chunked datasets whose maximum dimensions allow it are resized with H5Dset_extent.
+ * @param datasetID The dataset to check
+ * @param dataType The type of the new data
+ * @param rank The number of dimensions of the new data
+ * @param dims The dimensions of the new data
+ * @return True if the new data can be written to the dataset with H5S_ALL
+ */
+inline bool prepareDatasetForReplace(hid_t datasetID, hid_t dataType, int32_t rank, const hsize_t* dims)
+{
+  hid_t fileType = H5Dget_type(datasetID);
+  bool sameType = fileType >= 0 && H5Tequal(fileType, dataType) > 0;
+  if(fileType >= 0)
+  {
+    H5Tclose(fileType);
+  }
+  if(!sameType)
+  {
+    return false;
+  }
+
+  hid_t dataspaceID = H5Dget_space(datasetID);
+  if(dataspaceID < 0)
+  {
+    return false;
+  }
+  bool sameRank = (H5Sget_simple_extent_ndims(dataspaceID) == rank);
+  std::vector<hsize_t> currentDims(rank, 0);
+  std::vector<hsize_t> maxDims(rank, 0);
+  if(sameRank && rank > 0)
+  {
+    H5Sget_simple_extent_dims(dataspaceID, currentDims.data(), maxDims.data());
+  }
+  H5Sclose(dataspaceID);
+  if(!sameRank)
+  {
+    return false;
+  }
+  if(std::equal(currentDims.begin(), currentDims.end(), dims))
+  {
+    return true;
+  }
+
+  hid_t propertyListID = H5Dget_create_plist(datasetID);
+  H5D_layout_t layout = H5Pget_layout(propertyListID);
+  H5Pclose(propertyListID);
+  if(layout != H5D_CHUNKED)
+  {
+    return false;
+  }
+  for(int32_t i = 0; i < rank; i++)
+  {
+    if(maxDims[i] != H5S_UNLIMITED && dims[i] > maxDims[i])
+    {
+      return false;
+    }
+  }
+  return H5Dset_extent(datasetID, dims) >= 0;
+}
+
 /**
  * @brief Replaces the given dataset with the data of a pointer to an HDF5 file. Creates the dataset if it does not exist.
+ *
+ * An existing dataset with the same type and dimensions is overwritten in place. Chunked
+ * datasets (see DatasetCreationOptions::extendible) are grown or shrunk with H5Dset_extent
+ * when their maximum dimensions allow it. Only if neither is possible is the dataset
+ * unlinked and created again, which leaves its old storage unused in the file.
  * @param locationID The hdf5 object id of the parent
  * @param datasetName The name of the dataset to write to. This can be a name of Path
  * @param rank The number of dimensions
  * @param dims The sizes of each dimension
  * @param data The data to be written.
+ * @param options The dataset creation options used when the dataset has to be created
  * @return Standard hdf5 error condition.
  */
 template <typename T>
-inline herr_t replacePointerDataset(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data)
+inline herr_t replacePointerDataset(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data, const DatasetCreationOptions& options = DatasetCreationOptions())
 {
   H5SUPPORT_MUTEX_LOCK()
 
@@ -676,7 +1114,8 @@ inline herr_t replacePointerDataset(hid_t locationID, const std::string& dataset
     return -1;
   }
   // Create the DataSpace
-  hid_t dataspaceID = H5Screate_simple(rank, dims, nullptr);
+  std::vector<hsize_t> maxDims(rank, H5S_UNLIMITED);
+  hid_t dataspaceID = H5Screate_simple(rank, dims, options.extendible ? maxDims.data() : nullptr);
   if(dataspaceID < 0)
   {
     return dataspaceID;
@@ -685,9 +1124,26 @@ inline herr_t replacePointerDataset(hid_t locationID, const std::string& dataset
   HDF_ERROR_HANDLER_OFF
   hid_t datasetID = H5Dopen(locationID, datasetName.c_str(), H5P_DEFAULT);
   HDF_ERROR_HANDLER_ON
+  if(datasetID >= 0 && !prepareDatasetForReplace(datasetID, dataType, rank, dims))
+  {
+    // Last resort: the old storage can not be reused so drop the dataset and create it again
+    H5Dclose(datasetID);
+    datasetID = -1;
+    if(H5Ldelete(locationID, datasetName.c_str(), H5P_DEFAULT) < 0)
+    {
+      std::cout << "Error Removing Dataset '" << datasetName << "'" << std::endl;
+      H5Sclose(dataspaceID);
+      return -1;
+    }
+  }
   if(datasetID < 0) // dataset does not exist so create it
   {
-    datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    hid_t propertyListID = createDatasetCreationPropertyList(options, rank, dims, sizeof(T));
+    if(propertyListID >= 0)
+    {
+      datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, propertyListID, H5P_DEFAULT);
+      H5Pclose(propertyListID);
+    }
   }
   if(datasetID >= 0)
   {
@@ -726,6 +1182,8 @@ inline herr_t replacePointerDataset(hid_t locationID, const std::string& dataset
  * @param datasetName The name of the dataset
  * @param dims The dimensions of the dataset
  * @param data The data to write to the file
+ * @param options The dataset creation options
+ * @param transfer Controls splitting the write into slabs. A failed or cancelled write removes the dataset again.
  * @return Standard HDF5 error conditions
  *
  * The dimensions of the data sets are usually passed as both a "rank" and
@@ -745,72 +1203,10 @@ inline herr_t replacePointerDataset(hid_t locationID, const std::string& dataset
  * pass H5T_NATIVE_UINT8 as the dataType.
  */
 template <typename T>
-inline herr_t writeVectorDataset(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, const std::vector<T>& data)
-{
-  return writePointerDataset(locationID, datasetName, static_cast<int32_t>(dims.size()), dims.data(), data.data());
-}
-
-/**
- * @brief Returns a guess for the vector of chunk dimensions based on the input parameters.
- * @param dims The vector dimensions of the dataset
- * @param typeSize The size of the data type for the dataset
- * @return The vector of chunk dimensions guess
- */
-inline std::vector<hsize_t> guessChunkSize(const std::vector<hsize_t>& dims, size_t typeSize)
-{
-  std::vector<hsize_t> chunks(dims.cbegin(), dims.cend());
-  size_t chunksSize = chunks.size();
-
-  hsize_t product = std::accumulate(chunks.cbegin(), chunks.cend(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
-  hsize_t datasetSize = product * typeSize;
-  double percentage = std::pow(2.0, std::log10(static_cast<double>(datasetSize) / (1024.0 * 1024.0)));
-  hsize_t targetSize = static_cast<hsize_t>(static_cast<double>(detail::k_ChunkBase) * percentage);
-  targetSize = std::clamp(targetSize, static_cast<hsize_t>(detail::k_ChunkMin), static_cast<hsize_t>(detail::k_ChunkMax));
-
-  size_t index = 0;
-
-  bool foundChunkSize = false;
-
-  while(!foundChunkSize)
-  {
-    product = std::accumulate(chunks.cbegin(), chunks.cend(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
-    hsize_t chunkBytes = product * typeSize;
-    if(chunkBytes < targetSize)
-    {
-      break;
-    }
-
-    if(chunkBytes < detail::k_ChunkMax && static_cast<double>(chunkBytes - targetSize) / static_cast<double>(targetSize) < 0.5)
-    {
-      break;
-    }
-
-    if(product == 1)
-    {
-      break;
-    }
-
-    size_t i = index % chunksSize;
-
-    chunks[i] = static_cast<hsize_t>(std::ceil(static_cast<double>(chunks[i]) / 2.0));
-    ++index;
-  }
-
-  return chunks;
-}
-
-/**
- * @brief Returns a guess for the vector of chunk dimensions based on the input parameters.
- * @param rank The number of dimensions
- * @param dims The dimensions of the dataset
- * @param typeSize The size of the data type for the dataset
- * @return The vector of chunk dimensions guess
- */
-inline std::vector<hsize_t> guessChunkSize(int32_t rank, const hsize_t* dims, size_t typeSize)
+inline herr_t writeVectorDataset(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, const std::vector<T>& data,
+                                 const DatasetCreationOptions& options = DatasetCreationOptions(), const TransferOptions& transfer = TransferOptions())
 {
-  std::vector<hsize_t> vDims(rank, 0);
-  std::copy(dims, dims + rank, vDims.data());
-  return guessChunkSize(vDims, typeSize);
+  return writePointerDataset(locationID, datasetName, static_cast<int32_t>(dims.size()), dims.data(), data.data(), options, transfer);
 }
 
 #ifdef H5_HAVE_FILTER_DEFLATE
@@ -825,11 +1221,13 @@ inline std::vector<hsize_t> guessChunkSize(int32_t rank, const hsize_t* dims, si
  * @param cRank The number of dimensions for cDims
  * @param cDims The chunk dimensions
  * @param compressionLevel The compression level (0-9)
+ * @param options The dataset creation options
+ * @param transfer Controls splitting the write into slabs. A failed or cancelled write removes the dataset again.
  * @return Standard HDF5 error conditions
  */
 template <typename T>
 inline herr_t writePointerDatasetCompressed(hid_t locationID, const std::string& datasetName, int32_t rank, const hsize_t* dims, const T* data, int32_t cRank, const hsize_t* cDims,
-                                            int32_t compressionLevel)
+                                            int32_t compressionLevel, const DatasetCreationOptions& options = DatasetCreationOptions(), const TransferOptions& transfer = TransferOptions())
 {
   H5SUPPORT_MUTEX_LOCK()
 
@@ -902,12 +1300,31 @@ inline herr_t writePointerDatasetCompressed(hid_t locationID, const std::string&
     return returnError;
   }
 
+  error = setDatasetCreationOptions(propertListID, options);
+  if(error < 0)
+  {
+    returnError = -114;
+    error = H5Pclose(propertListID);
+    if(error < 0)
+    {
+      returnError = -115;
+    }
+    error = H5Sclose(dataspaceID);
+    if(error < 0)
+    {
+      returnError = -116;
+    }
+    return returnError;
+  }
+
   // Create the Dataset
 
   hid_t datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, propertListID, H5P_DEFAULT);
   if(datasetID >= 0)
   {
-    error = H5Dwrite(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    // The data is only read from during a write
+    error = detail::transferDataset(datasetID, dataType, sizeof(T), const_cast<T*>(data), true, transfer);
+    const bool written = error >= 0;
     if(error < 0)
     {
       std::cout << "Error Writing Data" << std::endl;
@@ -919,6 +1336,11 @@ inline herr_t writePointerDatasetCompressed(hid_t locationID, const std::string&
       std::cout << "Error Closing Dataset." << std::endl;
       returnError = -110;
     }
+    // Whatever the failed write did not reach is undefined, so the dataset must not stay behind
+    if(!written && H5Ldelete(locationID, datasetName.c_str(), H5P_DEFAULT) < 0)
+    {
+      std::cout << "Error Removing Dataset '" << datasetName << "'" << std::endl;
+    }
   }
   else
   {
@@ -952,15 +1374,251 @@ inline herr_t writePointerDatasetCompressed(hid_t locationID, const std::string&
  * @param data The data to write to the file
  * @param cDims The chunk dimensions
  * @param compressionLevel The compression level (0-9)
+ * @param options The dataset creation options
+ * @param transfer Controls splitting the write into slabs. A failed or cancelled write removes the dataset again.
  * @return Standard HDF5 error conditions
  */
 template <typename T>
 inline herr_t writeVectorDatasetCompressed(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& dims, const std::vector<T>& data, const std::vector<hsize_t>& cDims,
-                                           int32_t compressionLevel)
+                                           int32_t compressionLevel, const DatasetCreationOptions& options = DatasetCreationOptions(), const TransferOptions& transfer = TransferOptions())
+{
+  return writePointerDatasetCompressed(locationID, datasetName, static_cast<int32_t>(dims.size()), dims.data(), data.data(), static_cast<int32_t>(cDims.size()), cDims.data(), compressionLevel,
+                                       options, transfer);
+}
+#endif
+
+/**
+ * @brief One dataset of a readDatasets or writeDatasets call. makeDatasetBuffer fills
+ * this in for a std::vector.
+ */
+struct DatasetBuffer
+{
+  std::string name;                    // Path of the dataset relative to the location
+  hid_t dataType = -1;                 // Datatype of the elements in memory
+  std::vector<hsize_t> dims;           // Shape of the dataset to write. Set to the shape of the dataset by readDatasets.
+  void* data = nullptr;                // Elements to write or storage to read into
+  size_t numElements = 0;              // Number of elements data holds
+  std::function<void*(size_t)> resize; // Optional. Used by readDatasets to make room for the elements of the dataset.
+};
+
+/**
+ * @brief Describes a std::vector as a dataset of a readDatasets or writeDatasets call.
+ * readDatasets resizes the vector to fit the dataset.
+ * @param name Path of the dataset
+ * @param data The vector. It has to outlive the DatasetBuffer.
+ * @param dims Shape of the dataset to write. Defaults to one dimension of data.size() elements.
+ * @return
+ */
+template <typename T>
+inline DatasetBuffer makeDatasetBuffer(const std::string& name, std::vector<T>& data, const std::vector<hsize_t>& dims = {})
+{
+  DatasetBuffer buffer;
+  buffer.name = name;
+  buffer.dataType = HDFTypeForPrimitive<T>();
+  buffer.dims = dims.empty() ? std::vector<hsize_t>{data.size()} : dims;
+  buffer.data = data.data();
+  buffer.numElements = data.size();
+  buffer.resize = [&data](size_t numElements) -> void* {
+    data.resize(numElements);
+    return data.data();
+  };
+  return buffer;
+}
+
+/**
+ * @brief Describes a read only std::vector as a dataset of a writeDatasets call
+ * @param name Path of the dataset
+ * @param data The vector. It has to outlive the DatasetBuffer.
+ * @param dims Shape of the dataset. Defaults to one dimension of data.size() elements.
+ * @return
+ */
+template <typename T>
+inline DatasetBuffer makeDatasetBuffer(const std::string& name, const std::vector<T>& data, const std::vector<hsize_t>& dims = {})
+{
+  DatasetBuffer buffer;
+  buffer.name = name;
+  buffer.dataType = HDFTypeForPrimitive<T>();
+  buffer.dims = dims.empty() ? std::vector<hsize_t>{data.size()} : dims;
+  buffer.data = const_cast<T*>(data.data());
+  buffer.numElements = data.size();
+  return buffer;
+}
+
+/**
+ * @brief Reads several datasets below the same location in one call. All datasets are
+ * opened first and then read with a single H5Dread_multi call if the HDF5 library has it
+ * (1.14 and newer), otherwise one after the other with a shared transfer property list.
+ * This avoids the type and shape checks readVectorDataset does for every dataset.
+ * @param locationID The parent location of the datasets
+ * @param datasets The datasets to read. The dims of each entry are set to the shape of the dataset.
+ * @return Standard HDF5 error condition. Nothing is read if any dataset can not be opened
+ * or does not fit its buffer.
+ */
+inline herr_t readDatasets(hid_t locationID, std::vector<DatasetBuffer>& datasets)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  std::vector<hid_t> datasetIDs;
+  std::vector<hid_t> memoryTypes;
+  std::vector<void*> buffers;
+  datasetIDs.reserve(datasets.size());
+  herr_t error = 0;
+  for(auto& dataset : datasets)
+  {
+    hid_t datasetID = H5Dopen(locationID, dataset.name.c_str(), H5P_DEFAULT);
+    if(datasetID < 0)
+    {
+      std::cout << "Error opening dataset '" << dataset.name << "'" << std::endl;
+      error = -1;
+      break;
+    }
+    datasetIDs.push_back(datasetID);
+    hid_t dataspaceID = H5Dget_space(datasetID);
+    int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+    dataset.dims.resize(std::max(rank, 0));
+    H5Sget_simple_extent_dims(dataspaceID, dataset.dims.data(), nullptr);
+    size_t numElements = static_cast<size_t>(std::max<hssize_t>(H5Sget_simple_extent_npoints(dataspaceID), 0));
+    H5Sclose(dataspaceID);
+    if(dataset.resize)
+    {
+      dataset.data = dataset.resize(numElements);
+      dataset.numElements = numElements;
+    }
+    if(dataset.dataType < 0 || (numElements > 0 && dataset.data == nullptr) || dataset.numElements < numElements)
+    {
+      std::cout << "Error: the buffer for dataset '" << dataset.name << "' can not hold " << numElements << " elements" << std::endl;
+      error = -1;
+      break;
+    }
+    memoryTypes.push_back(dataset.dataType);
+    buffers.push_back(dataset.data);
+  }
+
+  if(error >= 0 && !datasetIDs.empty())
+  {
+#if H5_VERSION_GE(1, 14, 0)
+    std::vector<hid_t> dataspaces(datasetIDs.size(), H5S_ALL);
+    error = H5Dread_multi(datasetIDs.size(), datasetIDs.data(), memoryTypes.data(), dataspaces.data(), dataspaces.data(), H5P_DEFAULT, buffers.data());
+#else
+    hid_t transferPropertyList = H5Pcreate(H5P_DATASET_XFER);
+    for(size_t i = 0; i < datasetIDs.size() && error >= 0; i++)
+    {
+      error = H5Dread(datasetIDs[i], memoryTypes[i], H5S_ALL, H5S_ALL, transferPropertyList, buffers[i]);
+    }
+    H5Pclose(transferPropertyList);
+#endif
+    if(error < 0)
+    {
+      std::cout << "Error reading " << datasetIDs.size() << " datasets" << std::endl;
+    }
+  }
+
+  for(hid_t datasetID : datasetIDs)
+  {
+    H5Dclose(datasetID);
+  }
+  return error;
+}
+
+/**
+ * @brief Creates and writes several datasets below the same location in one call. All
+ * datasets are created first and then written with a single H5Dwrite_multi call if the
+ * HDF5 library has it (1.14 and newer), otherwise one after the other. The creation
+ * property list is shared between the datasets unless it depends on their shape.
+ * @param locationID The parent location of the datasets
+ * @param datasets The datasets to write. The datasets must not exist yet.
+ * @param options The dataset creation options
+ * @return Standard HDF5 error condition
+ */
+inline herr_t writeDatasets(hid_t locationID, const std::vector<DatasetBuffer>& datasets, const DatasetCreationOptions& options = DatasetCreationOptions())
 {
-  return writePointerDatasetCompressed(locationID, datasetName, static_cast<int32_t>(dims.size()), dims.data(), data.data(), static_cast<int32_t>(cDims.size()), cDims.data(), compressionLevel);
+  H5SUPPORT_MUTEX_LOCK()
+
+  hid_t sharedPropertyList = -1;
+  if(!options.extendible && options.layout != DatasetLayout::Automatic)
+  {
+    sharedPropertyList = createDatasetCreationPropertyList(options);
+    if(sharedPropertyList < 0)
+    {
+      return -1;
+    }
+  }
+
+  std::vector<hid_t> datasetIDs;
+  std::vector<hid_t> memoryTypes;
+  std::vector<const void*> buffers;
+  datasetIDs.reserve(datasets.size());
+  herr_t error = 0;
+  for(const auto& dataset : datasets)
+  {
+    int32_t rank = static_cast<int32_t>(dataset.dims.size());
+    size_t numElements = std::accumulate(dataset.dims.begin(), dataset.dims.end(), static_cast<size_t>(1), std::multiplies<size_t>());
+    if(dataset.dataType < 0 || dataset.numElements < numElements || (numElements > 0 && dataset.data == nullptr))
+    {
+      std::cout << "Error: the buffer for dataset '" << dataset.name << "' does not hold " << numElements << " elements" << std::endl;
+      error = -1;
+      break;
+    }
+    std::vector<hsize_t> maxDims(rank, H5S_UNLIMITED);
+    hid_t dataspaceID = rank == 0 ? H5Screate(H5S_SCALAR) : H5Screate_simple(rank, dataset.dims.data(), options.extendible ? maxDims.data() : nullptr);
+    hid_t propertyListID = sharedPropertyList;
+    if(propertyListID < 0)
+    {
+      propertyListID = createDatasetCreationPropertyList(options, rank, dataset.dims.data(), H5Tget_size(dataset.dataType));
+    }
+    hid_t datasetID = -1;
+    if(dataspaceID >= 0 && propertyListID >= 0)
+    {
+      datasetID = H5Dcreate(locationID, dataset.name.c_str(), dataset.dataType, dataspaceID, H5P_DEFAULT, propertyListID, H5P_DEFAULT);
+    }
+    if(propertyListID >= 0 && propertyListID != sharedPropertyList)
+    {
+      H5Pclose(propertyListID);
+    }
+    if(dataspaceID >= 0)
+    {
+      H5Sclose(dataspaceID);
+    }
+    if(datasetID < 0)
+    {
+      std::cout << "Error creating dataset '" << dataset.name << "'" << std::endl;
+      error = -1;
+      break;
+    }
+    datasetIDs.push_back(datasetID);
+    memoryTypes.push_back(dataset.dataType);
+    buffers.push_back(dataset.data);
+  }
+  if(sharedPropertyList >= 0)
+  {
+    H5Pclose(sharedPropertyList);
+  }
+
+  if(error >= 0 && !datasetIDs.empty())
+  {
+#if H5_VERSION_GE(1, 14, 0)
+    std::vector<hid_t> dataspaces(datasetIDs.size(), H5S_ALL);
+    error = H5Dwrite_multi(datasetIDs.size(), datasetIDs.data(), memoryTypes.data(), dataspaces.data(), dataspaces.data(), H5P_DEFAULT, buffers.data());
+#else
+    hid_t transferPropertyList = H5Pcreate(H5P_DATASET_XFER);
+    for(size_t i = 0; i < datasetIDs.size() && error >= 0; i++)
+    {
+      error = H5Dwrite(datasetIDs[i], memoryTypes[i], H5S_ALL, H5S_ALL, transferPropertyList, buffers[i]);
+    }
+    H5Pclose(transferPropertyList);
+#endif
+    if(error < 0)
+    {
+      std::cout << "Error writing " << datasetIDs.size() << " datasets" << std::endl;
+    }
+  }
+
+  for(hid_t datasetID : datasetIDs)
+  {
+    H5Dclose(datasetID);
+  }
+  return error;
 }
-#endif
 
 /**
  * @brief Creates a Dataset with the given name at the location defined by locationID from a std::array
@@ -985,10 +1643,11 @@ inline herr_t writeArrayDataset(hid_t locationID, const std::string& datasetName
  * @param locationID The Parent location to store the data
  * @param datasetName The name of the dataset
  * @param value The value to write to the HDF5 dataset
+ * @param options The dataset creation options. Scalars are stored compact by default.
  * @return Standard HDF5 error conditions
  */
 template <typename T>
-inline herr_t writeScalarDataset(hid_t locationID, const std::string& datasetName, const T& value)
+inline herr_t writeScalarDataset(hid_t locationID, const std::string& datasetName, const T& value, const DatasetCreationOptions& options = DatasetCreationOptions())
 {
   H5SUPPORT_MUTEX_LOCK()
 
@@ -1001,13 +1660,21 @@ inline herr_t writeScalarDataset(hid_t locationID, const std::string& datasetNam
     return -1;
   }
   // Create the DataSpace
-  hid_t dataspaceID = H5Screate_simple(static_cast<int>(rank), &(dims), nullptr);
+  hsize_t maxDims = H5S_UNLIMITED;
+  hid_t dataspaceID = H5Screate_simple(static_cast<int>(rank), &(dims), options.extendible ? &maxDims : nullptr);
   if(dataspaceID < 0)
   {
     return static_cast<herr_t>(dataspaceID);
   }
+  hid_t propertyListID = createDatasetCreationPropertyList(options, 1, &dims, sizeof(T));
+  if(propertyListID < 0)
+  {
+    H5Sclose(dataspaceID);
+    return static_cast<herr_t>(propertyListID);
+  }
   // Create the Dataset
-  hid_t datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t datasetID = H5Dcreate(locationID, datasetName.c_str(), dataType, dataspaceID, H5P_DEFAULT, propertyListID, H5P_DEFAULT);
+  H5Pclose(propertyListID);
   if(datasetID >= 0)
   {
     herr_t error = H5Dwrite(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, &value);
@@ -1654,10 +2321,11 @@ inline herr_t writeScalarAttribute(hid_t locationID, const std::string& objectNa
  * @param locationID The parent location that contains the dataset to read
  * @param datasetName The name of the dataset to read
  * @param data A Pointer to the PreAllocated Array of Data
+ * @param transfer Controls splitting the read into slabs
  * @return Standard HDF error condition
  */
 template <typename T>
-inline herr_t readPointerDataset(hid_t locationID, const std::string& datasetName, T* data)
+inline herr_t readPointerDataset(hid_t locationID, const std::string& datasetName, T* data, const TransferOptions& transfer = TransferOptions())
 {
   H5SUPPORT_MUTEX_LOCK()
 
@@ -1688,7 +2356,7 @@ inline herr_t readPointerDataset(hid_t locationID, const std::string& datasetNam
   }
   if(datasetID >= 0)
   {
-    error = H5Dread(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    error = detail::transferDataset(datasetID, dataType, sizeof(T), data, false, transfer);
     if(error < 0)
     {
       std::cout << "Error Reading Data." << std::endl;
@@ -1712,7 +2380,8 @@ inline herr_t readPointerDataset(hid_t locationID, const std::string& datasetNam
  * @param datasetName The name of the dataset to read
  * @param data A std::vector<T>. Note the vector WILL be resized to fit the data.
  * The best idea is to just allocate the vector but not to size it. The method
- * will size it for you.
+ * will size it for you. The size of the data is reserved against
+ * H5MemoryBudget::global() for the duration of the read.
  * @return Standard HDF error condition
  */
 template <typename T>
@@ -1747,13 +2416,23 @@ inline herr_t readVectorDataset(hid_t locationID, const std::string& datasetName
         error = H5Sget_simple_extent_dims(spaceId, dims.data(), nullptr);
         hsize_t numElements = std::accumulate(dims.cbegin(), dims.cend(), static_cast<hsize_t>(1), std::multiplies<hsize_t>());
         // std::cout << "NumElements: " << numElements << std::endl;
-        // Resize the vector
-        data.resize(numElements);
-        error = H5Dread(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
-        if(error < 0)
+        // The buffer counts against the memory budget while the read is in flight
+        H5MemoryBudget::Reservation reservation(static_cast<size_t>(numElements) * sizeof(T));
+        if(!reservation.isValid())
         {
-          std::cout << "Error Reading Data.'" << datasetName << "'" << std::endl;
-          returnError = error;
+          std::cout << "Error reserving memory to read '" << datasetName << "'" << std::endl;
+          returnError = -1;
+        }
+        else
+        {
+          // Resize the vector
+          data.resize(numElements);
+          error = H5Dread(datasetID, dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
+          if(error < 0)
+          {
+            std::cout << "Error Reading Data.'" << datasetName << "'" << std::endl;
+            returnError = error;
+          }
         }
       }
       error = H5Sclose(spaceId);
@@ -2830,6 +3509,599 @@ inline herr_t getDatasetInfo(hid_t locationID, const std::string& datasetName, s
   return returnError;
 }
 
+namespace detail
+{
+inline constexpr size_t k_CopyBufferSize = 64 * 1024 * 1024;
+
+/**
+ * @brief Copies the elements of one dataset into another dataset in blocks along the
+ * slowest dimension so at most bufferSize bytes are held in memory. All dimensions but
+ * the slowest one must match.
+ * @param sourceDatasetID
+ * @param destinationDatasetID
+ * @param destinationOffset Index along the slowest dimension of the destination where the first block is written
+ * @param bufferSize
+ * @return Standard HDF5 error condition
+ */
+inline herr_t copyDatasetElements(hid_t sourceDatasetID, hid_t destinationDatasetID, hsize_t destinationOffset, size_t bufferSize)
+{
+  hid_t typeID = H5Dget_type(sourceDatasetID);
+  hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+  hid_t destinationSpaceID = H5Dget_space(destinationDatasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+  std::vector<hsize_t> dims(std::max(rank, 0));
+  H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+  size_t typeSize = H5Tget_size(typeID);
+  bool variableLength = H5Tdetect_class(typeID, H5T_VLEN) > 0 || H5Tis_variable_str(typeID) > 0;
+
+  herr_t error = 0;
+  if(rank <= 0)
+  {
+    std::vector<uint8_t> buffer(typeSize);
+    error = H5Dread(sourceDatasetID, typeID, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    error = error < 0 ? error : H5Dwrite(destinationDatasetID, typeID, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    if(error >= 0 && variableLength)
+    {
+      H5Dvlen_reclaim(typeID, dataspaceID, H5P_DEFAULT, buffer.data());
+    }
+  }
+  else
+  {
+    size_t rowSize = typeSize;
+    for(int32_t i = 1; i < rank; i++)
+    {
+      rowSize *= dims[i];
+    }
+    hsize_t rowsPerBlock = std::max<hsize_t>(1, bufferSize / std::max<size_t>(rowSize, 1));
+    H5MemoryBudget::Reservation reservation(static_cast<size_t>(std::min(rowsPerBlock, dims[0])) * rowSize);
+    if(!reservation.isValid())
+    {
+      error = -1;
+    }
+    std::vector<uint8_t> buffer(reservation.bytes());
+    std::vector<hsize_t> start(rank, 0);
+    std::vector<hsize_t> count = dims;
+    for(hsize_t row = 0; row < dims[0] && error >= 0; row += rowsPerBlock)
+    {
+      start[0] = row;
+      count[0] = std::min(rowsPerBlock, dims[0] - row);
+      hid_t memorySpaceID = H5Screate_simple(rank, count.data(), nullptr);
+      error = H5Sselect_hyperslab(dataspaceID, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+      error = error < 0 ? error : H5Dread(sourceDatasetID, typeID, memorySpaceID, dataspaceID, H5P_DEFAULT, buffer.data());
+      start[0] = row + destinationOffset;
+      error = error < 0 ? error : H5Sselect_hyperslab(destinationSpaceID, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+      error = error < 0 ? error : H5Dwrite(destinationDatasetID, typeID, memorySpaceID, destinationSpaceID, H5P_DEFAULT, buffer.data());
+      if(error >= 0 && variableLength)
+      {
+        H5Dvlen_reclaim(typeID, memorySpaceID, H5P_DEFAULT, buffer.data());
+      }
+      H5Sclose(memorySpaceID);
+    }
+  }
+  H5Sclose(destinationSpaceID);
+  H5Sclose(dataspaceID);
+  H5Tclose(typeID);
+  return error;
+}
+
+/**
+ * @brief Copies every allocated chunk of a dataset into another dataset without running
+ * the chunks through the filter pipeline
+ * @param sourceDatasetID
+ * @param destinationDatasetID
+ * @param destinationOffset Index along the slowest dimension of the destination that the first chunk maps to. Must be a multiple of the chunk size.
+ * @return Standard HDF5 error condition
+ */
+inline herr_t copyChunks(hid_t sourceDatasetID, hid_t destinationDatasetID, hsize_t destinationOffset)
+{
+#if H5_VERSION_GE(1, 10, 5)
+  hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+  hsize_t numChunks = 0;
+  herr_t error = H5Dget_num_chunks(sourceDatasetID, dataspaceID, &numChunks);
+  std::vector<hsize_t> offset(std::max(rank, 1), 0);
+  std::vector<uint8_t> buffer;
+  for(hsize_t i = 0; i < numChunks && error >= 0; i++)
+  {
+    uint32_t filterMask = 0;
+    haddr_t address = 0;
+    hsize_t chunkSize = 0;
+    error = H5Dget_chunk_info(sourceDatasetID, dataspaceID, i, offset.data(), &filterMask, &address, &chunkSize);
+    if(error < 0)
+    {
+      break;
+    }
+    buffer.resize(static_cast<size_t>(chunkSize));
+    error = H5Dread_chunk(sourceDatasetID, H5P_DEFAULT, offset.data(), &filterMask, buffer.data());
+    offset[0] += destinationOffset;
+    error = error < 0 ? error : H5Dwrite_chunk(destinationDatasetID, H5P_DEFAULT, filterMask, offset.data(), buffer.size(), buffer.data());
+  }
+  H5Sclose(dataspaceID);
+  return error;
+#else
+  return -1;
+#endif
+}
+} // namespace detail
+
+/**
+ * @brief Checks if the stored chunks of one dataset can be written into another dataset
+ * as they are. Both datasets must be chunked with the same chunk shape, store the same
+ * datatype and run the same filter pipeline. Datatypes holding variable length data or
+ * references never qualify: their stored values point into the global heap or at objects
+ * of the source file.
+ * @param sourceDatasetID
+ * @param destinationDatasetID
+ * @return
+ */
+inline bool canCopyChunksRaw(hid_t sourceDatasetID, hid_t destinationDatasetID)
+{
+#if H5_VERSION_GE(1, 10, 5)
+  hid_t sourceTypeID = H5Dget_type(sourceDatasetID);
+  hid_t destinationTypeID = H5Dget_type(destinationDatasetID);
+  bool compatible = H5Tequal(sourceTypeID, destinationTypeID) > 0;
+  compatible = compatible && H5Tdetect_class(sourceTypeID, H5T_VLEN) <= 0 && H5Tis_variable_str(sourceTypeID) <= 0 && H5Tdetect_class(sourceTypeID, H5T_REFERENCE) <= 0;
+  H5Tclose(destinationTypeID);
+  H5Tclose(sourceTypeID);
+
+  hid_t sourcePropertyList = H5Dget_create_plist(sourceDatasetID);
+  hid_t destinationPropertyList = H5Dget_create_plist(destinationDatasetID);
+  compatible = compatible && H5Pget_layout(sourcePropertyList) == H5D_CHUNKED && H5Pget_layout(destinationPropertyList) == H5D_CHUNKED;
+  if(compatible)
+  {
+    std::array<hsize_t, H5S_MAX_RANK> sourceChunks = {0};
+    std::array<hsize_t, H5S_MAX_RANK> destinationChunks = {0};
+    int32_t rank = H5Pget_chunk(sourcePropertyList, H5S_MAX_RANK, sourceChunks.data());
+    compatible = rank == H5Pget_chunk(destinationPropertyList, H5S_MAX_RANK, destinationChunks.data()) && sourceChunks == destinationChunks;
+  }
+  int32_t numFilters = H5Pget_nfilters(sourcePropertyList);
+  compatible = compatible && numFilters == H5Pget_nfilters(destinationPropertyList);
+  for(int32_t i = 0; i < numFilters && compatible; i++)
+  {
+    std::array<uint32_t, 2> flags = {0, 0};
+    std::array<size_t, 2> numValues = {8, 8};
+    std::array<std::array<uint32_t, 8>, 2> values = {};
+    std::array<uint32_t, 2> filterConfig = {0, 0};
+    H5Z_filter_t sourceFilter = H5Pget_filter2(sourcePropertyList, i, &flags[0], &numValues[0], values[0].data(), 0, nullptr, &filterConfig[0]);
+    H5Z_filter_t destinationFilter = H5Pget_filter2(destinationPropertyList, i, &flags[1], &numValues[1], values[1].data(), 0, nullptr, &filterConfig[1]);
+    compatible = sourceFilter >= 0 && sourceFilter == destinationFilter && flags[0] == flags[1] && numValues[0] == numValues[1] && values[0] == values[1];
+  }
+  H5Pclose(destinationPropertyList);
+  H5Pclose(sourcePropertyList);
+  return compatible;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Copies a dataset into a new dataset, which may be in a different file. The new
+ * dataset gets the creation properties of the source dataset unless a creation property
+ * list is given. If the chunks of the source can be stored in the new dataset as they are
+ * they are copied without decompressing and recompressing them, otherwise the data is read
+ * and written again.
+ * @param sourceLocationID
+ * @param sourceName
+ * @param destinationLocationID
+ * @param destinationName
+ * @param datasetCreationPropertyList Creation properties of the new dataset or H5P_DEFAULT to use the ones of the source
+ * @return Standard HDF5 error condition
+ */
+inline herr_t copyDatasetRaw(hid_t sourceLocationID, const std::string& sourceName, hid_t destinationLocationID, const std::string& destinationName, hid_t datasetCreationPropertyList = H5P_DEFAULT)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  hid_t sourceDatasetID = H5Dopen(sourceLocationID, sourceName.c_str(), H5P_DEFAULT);
+  if(sourceDatasetID < 0)
+  {
+    std::cout << "Error opening dataset '" << sourceName << "'" << std::endl;
+    return -1;
+  }
+  hid_t typeID = H5Dget_type(sourceDatasetID);
+  hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+  hid_t dcpl = datasetCreationPropertyList == H5P_DEFAULT ? H5Dget_create_plist(sourceDatasetID) : H5Pcopy(datasetCreationPropertyList);
+  hid_t destinationDatasetID = H5Dcreate(destinationLocationID, destinationName.c_str(), typeID, dataspaceID, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  herr_t error = -1;
+  if(destinationDatasetID >= 0)
+  {
+    if(canCopyChunksRaw(sourceDatasetID, destinationDatasetID))
+    {
+      error = detail::copyChunks(sourceDatasetID, destinationDatasetID, 0);
+    }
+    else
+    {
+      error = detail::copyDatasetElements(sourceDatasetID, destinationDatasetID, 0, detail::k_CopyBufferSize);
+    }
+    H5Dclose(destinationDatasetID);
+  }
+  H5Pclose(dcpl);
+  H5Sclose(dataspaceID);
+  H5Tclose(typeID);
+  H5Dclose(sourceDatasetID);
+  if(error < 0)
+  {
+    std::cout << "Error copying dataset '" << sourceName << "' to '" << destinationName << "'" << std::endl;
+  }
+  return error;
+}
+
+/**
+ * @brief Creates a dataset that holds a list of datasets one after the other along their
+ * slowest dimension. All sources must have the same datatype and the same size in every
+ * other dimension. The new dataset gets the creation properties of the first source and
+ * its slowest dimension is unlimited if the first source is chunked. The chunks of every
+ * source that starts on a chunk boundary of the new dataset and has a compatible chunk
+ * shape and filter pipeline are copied without decompressing them, the others are read
+ * and written again.
+ * @param sources Pairs of location and dataset name, in the order they are concatenated
+ * @param destinationLocationID
+ * @param destinationName
+ * @return Standard HDF5 error condition
+ */
+inline herr_t concatenateDatasetsRaw(const std::vector<std::pair<hid_t, std::string>>& sources, hid_t destinationLocationID, const std::string& destinationName)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  if(sources.empty())
+  {
+    return -1;
+  }
+
+  std::vector<hid_t> sourceDatasetIDs;
+  std::vector<hsize_t> dims;
+  std::vector<hsize_t> totalDims;
+  hid_t typeID = -1;
+  herr_t error = 0;
+  for(const auto& source : sources)
+  {
+    hid_t datasetID = H5Dopen(source.first, source.second.c_str(), H5P_DEFAULT);
+    if(datasetID < 0)
+    {
+      std::cout << "Error opening dataset '" << source.second << "'" << std::endl;
+      error = -1;
+      break;
+    }
+    sourceDatasetIDs.push_back(datasetID);
+    hid_t dataspaceID = H5Dget_space(datasetID);
+    dims.resize(std::max(H5Sget_simple_extent_ndims(dataspaceID), 0));
+    H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+    H5Sclose(dataspaceID);
+    hid_t sourceTypeID = H5Dget_type(datasetID);
+    if(typeID < 0)
+    {
+      typeID = sourceTypeID;
+      totalDims = dims;
+      continue;
+    }
+    bool sameType = H5Tequal(typeID, sourceTypeID) > 0;
+    H5Tclose(sourceTypeID);
+    if(!sameType || dims.empty() || dims.size() != totalDims.size() || !std::equal(dims.begin() + 1, dims.end(), totalDims.begin() + 1))
+    {
+      std::cout << "Error: dataset '" << source.second << "' does not match the type or shape of the other datasets" << std::endl;
+      error = -1;
+      break;
+    }
+    totalDims[0] += dims[0];
+  }
+  if(error >= 0 && totalDims.empty())
+  {
+    std::cout << "Error: scalar datasets can not be concatenated" << std::endl;
+    error = -1;
+  }
+
+  hid_t destinationDatasetID = -1;
+  if(error >= 0)
+  {
+    hid_t dcpl = H5Dget_create_plist(sourceDatasetIDs.front());
+    std::vector<hsize_t> maxDims = totalDims;
+    if(H5Pget_layout(dcpl) == H5D_CHUNKED)
+    {
+      maxDims[0] = H5S_UNLIMITED;
+    }
+    else
+    {
+      H5Pset_layout(dcpl, H5D_CONTIGUOUS);
+    }
+    hid_t dataspaceID = H5Screate_simple(static_cast<int32_t>(totalDims.size()), totalDims.data(), maxDims.data());
+    destinationDatasetID = H5Dcreate(destinationLocationID, destinationName.c_str(), typeID, dataspaceID, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    error = destinationDatasetID < 0 ? -1 : 0;
+    H5Sclose(dataspaceID);
+    H5Pclose(dcpl);
+  }
+
+  std::array<hsize_t, H5S_MAX_RANK> chunks = {0};
+  if(destinationDatasetID >= 0)
+  {
+    hid_t dcpl = H5Dget_create_plist(destinationDatasetID);
+    if(H5Pget_layout(dcpl) == H5D_CHUNKED)
+    {
+      H5Pget_chunk(dcpl, H5S_MAX_RANK, chunks.data());
+    }
+    H5Pclose(dcpl);
+  }
+
+  hsize_t offset = 0;
+  for(hid_t datasetID : sourceDatasetIDs)
+  {
+    if(error < 0)
+    {
+      break;
+    }
+    if(chunks[0] > 0 && offset % chunks[0] == 0 && canCopyChunksRaw(datasetID, destinationDatasetID))
+    {
+      error = detail::copyChunks(datasetID, destinationDatasetID, offset);
+    }
+    else
+    {
+      error = detail::copyDatasetElements(datasetID, destinationDatasetID, offset, detail::k_CopyBufferSize);
+    }
+    hid_t dataspaceID = H5Dget_space(datasetID);
+    H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+    H5Sclose(dataspaceID);
+    offset += dims[0];
+  }
+
+  if(destinationDatasetID >= 0)
+  {
+    H5Dclose(destinationDatasetID);
+  }
+  if(typeID >= 0)
+  {
+    H5Tclose(typeID);
+  }
+  for(hid_t datasetID : sourceDatasetIDs)
+  {
+    H5Dclose(datasetID);
+  }
+  if(error < 0)
+  {
+    std::cout << "Error concatenating datasets into '" << destinationName << "'" << std::endl;
+  }
+  return error;
+}
+
+namespace detail
+{
+/**
+ * @brief Element coordinates in the order readPoints and writePoints hand them to HDF5
+ */
+struct PointSelection
+{
+  std::vector<hsize_t> coords; // Unique coordinates sorted by chunk and then by position
+  std::vector<size_t> indices; // Index into the unique coordinates for every point in the order of the caller
+  size_t numPoints = 0;        // Number of unique coordinates
+};
+
+/**
+ * @brief Opens a dataset for point access. The chunk cache is enlarged if it can not
+ * hold a single chunk so no chunk is decoded more than once.
+ * @param locationID
+ * @param datasetName
+ * @param chunkDims Set to the chunk dimensions, or the largest possible value if the dataset is not chunked
+ * @return The dataset id. Negative value is error.
+ */
+inline hid_t openDatasetForPoints(hid_t locationID, const std::string& datasetName, std::vector<hsize_t>& chunkDims)
+{
+  hid_t datasetID = H5Dopen(locationID, datasetName.c_str(), H5P_DEFAULT);
+  if(datasetID < 0)
+  {
+    return datasetID;
+  }
+  hid_t dataspaceID = H5Dget_space(datasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+  H5Sclose(dataspaceID);
+  chunkDims.assign(std::max(rank, 0), std::numeric_limits<hsize_t>::max());
+
+  hid_t dcpl = H5Dget_create_plist(datasetID);
+  if(rank > 0 && H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_chunk(dcpl, rank, chunkDims.data()) == rank)
+  {
+    hid_t typeID = H5Dget_type(datasetID);
+    size_t chunkBytes = std::accumulate(chunkDims.begin(), chunkDims.end(), H5Tget_size(typeID), std::multiplies<size_t>());
+    H5Tclose(typeID);
+    hid_t dapl = H5Dget_access_plist(datasetID);
+    size_t numSlots = 0;
+    size_t cacheSize = 0;
+    double w0 = 0.0;
+    H5Pget_chunk_cache(dapl, &numSlots, &cacheSize, &w0);
+    if(chunkBytes > cacheSize)
+    {
+      H5Dclose(datasetID);
+      H5Pset_chunk_cache(dapl, numSlots, chunkBytes, w0);
+      datasetID = H5Dopen(locationID, datasetName.c_str(), dapl);
+    }
+    H5Pclose(dapl);
+  }
+  H5Pclose(dcpl);
+  return datasetID;
+}
+
+/**
+ * @brief Sorts element coordinates so that all points of a chunk are next to each other
+ * and in file order, and removes duplicate coordinates
+ * @param coords Coordinates of the points, rank values per point
+ * @param chunkDims Chunk dimensions of the dataset
+ * @param selection
+ */
+inline void sortPoints(const std::vector<hsize_t>& coords, const std::vector<hsize_t>& chunkDims, PointSelection& selection)
+{
+  size_t rank = chunkDims.size();
+  size_t numPoints = coords.size() / rank;
+  std::vector<size_t> order(numPoints);
+  std::iota(order.begin(), order.end(), 0);
+  auto lessThan = [&](size_t a, size_t b) {
+    const hsize_t* pointA = coords.data() + a * rank;
+    const hsize_t* pointB = coords.data() + b * rank;
+    for(size_t i = 0; i < rank; i++)
+    {
+      if(pointA[i] / chunkDims[i] != pointB[i] / chunkDims[i])
+      {
+        return pointA[i] / chunkDims[i] < pointB[i] / chunkDims[i];
+      }
+    }
+    return std::lexicographical_compare(pointA, pointA + rank, pointB, pointB + rank);
+  };
+  std::stable_sort(order.begin(), order.end(), lessThan);
+
+  selection.coords.clear();
+  selection.coords.reserve(coords.size());
+  selection.indices.resize(numPoints);
+  selection.numPoints = 0;
+  for(size_t i = 0; i < numPoints; i++)
+  {
+    const hsize_t* point = coords.data() + order[i] * rank;
+    if(i == 0 || lessThan(order[i - 1], order[i]))
+    {
+      selection.coords.insert(selection.coords.end(), point, point + rank);
+      selection.numPoints++;
+    }
+    selection.indices[order[i]] = selection.numPoints - 1;
+  }
+}
+
+/**
+ * @brief Reads or writes the points of a sorted selection
+ * @param datasetID
+ * @param selection
+ * @param dataType Memory type of the buffer
+ * @param buffer One element per unique point
+ * @param write
+ * @return Standard HDF5 error condition
+ */
+inline herr_t transferPoints(hid_t datasetID, const PointSelection& selection, hid_t dataType, void* buffer, bool write)
+{
+  hid_t dataspaceID = H5Dget_space(datasetID);
+  std::vector<hsize_t> dims(std::max(H5Sget_simple_extent_ndims(dataspaceID), 1));
+  H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+  for(size_t i = 0; i < selection.coords.size(); i++)
+  {
+    if(selection.coords[i] >= dims[i % dims.size()])
+    {
+      std::cout << "Error: point coordinates are outside of the dataset" << std::endl;
+      H5Sclose(dataspaceID);
+      return -1;
+    }
+  }
+  herr_t error = H5Sselect_elements(dataspaceID, H5S_SELECT_SET, selection.numPoints, selection.coords.data());
+  if(error >= 0)
+  {
+    hsize_t numPoints = selection.numPoints;
+    hid_t memorySpaceID = H5Screate_simple(1, &numPoints, nullptr);
+    if(write)
+    {
+      error = H5Dwrite(datasetID, dataType, memorySpaceID, dataspaceID, H5P_DEFAULT, buffer);
+    }
+    else
+    {
+      error = H5Dread(datasetID, dataType, memorySpaceID, dataspaceID, H5P_DEFAULT, buffer);
+    }
+    H5Sclose(memorySpaceID);
+  }
+  H5Sclose(dataspaceID);
+  return error;
+}
+} // namespace detail
+
+/**
+ * @brief Reads scattered elements of a dataset. The points are sorted by chunk before
+ * they are read so every chunk is decoded at most once, and the values are returned in
+ * the order of the coordinates.
+ * @param locationID The parent location of the dataset
+ * @param datasetName The name of the dataset
+ * @param coords Coordinates of the points with one value per dimension of the dataset for every point
+ * @param data Set to one value per point
+ * @return Standard HDF5 error condition
+ */
+template <typename T>
+inline herr_t readPoints(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& coords, std::vector<T>& data)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  std::vector<hsize_t> chunkDims;
+  hid_t datasetID = detail::openDatasetForPoints(locationID, datasetName, chunkDims);
+  if(datasetID < 0)
+  {
+    std::cout << "Error opening dataset '" << datasetName << "'" << std::endl;
+    return -1;
+  }
+  if(chunkDims.empty() || coords.size() % chunkDims.size() != 0)
+  {
+    std::cout << "Error: the number of coordinates does not match the rank of dataset '" << datasetName << "'" << std::endl;
+    H5Dclose(datasetID);
+    return -1;
+  }
+  data.clear();
+  if(coords.empty())
+  {
+    return H5Dclose(datasetID);
+  }
+
+  detail::PointSelection selection;
+  detail::sortPoints(coords, chunkDims, selection);
+  std::vector<T> values(selection.numPoints);
+  herr_t error = detail::transferPoints(datasetID, selection, HDFTypeForPrimitive<T>(), values.data(), false);
+  H5Dclose(datasetID);
+  if(error < 0)
+  {
+    std::cout << "Error reading points of dataset '" << datasetName << "'" << std::endl;
+    return error;
+  }
+  data.resize(selection.indices.size());
+  for(size_t i = 0; i < selection.indices.size(); i++)
+  {
+    data[i] = values[selection.indices[i]];
+  }
+  return error;
+}
+
+/**
+ * @brief Writes scattered elements of an existing dataset. The points are sorted by
+ * chunk before they are written so every chunk is decoded at most once. If a point is
+ * given more than once the last value for it is written.
+ * @param locationID The parent location of the dataset
+ * @param datasetName The name of the dataset
+ * @param coords Coordinates of the points with one value per dimension of the dataset for every point
+ * @param data One value per point
+ * @return Standard HDF5 error condition
+ */
+template <typename T>
+inline herr_t writePoints(hid_t locationID, const std::string& datasetName, const std::vector<hsize_t>& coords, const std::vector<T>& data)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  std::vector<hsize_t> chunkDims;
+  hid_t datasetID = detail::openDatasetForPoints(locationID, datasetName, chunkDims);
+  if(datasetID < 0)
+  {
+    std::cout << "Error opening dataset '" << datasetName << "'" << std::endl;
+    return -1;
+  }
+  if(chunkDims.empty() || coords.size() != data.size() * chunkDims.size())
+  {
+    std::cout << "Error: the number of coordinates does not match the rank of dataset '" << datasetName << "' and the number of values" << std::endl;
+    H5Dclose(datasetID);
+    return -1;
+  }
+  if(coords.empty())
+  {
+    return H5Dclose(datasetID);
+  }
+
+  detail::PointSelection selection;
+  detail::sortPoints(coords, chunkDims, selection);
+  std::vector<T> values(selection.numPoints);
+  for(size_t i = 0; i < selection.indices.size(); i++)
+  {
+    values[selection.indices[i]] = data[i];
+  }
+  herr_t error = detail::transferPoints(datasetID, selection, HDFTypeForPrimitive<T>(), values.data(), true);
+  H5Dclose(datasetID);
+  if(error < 0)
+  {
+    std::cout << "Error writing points of dataset '" << datasetName << "'" << std::endl;
+  }
+  return error;
+}
+
 }; // namespace H5Lite
 
 }; // namespace H5Support
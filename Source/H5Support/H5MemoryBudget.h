@@ -0,0 +1,373 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5MemoryBudget class limits the number of bytes that I/O buffers may hold at the
+ * same time. Readers, writers and caches in H5Support reserve the size of their buffers against
+ * the process wide budget returned by global() before they allocate them and release it once the
+ * buffers are handed over or freed. Without a limit reservations always succeed and are only
+ * counted, so the current and peak usage can be reported either way.
+ *
+ * A reservation that does not fit either waits for other reservations to be released or fails
+ * right away, depending on the policy. A reservation larger than the whole limit always fails.
+ */
+class H5MemoryBudget
+{
+public:
+  /**
+   * @brief What happens to a reservation that does not fit into the budget
+   */
+  enum class Policy
+  {
+    Block,   // Wait until enough bytes are released
+    FailFast // Fail the reservation right away
+  };
+
+  /**
+   * @brief Bytes reserved against a budget that are released again when the reservation goes out of scope
+   */
+  class Reservation
+  {
+  public:
+    Reservation() = default;
+
+    /**
+     * @brief Reserves bytes against a budget. Check isValid() to see if the reservation succeeded.
+     * @param bytes
+     * @param budget
+     */
+    explicit Reservation(size_t bytes, H5MemoryBudget& budget = H5MemoryBudget::global())
+    {
+      if(budget.reserve(bytes))
+      {
+        m_Budget = &budget;
+        m_Bytes = bytes;
+      }
+    }
+
+    /**
+     * @brief Reserves bytes against a budget only if they fit right now. Never waits.
+     * @param bytes
+     * @param budget
+     * @return The reservation. Check isValid() to see if it succeeded.
+     */
+    static Reservation tryReserve(size_t bytes, H5MemoryBudget& budget = H5MemoryBudget::global())
+    {
+      Reservation reservation;
+      if(budget.tryReserve(bytes))
+      {
+        reservation.m_Budget = &budget;
+        reservation.m_Bytes = bytes;
+      }
+      return reservation;
+    }
+
+    ~Reservation()
+    {
+      release();
+    }
+
+    Reservation(const Reservation&) = delete;            // Copy Constructor Not Implemented
+    Reservation& operator=(const Reservation&) = delete; // Copy Assignment Not Implemented
+
+    Reservation(Reservation&& other) noexcept
+    : m_Budget(other.m_Budget)
+    , m_Bytes(other.m_Bytes)
+    {
+      other.m_Budget = nullptr;
+      other.m_Bytes = 0;
+    }
+
+    Reservation& operator=(Reservation&& other) noexcept
+    {
+      if(this != &other)
+      {
+        release();
+        m_Budget = other.m_Budget;
+        m_Bytes = other.m_Bytes;
+        other.m_Budget = nullptr;
+        other.m_Bytes = 0;
+      }
+      return *this;
+    }
+
+    /**
+     * @brief Returns true if the bytes were reserved
+     * @return
+     */
+    bool isValid() const
+    {
+      return m_Budget != nullptr;
+    }
+
+    /**
+     * @brief Returns the number of reserved bytes
+     * @return
+     */
+    size_t bytes() const
+    {
+      return m_Bytes;
+    }
+
+    /**
+     * @brief Gives the bytes back to the budget. The reservation is empty afterwards.
+     */
+    void release()
+    {
+      if(m_Budget != nullptr)
+      {
+        m_Budget->release(m_Bytes);
+      }
+      m_Budget = nullptr;
+      m_Bytes = 0;
+    }
+
+  private:
+    H5MemoryBudget* m_Budget = nullptr;
+    size_t m_Bytes = 0;
+  };
+
+  /**
+   * @brief Returns the budget that H5Support reserves its buffers against
+   * @return
+   */
+  static H5MemoryBudget& global()
+  {
+    static H5MemoryBudget budget;
+    return budget;
+  }
+
+  /**
+   * @brief Creates a budget
+   * @param limit Maximum number of bytes that may be reserved at once. Zero means no limit.
+   * @param policy
+   */
+  explicit H5MemoryBudget(size_t limit = 0, Policy policy = Policy::Block)
+  : m_Limit(limit)
+  , m_Policy(policy)
+  {
+  }
+
+  H5MemoryBudget(const H5MemoryBudget&) = delete;            // Copy Constructor Not Implemented
+  H5MemoryBudget(H5MemoryBudget&&) = delete;                 // Move Constructor Not Implemented
+  H5MemoryBudget& operator=(const H5MemoryBudget&) = delete; // Copy Assignment Not Implemented
+  H5MemoryBudget& operator=(H5MemoryBudget&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Sets the maximum number of bytes that may be reserved at once. Zero means no limit.
+   * Reservations that already exist are kept even if they exceed the new limit.
+   * @param limit
+   */
+  void setLimit(size_t limit)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Limit = limit;
+    }
+    m_Released.notify_all();
+  }
+
+  /**
+   * @brief Returns the maximum number of bytes that may be reserved at once
+   * @return
+   */
+  size_t limit() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Limit;
+  }
+
+  /**
+   * @brief Sets what happens to reservations that do not fit
+   * @param policy
+   */
+  void setPolicy(Policy policy)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Policy = policy;
+    }
+    m_Released.notify_all();
+  }
+
+  /**
+   * @brief Returns what happens to reservations that do not fit
+   * @return
+   */
+  Policy policy() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Policy;
+  }
+
+  /**
+   * @brief Reserves bytes. Depending on the policy this waits until the bytes fit or fails right away.
+   * @param bytes
+   * @return True if the bytes were reserved
+   */
+  bool reserve(size_t bytes)
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while(!fits(bytes))
+    {
+      if(m_Policy == Policy::FailFast || bytes > m_Limit)
+      {
+        m_NumDenied++;
+        lock.unlock();
+        std::cout << "H5MemoryBudget: Reserving " << bytes << " bytes would exceed the limit of " << limit() << " bytes" << std::endl;
+        return false;
+      }
+      m_NumWaits++;
+      m_Released.wait(lock);
+    }
+    add(bytes);
+    return true;
+  }
+
+  /**
+   * @brief Reserves bytes if they fit right now. Never waits and never reports a failure.
+   * @param bytes
+   * @return True if the bytes were reserved
+   */
+  bool tryReserve(size_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if(!fits(bytes))
+    {
+      return false;
+    }
+    add(bytes);
+    return true;
+  }
+
+  /**
+   * @brief Gives reserved bytes back
+   * @param bytes
+   */
+  void release(size_t bytes)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Current -= std::min(bytes, m_Current);
+    }
+    m_Released.notify_all();
+  }
+
+  /**
+   * @brief Returns the number of bytes reserved right now
+   * @return
+   */
+  size_t current() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Current;
+  }
+
+  /**
+   * @brief Returns the largest number of bytes reserved at once since the budget was created or resetPeak() was called
+   * @return
+   */
+  size_t peak() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Peak;
+  }
+
+  /**
+   * @brief Sets the peak to the number of bytes reserved right now
+   */
+  void resetPeak()
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Peak = m_Current;
+  }
+
+  /**
+   * @brief Returns how often a reservation had to wait for bytes to be released
+   * @return
+   */
+  size_t numWaits() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_NumWaits;
+  }
+
+  /**
+   * @brief Returns how often a reservation failed
+   * @return
+   */
+  size_t numDenied() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_NumDenied;
+  }
+
+private:
+  size_t m_Limit = 0;
+  Policy m_Policy = Policy::Block;
+  size_t m_Current = 0;
+  size_t m_Peak = 0;
+  size_t m_NumWaits = 0;
+  size_t m_NumDenied = 0;
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Released;
+
+  bool fits(size_t bytes) const
+  {
+    return m_Limit == 0 || (bytes <= m_Limit && m_Current <= m_Limit - bytes);
+  }
+
+  void add(size_t bytes)
+  {
+    m_Current += bytes;
+    m_Peak = std::max(m_Peak, m_Current);
+  }
+};
+
+}; // namespace H5Support
@@ -0,0 +1,578 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief HDF5 virtual file driver that keeps a user-space cache of fixed size
+ * pages in front of another driver (sec2 unless a backing file access property
+ * list is given). Small reads, like the metadata reads HDF5 issues while opening
+ * a file or walking its groups, are served from cached pages. A miss loads every
+ * missing page of the request with a single backing read, and sequential misses
+ * also read ahead. Reads of at least bypassSize bytes go straight to the backing
+ * driver so that large raw data transfers do not flush the cache.
+ *
+ * Writes are written through to the backing driver and update any cached page
+ * they overlap, so the cache never holds dirty data.
+ */
+namespace H5PageCacheDriver
+{
+
+/**
+ * @brief Counters describing how well the cache is doing
+ */
+struct Statistics
+{
+  std::atomic<uint64_t> hits = {0};             // Pages served from the cache
+  std::atomic<uint64_t> misses = {0};           // Pages that had to be loaded
+  std::atomic<uint64_t> readAheadPages = {0};   // Pages loaded beyond the requested range
+  std::atomic<uint64_t> evictions = {0};        // Pages dropped to stay within the capacity
+  std::atomic<uint64_t> backingReads = {0};     // Read calls issued to the backing driver
+  std::atomic<uint64_t> backingBytesRead = {0}; // Bytes read from the backing driver
+};
+
+/**
+ * @brief Driver settings stored in the file access property list
+ */
+struct Config
+{
+  size_t pageSize = 64 * 1024;                       // Size of a cached page in bytes
+  size_t capacity = 1024;                            // Maximum number of cached pages
+  size_t readAheadPages = 4;                         // Extra pages loaded after a sequential miss
+  size_t bypassSize = 4 * 1024 * 1024;               // Reads of at least this many bytes skip the cache
+  hid_t backingFileAccessPropertyList = H5P_DEFAULT; // Driver the cache reads from and writes to
+  std::shared_ptr<Statistics> statistics;            // Shared counters. Created per file when empty
+};
+
+namespace detail
+{
+
+inline constexpr haddr_t k_MaxAddress = (static_cast<haddr_t>(1) << 63) - 1;
+
+/**
+ * @brief LRU cache of pages for one open file
+ */
+class PageCache
+{
+public:
+  PageCache(H5FD_t* backing, const Config& config)
+  : m_Backing(backing)
+  , m_Config(config)
+  {
+    m_Config.pageSize = std::max<size_t>(m_Config.pageSize, 512);
+    m_Config.capacity = std::max<size_t>(m_Config.capacity, 1);
+  }
+
+  H5FD_t* backing() const
+  {
+    return m_Backing;
+  }
+
+  const Config& config() const
+  {
+    return m_Config;
+  }
+
+  herr_t read(H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, unsigned char* buffer)
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Statistics& stats = *m_Config.statistics;
+    if(size >= m_Config.bypassSize)
+    {
+      stats.backingReads++;
+      stats.backingBytesRead += size;
+      return H5FDread(m_Backing, type, dxpl, addr, size, buffer);
+    }
+
+    const haddr_t pageSize = m_Config.pageSize;
+    const haddr_t firstPage = addr / pageSize;
+    const haddr_t lastPage = (addr + size - 1) / pageSize;
+    // Pages up to here were loaded by this request and must not count as hits as well
+    haddr_t loadedUntil = HADDR_UNDEF;
+    for(haddr_t page = firstPage; page <= lastPage; page++)
+    {
+      haddr_t pageStart = page * pageSize;
+      haddr_t copyStart = std::max(addr, pageStart);
+      haddr_t copyEnd = std::min(addr + size, pageStart + pageSize);
+      auto iter = m_Index.find(page);
+      if(iter != m_Index.end() && iter->second->valid < copyEnd - pageStart)
+      {
+        // The page was loaded while the file was shorter than this request needs
+        m_Pages.erase(iter->second);
+        m_Index.erase(iter);
+        iter = m_Index.end();
+      }
+      if(iter != m_Index.end())
+      {
+        if(loadedUntil == HADDR_UNDEF || page > loadedUntil)
+        {
+          stats.hits++;
+        }
+        m_Pages.splice(m_Pages.begin(), m_Pages, iter->second);
+      }
+      else if(load(type, dxpl, page, lastPage, loadedUntil) < 0)
+      {
+        return -1;
+      }
+      const std::vector<unsigned char>& data = m_Pages.front().data;
+      std::memcpy(buffer + (copyStart - addr), data.data() + (copyStart - pageStart), copyEnd - copyStart);
+    }
+    m_NextSequentialPage = lastPage + 1;
+    return 0;
+  }
+
+  herr_t write(H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const unsigned char* buffer)
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    herr_t error = H5FDwrite(m_Backing, type, dxpl, addr, size, buffer);
+    if(error < 0 || m_Index.empty() || size == 0)
+    {
+      return error;
+    }
+    const haddr_t pageSize = m_Config.pageSize;
+    const haddr_t lastPage = (addr + size - 1) / pageSize;
+    for(haddr_t page = addr / pageSize; page <= lastPage; page++)
+    {
+      auto iter = m_Index.find(page);
+      if(iter == m_Index.end())
+      {
+        continue;
+      }
+      haddr_t pageStart = page * pageSize;
+      haddr_t copyStart = std::max(addr, pageStart);
+      haddr_t copyEnd = std::min(addr + size, pageStart + pageSize);
+      std::memcpy(iter->second->data.data() + (copyStart - pageStart), buffer + (copyStart - addr), copyEnd - copyStart);
+      iter->second->valid = std::max(iter->second->valid, copyEnd - pageStart);
+    }
+    return error;
+  }
+
+  /**
+   * @brief Drops cached data at or past the given end of file
+   */
+  void discardFrom(haddr_t endOfFile)
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const haddr_t pageSize = m_Config.pageSize;
+    for(auto iter = m_Pages.begin(); iter != m_Pages.end();)
+    {
+      haddr_t pageStart = iter->index * pageSize;
+      if(pageStart >= endOfFile)
+      {
+        m_Index.erase(iter->index);
+        iter = m_Pages.erase(iter);
+        continue;
+      }
+      if(pageStart + pageSize > endOfFile)
+      {
+        std::fill(iter->data.begin() + static_cast<std::ptrdiff_t>(endOfFile - pageStart), iter->data.end(), 0);
+        iter->valid = std::min(iter->valid, endOfFile - pageStart);
+      }
+      ++iter;
+    }
+  }
+
+private:
+  struct Page
+  {
+    haddr_t index;
+    haddr_t valid; // Bytes that were inside the allocated space when the page was filled
+    std::vector<unsigned char> data;
+  };
+
+  H5FD_t* m_Backing = nullptr;
+  Config m_Config;
+  std::list<Page> m_Pages; // Most recently used first
+  std::unordered_map<haddr_t, std::list<Page>::iterator> m_Index;
+  haddr_t m_NextSequentialPage = HADDR_UNDEF;
+  std::mutex m_Mutex;
+
+  /**
+   * @brief Loads the given page, every following missing page up to lastPage and any
+   * read-ahead pages with a single backing read. The requested page ends up at the
+   * front of the LRU list and loadedUntil is set to the last page that was loaded.
+   */
+  herr_t load(H5FD_mem_t type, hid_t dxpl, haddr_t page, haddr_t lastPage, haddr_t& loadedUntil)
+  {
+    Statistics& stats = *m_Config.statistics;
+    const haddr_t pageSize = m_Config.pageSize;
+    haddr_t endPage = page;
+    while(endPage < lastPage && m_Index.count(endPage + 1) == 0)
+    {
+      endPage++;
+    }
+    if(endPage == lastPage && page == m_NextSequentialPage)
+    {
+      endPage += m_Config.readAheadPages;
+    }
+
+    haddr_t eoa = H5FDget_eoa(m_Backing, type);
+    if(eoa == HADDR_UNDEF)
+    {
+      return -1;
+    }
+    haddr_t start = page * pageSize;
+    haddr_t end = std::min((endPage + 1) * pageSize, std::max(eoa, start));
+    // Nothing is allocated at or past the end of the file, so such a page is a single page of zeros
+    endPage = end > start ? (end - start + pageSize - 1) / pageSize + page - 1 : page;
+    loadedUntil = endPage;
+
+    std::vector<unsigned char> data(static_cast<size_t>((endPage - page + 1) * pageSize), 0);
+    if(end > start)
+    {
+      stats.backingReads++;
+      stats.backingBytesRead += end - start;
+      if(H5FDread(m_Backing, type, dxpl, start, static_cast<size_t>(end - start), data.data()) < 0)
+      {
+        return -1;
+      }
+    }
+
+    // Insert in reverse so the requested page ends up most recently used
+    for(haddr_t current = endPage + 1; current-- > page;)
+    {
+      if(m_Index.count(current) != 0)
+      {
+        continue;
+      }
+      if(current > lastPage)
+      {
+        stats.readAheadPages++;
+      }
+      else
+      {
+        stats.misses++;
+      }
+      auto offset = static_cast<std::ptrdiff_t>((current - page) * pageSize);
+      haddr_t pageStart = current * pageSize;
+      haddr_t valid = end > pageStart ? std::min(end - pageStart, pageSize) : 0;
+      m_Pages.push_front(Page{current, valid, std::vector<unsigned char>(data.begin() + offset, data.begin() + offset + static_cast<std::ptrdiff_t>(pageSize))});
+      m_Index[current] = m_Pages.begin();
+    }
+    while(m_Pages.size() > m_Config.capacity)
+    {
+      m_Index.erase(m_Pages.back().index);
+      m_Pages.pop_back();
+      stats.evictions++;
+    }
+    return 0;
+  }
+};
+
+/**
+ * @brief Per-file driver state. The H5FD_t member must stay first so HDF5 can
+ * treat a pointer to this struct as a pointer to its public file struct.
+ */
+struct File
+{
+  H5FD_t pub;
+  PageCache* cache;
+};
+
+inline PageCache& cacheOf(const H5FD_t* file)
+{
+  return *(reinterpret_cast<const File*>(file)->cache);
+}
+
+inline void* faplCopy(const void* fapl)
+{
+  auto* config = new Config(*reinterpret_cast<const Config*>(fapl));
+  if(config->backingFileAccessPropertyList != H5P_DEFAULT)
+  {
+    config->backingFileAccessPropertyList = H5Pcopy(config->backingFileAccessPropertyList);
+  }
+  return config;
+}
+
+inline herr_t faplFree(void* fapl)
+{
+  auto* config = reinterpret_cast<Config*>(fapl);
+  if(config->backingFileAccessPropertyList != H5P_DEFAULT)
+  {
+    H5Pclose(config->backingFileAccessPropertyList);
+  }
+  delete config;
+  return 0;
+}
+
+inline void* faplGet(H5FD_t* file)
+{
+  return faplCopy(&cacheOf(file).config());
+}
+
+inline H5FD_t* open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr)
+{
+  Config config;
+  const void* driverInfo = H5Pget_driver_info(fapl);
+  if(driverInfo != nullptr)
+  {
+    config = *reinterpret_cast<const Config*>(driverInfo);
+  }
+  if(config.statistics == nullptr)
+  {
+    config.statistics = std::make_shared<Statistics>();
+  }
+
+  H5FD_t* backing = H5FDopen(name, flags, config.backingFileAccessPropertyList, maxaddr);
+  if(backing == nullptr)
+  {
+    return nullptr;
+  }
+  // The cache keeps its own copy of the backing property list for faplGet
+  if(config.backingFileAccessPropertyList != H5P_DEFAULT)
+  {
+    config.backingFileAccessPropertyList = H5Pcopy(config.backingFileAccessPropertyList);
+  }
+
+  File* file = new File{};
+  file->cache = new PageCache(backing, config);
+  return &file->pub;
+}
+
+inline herr_t close(H5FD_t* h5File)
+{
+  File* file = reinterpret_cast<File*>(h5File);
+  herr_t error = H5FDclose(file->cache->backing());
+  hid_t backingFileAccessPropertyList = file->cache->config().backingFileAccessPropertyList;
+  if(backingFileAccessPropertyList != H5P_DEFAULT)
+  {
+    H5Pclose(backingFileAccessPropertyList);
+  }
+  delete file->cache;
+  delete file;
+  return error;
+}
+
+inline int compare(const H5FD_t* file1, const H5FD_t* file2)
+{
+  return H5FDcmp(cacheOf(file1).backing(), cacheOf(file2).backing());
+}
+
+inline herr_t query(const H5FD_t* file, unsigned long* flags)
+{
+  if(flags == nullptr)
+  {
+    return 0;
+  }
+  *flags = 0;
+  if(file == nullptr)
+  {
+    *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA;
+    return 0;
+  }
+  if(H5FDquery(cacheOf(file).backing(), flags) < 0)
+  {
+    return -1;
+  }
+  // Cached pages would hide the writer's updates from a SWMR reader
+  *flags &= ~static_cast<unsigned long>(H5FD_FEAT_SUPPORTS_SWMR_IO);
+  return 0;
+}
+
+inline haddr_t getEoa(const H5FD_t* file, H5FD_mem_t type)
+{
+  return H5FDget_eoa(cacheOf(file).backing(), type);
+}
+
+inline herr_t setEoa(H5FD_t* file, H5FD_mem_t type, haddr_t addr)
+{
+  return H5FDset_eoa(cacheOf(file).backing(), type, addr);
+}
+
+inline haddr_t getEof(const H5FD_t* file, H5FD_mem_t type)
+{
+  return H5FDget_eof(cacheOf(file).backing(), type);
+}
+
+inline herr_t getHandle(H5FD_t* file, hid_t fapl, void** fileHandle)
+{
+  return H5FDget_vfd_handle(cacheOf(file).backing(), fapl, fileHandle);
+}
+
+inline herr_t read(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, void* buffer)
+{
+  return cacheOf(file).read(type, dxpl, addr, size, reinterpret_cast<unsigned char*>(buffer));
+}
+
+inline herr_t write(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const void* buffer)
+{
+  return cacheOf(file).write(type, dxpl, addr, size, reinterpret_cast<const unsigned char*>(buffer));
+}
+
+inline herr_t flush(H5FD_t* file, hid_t dxpl, hbool_t closing)
+{
+  return H5FDflush(cacheOf(file).backing(), dxpl, closing);
+}
+
+inline herr_t truncate(H5FD_t* file, hid_t dxpl, hbool_t closing)
+{
+  PageCache& cache = cacheOf(file);
+  herr_t error = H5FDtruncate(cache.backing(), dxpl, closing);
+  if(error >= 0)
+  {
+    cache.discardFrom(H5FDget_eof(cache.backing(), H5FD_MEM_DEFAULT));
+  }
+  return error;
+}
+
+inline herr_t lock(H5FD_t* file, hbool_t readWrite)
+{
+  return H5FDlock(cacheOf(file).backing(), readWrite);
+}
+
+inline herr_t unlock(H5FD_t* file)
+{
+  return H5FDunlock(cacheOf(file).backing());
+}
+
+/**
+ * @brief Returns the class description registered with HDF5
+ */
+inline const H5FD_class_t& driverClass()
+{
+  static const H5FD_class_t s_Class = []() {
+    H5FD_class_t driver{};
+#if H5_VERSION_GE(1, 13, 2)
+    driver.version = H5FD_CLASS_VERSION;
+    driver.value = static_cast<H5FD_class_value_t>(H5SUPPORT_PAGE_CACHE_DRIVER_VALUE);
+#endif
+    driver.name = "h5support_page_cache";
+    driver.maxaddr = k_MaxAddress;
+    driver.fc_degree = H5F_CLOSE_WEAK;
+    driver.fapl_size = sizeof(Config);
+    driver.fapl_get = faplGet;
+    driver.fapl_copy = faplCopy;
+    driver.fapl_free = faplFree;
+    driver.open = open;
+    driver.close = close;
+    driver.cmp = compare;
+    driver.query = query;
+    driver.get_eoa = getEoa;
+    driver.set_eoa = setEoa;
+    driver.get_eof = getEof;
+    driver.get_handle = getHandle;
+    driver.read = read;
+    driver.write = write;
+    driver.flush = flush;
+    driver.truncate = truncate;
+    driver.lock = lock;
+    driver.unlock = unlock;
+    const H5FD_mem_t freeListMap[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+    std::copy(freeListMap, freeListMap + H5FD_MEM_NTYPES, driver.fl_map);
+    return driver;
+  }();
+  return s_Class;
+}
+} // namespace detail
+
+/**
+ * @brief Registers the driver with HDF5 (once per library initialization) and returns its id
+ * @return The driver id. Negative value is error.
+ */
+inline hid_t driverID()
+{
+  static std::mutex s_Mutex;
+  static hid_t s_DriverID = -1;
+  std::lock_guard<std::mutex> lock(s_Mutex);
+  if(H5Iget_type(s_DriverID) != H5I_VFL)
+  {
+    s_DriverID = H5FDregister(&detail::driverClass());
+  }
+  return s_DriverID;
+}
+
+/**
+ * @brief Selects the page cache driver on a file access property list. The backing
+ * property list in the config is copied so the caller keeps ownership of it.
+ * @param fileAccessPropertyList The file access property list to modify
+ * @param config The driver settings
+ * @return Standard HDF5 error condition
+ */
+inline herr_t setFileAccessProperties(hid_t fileAccessPropertyList, const Config& config = Config())
+{
+  hid_t driver = driverID();
+  if(driver < 0)
+  {
+    return static_cast<herr_t>(driver);
+  }
+  return H5Pset_driver(fileAccessPropertyList, driver, &config);
+}
+
+/**
+ * @brief Returns the cache counters of a file opened with this driver. Files that
+ * were given the same statistics object in their config share their counters.
+ * @param fileID The HDF5 file id
+ * @return The counters or nullptr if the file does not use the page cache driver
+ */
+inline std::shared_ptr<const Statistics> getStatistics(hid_t fileID)
+{
+  hid_t fileAccessPropertyList = H5Fget_access_plist(fileID);
+  if(fileAccessPropertyList < 0)
+  {
+    return nullptr;
+  }
+  std::shared_ptr<const Statistics> statistics;
+  if(H5Pget_driver(fileAccessPropertyList) == driverID())
+  {
+    const auto* config = reinterpret_cast<const Config*>(H5Pget_driver_info(fileAccessPropertyList));
+    if(config != nullptr)
+    {
+      statistics = config->statistics;
+    }
+  }
+  H5Pclose(fileAccessPropertyList);
+  return statistics;
+}
+
+} // namespace H5PageCacheDriver
+
+}; // namespace H5Support
@@ -0,0 +1,284 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5ReadFarm.h"
+#include "H5Support/H5Support.h"
+#include "H5Support/H5ThreadPool.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5ParallelDatasetLoader class loads many datasets of one file concurrently.
+ * The datasets are handed out largest first from a shared queue, so idle workers always
+ * pick up the biggest remaining dataset and the workers finish at about the same time.
+ *
+ * How the work is spread depends on the HDF5 library:
+ * - Thread-safe builds read on a set of worker threads that each open their own handle
+ *   to the file. HDF5 still serializes the reads, but the post processing of one dataset
+ *   overlaps with the reads of the others.
+ * - Other builds read with worker processes through H5ReadFarm, each with its own copy
+ *   of the library, and run the post processing on worker threads once the reads are done.
+ *   The restrictions of H5ReadFarm on forking apply.
+ * - Where neither is possible, on Windows or with a single worker, every dataset is read on
+ *   the calling thread and only the post processing runs on worker threads.
+ */
+class H5ParallelDatasetLoader
+{
+public:
+  /**
+   * @brief How the datasets are loaded
+   */
+  enum class Strategy : int32_t
+  {
+    Sequential = 0, // Reads on the calling thread, post processing on worker threads
+    Threads = 1,    // Reads and post processing on worker threads
+    Processes = 2   // Reads in worker processes, post processing on worker threads
+  };
+
+  using PostProcess = std::function<herr_t(H5Lite::DatasetBuffer&)>;
+
+  /**
+   * @brief Prepares loading datasets from a file
+   * @param filePath The file to read
+   * @param numThreads Number of worker threads or processes. Zero uses the number of hardware threads.
+   */
+  explicit H5ParallelDatasetLoader(const std::string& filePath, size_t numThreads = 0)
+  : m_FilePath(filePath)
+  , m_NumThreads(numThreads == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : numThreads)
+  {
+    hbool_t threadSafe = 0;
+    H5is_library_threadsafe(&threadSafe);
+    if(m_NumThreads <= 1)
+    {
+      m_Strategy = Strategy::Sequential;
+    }
+    else if(threadSafe != 0)
+    {
+      m_Strategy = Strategy::Threads;
+    }
+    else
+    {
+      m_Strategy = H5ReadFarm::isAvailable() ? Strategy::Processes : Strategy::Sequential;
+    }
+  }
+
+  /**
+   * @brief Returns the strategy that is used with the linked HDF5 library
+   * @return
+   */
+  Strategy strategy() const
+  {
+    return m_Strategy;
+  }
+
+  /**
+   * @brief Loads a list of datasets. Each entry names a dataset and either provides the
+   * storage for it or a resize function, as H5Lite::makeDatasetBuffer does. The dims of
+   * each entry are set to the shape of the dataset.
+   * @param datasets
+   * @param postProcess Optional. Called for every dataset after it was read, on a worker thread. Must not call HDF5.
+   * @return Standard HDF5 error condition. Loading stops at the first error.
+   */
+  herr_t load(std::vector<H5Lite::DatasetBuffer>& datasets, const PostProcess& postProcess = PostProcess())
+  {
+    hid_t fileID = H5Fopen(m_FilePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(fileID < 0)
+    {
+      std::cout << "H5ParallelDatasetLoader: Error opening file '" << m_FilePath << "'" << std::endl;
+      return -1;
+    }
+
+    // Largest datasets first so the last ones to be picked up are short
+    std::vector<hsize_t> sizes(datasets.size(), 0);
+    for(size_t i = 0; i < datasets.size(); i++)
+    {
+      hid_t datasetID = H5Dopen(fileID, datasets[i].name.c_str(), H5P_DEFAULT);
+      if(datasetID >= 0)
+      {
+        sizes[i] = H5Dget_storage_size(datasetID);
+        H5Dclose(datasetID);
+      }
+    }
+    std::vector<size_t> order(datasets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto process = [&](size_t index) {
+      if(postProcess && postProcess(datasets[index]) < 0)
+      {
+        std::cout << "H5ParallelDatasetLoader: Error processing dataset '" << datasets[index].name << "'" << std::endl;
+        failed = true;
+      }
+    };
+
+    if(m_Strategy == Strategy::Threads)
+    {
+      H5Fclose(fileID);
+      auto worker = [&]() {
+        hid_t threadFileID = H5Fopen(m_FilePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if(threadFileID < 0)
+        {
+          failed = true;
+          return;
+        }
+        for(size_t position = next++; position < order.size() && !failed; position = next++)
+        {
+          if(readDataset(threadFileID, datasets[order[position]]) < 0)
+          {
+            failed = true;
+            break;
+          }
+          process(order[position]);
+        }
+        H5Fclose(threadFileID);
+      };
+      std::vector<std::thread> threads;
+      for(size_t i = 0; i < std::min(m_NumThreads, datasets.size()); i++)
+      {
+        threads.emplace_back(worker);
+      }
+      for(auto& thread : threads)
+      {
+        thread.join();
+      }
+    }
+    else if(m_Strategy == Strategy::Processes)
+    {
+      H5Fclose(fileID);
+      H5ReadFarm farm(m_FilePath, m_NumThreads);
+      if(farm.readDatasets(datasets) < 0)
+      {
+        std::cout << "H5ParallelDatasetLoader: Error reading datasets from '" << m_FilePath << "'" << std::endl;
+        return -1;
+      }
+      if(postProcess)
+      {
+        H5ThreadPool threadPool(m_NumThreads);
+        std::vector<std::future<void>> results;
+        for(size_t index : order)
+        {
+          results.push_back(threadPool.submit([&process, index]() { process(index); }));
+        }
+        for(auto& result : results)
+        {
+          result.wait();
+        }
+      }
+    }
+    else
+    {
+      H5ThreadPool threadPool(m_NumThreads);
+      std::vector<std::future<void>> results;
+      for(size_t position = 0; position < order.size() && !failed; position++)
+      {
+        if(readDataset(fileID, datasets[order[position]]) < 0)
+        {
+          failed = true;
+          break;
+        }
+        if(postProcess)
+        {
+          results.push_back(threadPool.submit([&process, index = order[position]]() { process(index); }));
+        }
+      }
+      for(auto& result : results)
+      {
+        result.wait();
+      }
+      H5Fclose(fileID);
+    }
+    return failed ? -1 : 0;
+  }
+
+private:
+  std::string m_FilePath;
+  size_t m_NumThreads = 1;
+  Strategy m_Strategy = Strategy::Sequential;
+
+  /**
+   * @brief Reads one dataset into its buffer
+   */
+  static herr_t readDataset(hid_t fileID, H5Lite::DatasetBuffer& dataset)
+  {
+    hid_t datasetID = H5Dopen(fileID, dataset.name.c_str(), H5P_DEFAULT);
+    if(datasetID < 0)
+    {
+      std::cout << "H5ParallelDatasetLoader: Error opening dataset '" << dataset.name << "'" << std::endl;
+      return -1;
+    }
+    hid_t dataspaceID = H5Dget_space(datasetID);
+    dataset.dims.resize(std::max(H5Sget_simple_extent_ndims(dataspaceID), 0));
+    H5Sget_simple_extent_dims(dataspaceID, dataset.dims.data(), nullptr);
+    size_t numElements = static_cast<size_t>(std::max<hssize_t>(H5Sget_simple_extent_npoints(dataspaceID), 0));
+    H5Sclose(dataspaceID);
+    if(dataset.resize)
+    {
+      dataset.data = dataset.resize(numElements);
+      dataset.numElements = numElements;
+    }
+    herr_t error = -1;
+    if(dataset.dataType >= 0 && dataset.numElements >= numElements && (numElements == 0 || dataset.data != nullptr))
+    {
+      error = H5Dread(datasetID, dataset.dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dataset.data);
+    }
+    H5Dclose(datasetID);
+    if(error < 0)
+    {
+      std::cout << "H5ParallelDatasetLoader: Error reading dataset '" << dataset.name << "'" << std::endl;
+    }
+    return error;
+  }
+};
+
+}; // namespace H5Support
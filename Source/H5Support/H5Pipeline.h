@@ -0,0 +1,236 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5PrefetchReader.h"
+#include "H5Support/H5Support.h"
+#include "H5Support/H5ThreadPool.h"
+
+namespace H5Support
+{
+/**
+ * @brief Streams a dataset through a transformation into a new chunked dataset without
+ * holding the whole dataset in memory
+ */
+namespace H5Pipeline
+{
+/**
+ * @brief Settings for transformDataset
+ */
+struct Config
+{
+  size_t numThreads = std::thread::hardware_concurrency(); // Number of threads that run the transform
+  size_t queueDepth = 4;                                   // Maximum number of blocks that are read but not written yet
+  int32_t compressionLevel = 1;                            // Deflate level of the new dataset. Zero stores it uncompressed.
+  std::vector<hsize_t> chunkDims;                          // Chunk dimensions of the new dataset. Empty uses the chunks of the source, or a guess if it is not chunked.
+};
+
+namespace detail
+{
+/**
+ * @brief Reads or writes one block of a dataset
+ * @param datasetID
+ * @param dataType Memory type of the buffer
+ * @param start
+ * @param count
+ * @param buffer
+ * @param write
+ * @return Standard HDF5 error condition
+ */
+inline herr_t transferBlock(hid_t datasetID, hid_t dataType, const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, void* buffer, bool write)
+{
+  hid_t fileSpaceID = H5Dget_space(datasetID);
+  hid_t memorySpaceID = H5Screate_simple(static_cast<int32_t>(count.size()), count.data(), nullptr);
+  herr_t error = H5Sselect_hyperslab(fileSpaceID, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+  if(error >= 0)
+  {
+    error = write ? H5Dwrite(datasetID, dataType, memorySpaceID, fileSpaceID, H5P_DEFAULT, buffer) : H5Dread(datasetID, dataType, memorySpaceID, fileSpaceID, H5P_DEFAULT, buffer);
+  }
+  H5Sclose(memorySpaceID);
+  H5Sclose(fileSpaceID);
+  return error;
+}
+} // namespace detail
+
+/**
+ * @brief Reads a dataset one chunk of the new dataset at a time, runs every block
+ * through a transform on a thread pool and writes the results into a new chunked and
+ * compressed dataset of the same shape. Blocks are written in order as soon as their
+ * transform is done, so at most queueDepth blocks are held in memory and the time taken
+ * approaches that of the slowest stage.
+ *
+ * HDF5 serializes its API calls, so reading and writing share the calling thread and only
+ * the transforms run concurrently. This also makes the pipeline safe to use with HDF5
+ * libraries that are not thread-safe. The transform must not call HDF5.
+ * @param sourceLocationID The parent location of the source dataset
+ * @param sourceName The name of the source dataset
+ * @param destinationLocationID The parent location of the new dataset
+ * @param destinationName The name of the new dataset
+ * @param transform Called with the region of a block, its values in row major order and an output vector.
+ * The output vector has to be filled with as many values as the input. Returning a negative value stops the pipeline.
+ * @param config
+ * @return Standard HDF5 error condition. A partially written dataset is left behind on error.
+ */
+template <typename In, typename Out>
+inline herr_t transformDataset(hid_t sourceLocationID, const std::string& sourceName, hid_t destinationLocationID, const std::string& destinationName,
+                               const std::function<herr_t(const typename H5PrefetchReader<In>::Block&, const std::vector<In>&, std::vector<Out>&)>& transform, const Config& config = Config())
+{
+  using Block = typename H5PrefetchReader<In>::Block;
+
+  hid_t sourceDatasetID = H5Dopen(sourceLocationID, sourceName.c_str(), H5P_DEFAULT);
+  if(sourceDatasetID < 0)
+  {
+    std::cout << "Error opening dataset '" << sourceName << "'" << std::endl;
+    return -1;
+  }
+  hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+  std::vector<hsize_t> dims(std::max(rank, 0));
+  H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+
+  std::vector<hsize_t> chunkDims = config.chunkDims;
+  if(chunkDims.empty() && rank > 0)
+  {
+    chunkDims.resize(rank);
+    hid_t sourceDcpl = H5Dget_create_plist(sourceDatasetID);
+    if(H5Pget_layout(sourceDcpl) != H5D_CHUNKED || H5Pget_chunk(sourceDcpl, rank, chunkDims.data()) != rank)
+    {
+      chunkDims = H5Lite::guessChunkSize(dims, sizeof(Out));
+    }
+    H5Pclose(sourceDcpl);
+  }
+  std::vector<Block> blocks = H5PrefetchReader<In>::chunkBlocks(dims, chunkDims);
+  if(blocks.empty())
+  {
+    std::cout << "Error: dataset '" << sourceName << "' can not be split into chunks" << std::endl;
+    H5Sclose(dataspaceID);
+    H5Dclose(sourceDatasetID);
+    return -1;
+  }
+
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  herr_t error = H5Pset_chunk(dcpl, rank, chunkDims.data());
+  if(error >= 0 && config.compressionLevel > 0)
+  {
+    error = H5Pset_deflate(dcpl, static_cast<uint32_t>(std::min(config.compressionLevel, 9)));
+  }
+  hid_t destinationDatasetID = -1;
+  if(error >= 0)
+  {
+    destinationDatasetID = H5Dcreate(destinationLocationID, destinationName.c_str(), H5Lite::HDFTypeForPrimitive<Out>(), dataspaceID, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  }
+  H5Pclose(dcpl);
+  H5Sclose(dataspaceID);
+  if(destinationDatasetID < 0)
+  {
+    std::cout << "Error creating dataset '" << destinationName << "'" << std::endl;
+    H5Dclose(sourceDatasetID);
+    return -1;
+  }
+
+  using Result = std::pair<herr_t, std::vector<Out>>;
+  const size_t queueDepth = std::max<size_t>(config.queueDepth, 1);
+  std::deque<std::pair<size_t, std::future<Result>>> pending;
+  {
+    H5ThreadPool threadPool(std::max<size_t>(config.numThreads, 1));
+    auto writeNext = [&]() {
+      Result result = pending.front().second.get();
+      const Block& block = blocks[pending.front().first];
+      pending.pop_front();
+      size_t numElements = std::accumulate(block.count.begin(), block.count.end(), static_cast<size_t>(1), std::multiplies<size_t>());
+      if(result.first < 0 || result.second.size() != numElements)
+      {
+        std::cout << "Error transforming a block of dataset '" << sourceName << "'" << std::endl;
+        return herr_t(-1);
+      }
+      return detail::transferBlock(destinationDatasetID, H5Lite::HDFTypeForPrimitive<Out>(), block.start, block.count, result.second.data(), true);
+    };
+
+    for(size_t index = 0; index < blocks.size() && error >= 0; index++)
+    {
+      const Block& block = blocks[index];
+      std::vector<In> input(std::accumulate(block.count.begin(), block.count.end(), static_cast<size_t>(1), std::multiplies<size_t>()));
+      error = detail::transferBlock(sourceDatasetID, H5Lite::HDFTypeForPrimitive<In>(), block.start, block.count, input.data(), false);
+      if(error < 0)
+      {
+        std::cout << "Error reading a block of dataset '" << sourceName << "'" << std::endl;
+        break;
+      }
+      pending.emplace_back(index, threadPool.submit([&transform, &block, input = std::move(input)]() {
+        Result result;
+        result.first = transform(block, input, result.second);
+        return result;
+      }));
+      while(pending.size() >= queueDepth && error >= 0)
+      {
+        error = writeNext();
+      }
+    }
+    // Blocks that are still being transformed after an error are waited for but not written
+    while(!pending.empty())
+    {
+      if(error < 0)
+      {
+        pending.front().second.wait();
+        pending.pop_front();
+        continue;
+      }
+      error = writeNext();
+    }
+  }
+
+  H5Dclose(destinationDatasetID);
+  H5Dclose(sourceDatasetID);
+  return error;
+}
+} // namespace H5Pipeline
+
+}; // namespace H5Support
@@ -0,0 +1,370 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5MemoryBudget.h"
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5PrefetchReader class reads the blocks of a dataset in a fixed order on a
+ * background thread. While the caller processes one block the next ones are read and
+ * decompressed into a ring of reusable buffers, so a sequential pass over a dataset
+ * overlaps computation with I/O.
+ *
+ * The ring of buffers is reserved against H5MemoryBudget::global() for the lifetime of the
+ * reader. Unless the HDF5 library is thread-safe the caller must not make HDF5 calls of its
+ * own while the reader is alive.
+ */
+template <typename T>
+class H5PrefetchReader
+{
+public:
+  /**
+   * @brief A rectangular region of the dataset
+   */
+  struct Block
+  {
+    std::vector<hsize_t> start;
+    std::vector<hsize_t> count;
+  };
+
+  /**
+   * @brief Splits a dataset into blocks of whole rows along the slowest dimension
+   * @param dims The dimensions of the dataset
+   * @param rowsPerBlock
+   * @return
+   */
+  static std::vector<Block> rowBlocks(const std::vector<hsize_t>& dims, hsize_t rowsPerBlock)
+  {
+    std::vector<Block> blocks;
+    if(dims.empty() || rowsPerBlock == 0)
+    {
+      return blocks;
+    }
+    for(hsize_t row = 0; row < dims[0]; row += rowsPerBlock)
+    {
+      Block block{std::vector<hsize_t>(dims.size(), 0), dims};
+      block.start[0] = row;
+      block.count[0] = std::min(rowsPerBlock, dims[0] - row);
+      blocks.push_back(block);
+    }
+    return blocks;
+  }
+
+  /**
+   * @brief Splits a dataset into its chunks in row major order of the chunk grid. Chunks
+   * at the edge of the dataset are clipped to the dataset.
+   * @param dims The dimensions of the dataset
+   * @param chunkDims The chunk dimensions of the dataset
+   * @return
+   */
+  static std::vector<Block> chunkBlocks(const std::vector<hsize_t>& dims, const std::vector<hsize_t>& chunkDims)
+  {
+    std::vector<Block> blocks;
+    if(dims.empty() || chunkDims.size() != dims.size() || std::find(chunkDims.begin(), chunkDims.end(), 0) != chunkDims.end() || std::find(dims.begin(), dims.end(), 0) != dims.end())
+    {
+      return blocks;
+    }
+    const size_t rank = dims.size();
+    std::vector<hsize_t> start(rank, 0);
+    while(true)
+    {
+      Block block{start, std::vector<hsize_t>(rank)};
+      for(size_t i = 0; i < rank; i++)
+      {
+        block.count[i] = std::min(chunkDims[i], dims[i] - start[i]);
+      }
+      blocks.push_back(block);
+      size_t i = rank;
+      while(i-- > 0)
+      {
+        start[i] += chunkDims[i];
+        if(start[i] < dims[i])
+        {
+          break;
+        }
+        start[i] = 0;
+      }
+      if(i == static_cast<size_t>(-1))
+      {
+        return blocks;
+      }
+    }
+  }
+
+  /**
+   * @brief Reads a dataset chunk by chunk. Datasets that are not chunked are read in blocks of rows of about 1 MB.
+   * @param locationID The parent location of the dataset
+   * @param datasetName The name of the dataset
+   * @param depth Number of blocks that are read ahead of the one the caller holds
+   */
+  H5PrefetchReader(hid_t locationID, const std::string& datasetName, size_t depth = 2)
+  {
+    if(!open(locationID, datasetName))
+    {
+      return;
+    }
+    std::vector<hsize_t> chunkDims(m_Dims.size());
+    hid_t dcpl = H5Dget_create_plist(m_DatasetID);
+    bool chunked = H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_chunk(dcpl, static_cast<int32_t>(chunkDims.size()), chunkDims.data()) >= 0;
+    H5Pclose(dcpl);
+    if(chunked)
+    {
+      m_Blocks = chunkBlocks(m_Dims, chunkDims);
+    }
+    else if(!m_Dims.empty())
+    {
+      size_t rowSize = std::accumulate(m_Dims.begin() + 1, m_Dims.end(), sizeof(T), std::multiplies<size_t>());
+      m_Blocks = rowBlocks(m_Dims, std::max<hsize_t>(1, H5Lite::detail::k_ChunkMax / std::max<size_t>(rowSize, 1)));
+    }
+    start(depth);
+  }
+
+  /**
+   * @brief Reads the given blocks of a dataset in order
+   * @param locationID The parent location of the dataset
+   * @param datasetName The name of the dataset
+   * @param blocks The regions to read, in the order they are handed out
+   * @param depth Number of blocks that are read ahead of the one the caller holds
+   */
+  H5PrefetchReader(hid_t locationID, const std::string& datasetName, std::vector<Block> blocks, size_t depth = 2)
+  : m_Blocks(std::move(blocks))
+  {
+    if(open(locationID, datasetName))
+    {
+      start(depth);
+    }
+  }
+
+  /**
+   * @brief Stops reading ahead and closes the dataset
+   */
+  ~H5PrefetchReader()
+  {
+    if(m_Thread.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+      }
+      m_Condition.notify_all();
+      m_Thread.join();
+    }
+    if(m_DatasetID >= 0)
+    {
+      H5Dclose(m_DatasetID);
+    }
+  }
+
+  H5PrefetchReader(const H5PrefetchReader&) = delete;            // Copy Constructor Not Implemented
+  H5PrefetchReader(H5PrefetchReader&&) = delete;                 // Move Constructor Not Implemented
+  H5PrefetchReader& operator=(const H5PrefetchReader&) = delete; // Copy Assignment Not Implemented
+  H5PrefetchReader& operator=(H5PrefetchReader&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Returns true if the dataset was opened
+   * @return
+   */
+  bool isValid() const
+  {
+    return m_DatasetID >= 0;
+  }
+
+  /**
+   * @brief Returns the number of blocks the reader hands out
+   * @return
+   */
+  size_t numBlocks() const
+  {
+    return m_Blocks.size();
+  }
+
+  /**
+   * @brief Returns the region of a block
+   * @param index
+   * @return
+   */
+  const Block& block(size_t index) const
+  {
+    return m_Blocks[index];
+  }
+
+  /**
+   * @brief Hands the previous block back to the reader and waits for the next one
+   * @param data Set to the values of the block in row major order. They stay valid until the next call.
+   * @return The index of the block, or -1 after the last block or if a read failed
+   */
+  int64_t next(const std::vector<T>*& data)
+  {
+    data = nullptr;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if(m_Holding)
+    {
+      m_Released++;
+      m_Holding = false;
+      m_Condition.notify_all();
+    }
+    m_Condition.wait(lock, [this]() { return m_Read > m_Released || m_Error < 0 || m_Released >= m_Blocks.size(); });
+    if(m_Read <= m_Released)
+    {
+      return -1;
+    }
+    m_Holding = true;
+    data = &m_Buffers[m_Released % m_Buffers.size()];
+    return static_cast<int64_t>(m_Released);
+  }
+
+  /**
+   * @brief Returns the error condition of the reads
+   * @return
+   */
+  herr_t error() const
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Error;
+  }
+
+private:
+  hid_t m_DatasetID = -1;
+  std::vector<hsize_t> m_Dims;
+  std::vector<Block> m_Blocks;
+  std::vector<std::vector<T>> m_Buffers;
+  H5MemoryBudget::Reservation m_Reservation;
+  std::thread m_Thread;
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  size_t m_Read = 0;     // Number of blocks that have been read
+  size_t m_Released = 0; // Number of blocks the caller is done with
+  bool m_Holding = false;
+  bool m_Stopping = false;
+  herr_t m_Error = 0;
+
+  bool open(hid_t locationID, const std::string& datasetName)
+  {
+    m_DatasetID = H5Dopen(locationID, datasetName.c_str(), H5P_DEFAULT);
+    if(m_DatasetID < 0)
+    {
+      std::cout << "H5PrefetchReader: Error opening dataset '" << datasetName << "'" << std::endl;
+      m_Error = -1;
+      return false;
+    }
+    hid_t dataspaceID = H5Dget_space(m_DatasetID);
+    m_Dims.resize(std::max(H5Sget_simple_extent_ndims(dataspaceID), 0));
+    H5Sget_simple_extent_dims(dataspaceID, m_Dims.data(), nullptr);
+    H5Sclose(dataspaceID);
+    return true;
+  }
+
+  void start(size_t depth)
+  {
+    m_Buffers.resize(std::max<size_t>(depth, 1) + 1);
+    size_t blockSize = 0;
+    for(const auto& region : m_Blocks)
+    {
+      blockSize = std::max(blockSize, std::accumulate(region.count.begin(), region.count.end(), sizeof(T), std::multiplies<size_t>()));
+    }
+    m_Reservation = H5MemoryBudget::Reservation(std::min(m_Buffers.size(), m_Blocks.size()) * blockSize);
+    if(!m_Reservation.isValid())
+    {
+      std::cout << "H5PrefetchReader: Error reserving memory for the read ahead buffers" << std::endl;
+      m_Error = -1;
+      return;
+    }
+    m_Thread = std::thread([this]() { run(); });
+  }
+
+  void run()
+  {
+    hid_t fileSpaceID = H5Dget_space(m_DatasetID);
+    for(size_t index = 0; index < m_Blocks.size(); index++)
+    {
+      std::vector<T>* buffer = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [this, index]() { return m_Stopping || index < m_Released + m_Buffers.size(); });
+        if(m_Stopping)
+        {
+          break;
+        }
+        buffer = &m_Buffers[index % m_Buffers.size()];
+      }
+
+      const Block& region = m_Blocks[index];
+      buffer->resize(std::accumulate(region.count.begin(), region.count.end(), static_cast<size_t>(1), std::multiplies<size_t>()));
+      hid_t memorySpaceID = H5Screate_simple(static_cast<int32_t>(region.count.size()), region.count.data(), nullptr);
+      herr_t error = H5Sselect_hyperslab(fileSpaceID, H5S_SELECT_SET, region.start.data(), nullptr, region.count.data(), nullptr);
+      error = error < 0 ? error : H5Dread(m_DatasetID, H5Lite::HDFTypeForPrimitive<T>(), memorySpaceID, fileSpaceID, H5P_DEFAULT, buffer->data());
+      H5Sclose(memorySpaceID);
+
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if(error < 0)
+        {
+          std::cout << "H5PrefetchReader: Error reading block " << index << std::endl;
+          m_Error = error;
+        }
+        else
+        {
+          m_Read++;
+        }
+      }
+      m_Condition.notify_all();
+      if(error < 0)
+      {
+        break;
+      }
+    }
+    H5Sclose(fileSpaceID);
+  }
+};
+
+}; // namespace H5Support
@@ -0,0 +1,343 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5ReadBatch class collects rectangular region reads of one dataset and
+ * performs them together. Regions that touch the same chunks are merged into one group
+ * and every group is read with a single H5Dread of the union of its regions, so each
+ * chunk is decoded once no matter how many regions overlap it. The values are then
+ * copied into the buffer of each region.
+ *
+ * Every group is read into a temporary buffer the size of its bounding box, so regions
+ * that are far apart but share chunks with regions in between cost that much memory.
+ */
+template <typename T>
+class H5ReadBatch
+{
+public:
+  /**
+   * @brief Opens the dataset the regions are read from
+   * @param locationID The parent location of the dataset
+   * @param datasetName The name of the dataset
+   */
+  H5ReadBatch(hid_t locationID, const std::string& datasetName)
+  : m_DatasetName(datasetName)
+  {
+    m_DatasetID = H5Dopen(locationID, datasetName.c_str(), H5P_DEFAULT);
+    if(m_DatasetID < 0)
+    {
+      std::cout << "H5ReadBatch: Error opening dataset '" << datasetName << "'" << std::endl;
+      return;
+    }
+    hid_t dataspaceID = H5Dget_space(m_DatasetID);
+    int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+    m_Dims.resize(std::max(rank, 0));
+    H5Sget_simple_extent_dims(dataspaceID, m_Dims.data(), nullptr);
+    H5Sclose(dataspaceID);
+
+    m_ChunkDims.assign(m_Dims.size(), 1);
+    hid_t dcpl = H5Dget_create_plist(m_DatasetID);
+    if(rank > 0 && H5Pget_layout(dcpl) == H5D_CHUNKED)
+    {
+      H5Pget_chunk(dcpl, rank, m_ChunkDims.data());
+    }
+    H5Pclose(dcpl);
+  }
+
+  ~H5ReadBatch()
+  {
+    if(m_DatasetID >= 0)
+    {
+      H5Dclose(m_DatasetID);
+    }
+  }
+
+  H5ReadBatch(const H5ReadBatch&) = delete;            // Copy Constructor Not Implemented
+  H5ReadBatch(H5ReadBatch&&) = delete;                 // Move Constructor Not Implemented
+  H5ReadBatch& operator=(const H5ReadBatch&) = delete; // Copy Assignment Not Implemented
+  H5ReadBatch& operator=(H5ReadBatch&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Returns true if the dataset was opened
+   * @return
+   */
+  bool isValid() const
+  {
+    return m_DatasetID >= 0;
+  }
+
+  /**
+   * @brief Adds a region to the batch. Nothing is read until execute() is called.
+   * @param start First element of the region in every dimension
+   * @param count Size of the region in every dimension
+   * @param buffer Receives the elements of the region in row major order. Must hold the product of count elements and stay valid until execute() returns.
+   * @return Standard HDF5 error condition. Negative if the region does not fit the dataset.
+   */
+  herr_t add(const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, T* buffer)
+  {
+    if(!isValid() || buffer == nullptr || m_Dims.empty() || start.size() != m_Dims.size() || count.size() != m_Dims.size())
+    {
+      std::cout << "H5ReadBatch: The region does not match the rank of dataset '" << m_DatasetName << "'" << std::endl;
+      return -1;
+    }
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      if(count[i] == 0 || start[i] + count[i] > m_Dims[i])
+      {
+        std::cout << "H5ReadBatch: The region is outside of dataset '" << m_DatasetName << "'" << std::endl;
+        return -1;
+      }
+    }
+    m_Requests.push_back({start, count, buffer});
+    return 0;
+  }
+
+  /**
+   * @brief Reads all regions that were added since the last clear()
+   * @return Standard HDF5 error condition
+   */
+  herr_t execute()
+  {
+    m_NumReads = 0;
+    if(!isValid())
+    {
+      return -1;
+    }
+
+    // Regions that touch a common chunk end up in the same group
+    std::vector<size_t> groups(m_Requests.size());
+    std::iota(groups.begin(), groups.end(), 0);
+    auto findGroup = [&groups](size_t index) {
+      while(groups[index] != index)
+      {
+        groups[index] = groups[groups[index]];
+        index = groups[index];
+      }
+      return index;
+    };
+    for(size_t a = 0; a < m_Requests.size(); a++)
+    {
+      for(size_t b = a + 1; b < m_Requests.size(); b++)
+      {
+        if(shareChunks(m_Requests[a], m_Requests[b]))
+        {
+          groups[findGroup(b)] = findGroup(a);
+        }
+      }
+    }
+
+    herr_t error = 0;
+    std::vector<size_t> members;
+    for(size_t group = 0; group < m_Requests.size() && error >= 0; group++)
+    {
+      members.clear();
+      for(size_t i = 0; i < m_Requests.size(); i++)
+      {
+        if(findGroup(i) == group)
+        {
+          members.push_back(i);
+        }
+      }
+      if(!members.empty())
+      {
+        error = readGroup(members);
+      }
+    }
+    if(error < 0)
+    {
+      std::cout << "H5ReadBatch: Error reading dataset '" << m_DatasetName << "'" << std::endl;
+    }
+    return error;
+  }
+
+  /**
+   * @brief Removes all regions from the batch
+   */
+  void clear()
+  {
+    m_Requests.clear();
+  }
+
+  /**
+   * @brief Returns the number of regions in the batch
+   * @return
+   */
+  size_t size() const
+  {
+    return m_Requests.size();
+  }
+
+  /**
+   * @brief Returns the number of H5Dread calls the last execute() needed
+   * @return
+   */
+  size_t numReads() const
+  {
+    return m_NumReads;
+  }
+
+private:
+  struct Request
+  {
+    std::vector<hsize_t> start;
+    std::vector<hsize_t> count;
+    T* buffer;
+  };
+
+  hid_t m_DatasetID = -1;
+  std::string m_DatasetName;
+  std::vector<hsize_t> m_Dims;
+  std::vector<hsize_t> m_ChunkDims;
+  std::vector<Request> m_Requests;
+  size_t m_NumReads = 0;
+
+  /**
+   * @brief Checks if the chunk aligned extents of two regions overlap. For datasets that
+   * are not chunked this checks if the regions themselves overlap.
+   */
+  bool shareChunks(const Request& a, const Request& b) const
+  {
+    for(size_t i = 0; i < m_Dims.size(); i++)
+    {
+      hsize_t firstA = a.start[i] / m_ChunkDims[i];
+      hsize_t lastA = (a.start[i] + a.count[i] - 1) / m_ChunkDims[i];
+      hsize_t firstB = b.start[i] / m_ChunkDims[i];
+      hsize_t lastB = (b.start[i] + b.count[i] - 1) / m_ChunkDims[i];
+      if(lastA < firstB || lastB < firstA)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Reads the union of a group of regions into a buffer covering their bounding
+   * box and copies every region out of it
+   */
+  herr_t readGroup(const std::vector<size_t>& members)
+  {
+    const size_t rank = m_Dims.size();
+    std::vector<hsize_t> boxStart = m_Requests[members.front()].start;
+    std::vector<hsize_t> boxEnd(rank);
+    for(size_t member : members)
+    {
+      const Request& request = m_Requests[member];
+      for(size_t i = 0; i < rank; i++)
+      {
+        boxStart[i] = std::min(boxStart[i], request.start[i]);
+        boxEnd[i] = std::max(boxEnd[i], request.start[i] + request.count[i]);
+      }
+    }
+    std::vector<hsize_t> boxDims(rank);
+    for(size_t i = 0; i < rank; i++)
+    {
+      boxDims[i] = boxEnd[i] - boxStart[i];
+    }
+
+    hid_t fileSpaceID = H5Dget_space(m_DatasetID);
+    hid_t memorySpaceID = H5Screate_simple(static_cast<int32_t>(rank), boxDims.data(), nullptr);
+    std::vector<hsize_t> memoryStart(rank);
+    herr_t error = 0;
+    for(size_t m = 0; m < members.size() && error >= 0; m++)
+    {
+      const Request& request = m_Requests[members[m]];
+      H5S_seloper_t operation = (m == 0) ? H5S_SELECT_SET : H5S_SELECT_OR;
+      for(size_t i = 0; i < rank; i++)
+      {
+        memoryStart[i] = request.start[i] - boxStart[i];
+      }
+      error = H5Sselect_hyperslab(fileSpaceID, operation, request.start.data(), nullptr, request.count.data(), nullptr);
+      error = error < 0 ? error : H5Sselect_hyperslab(memorySpaceID, operation, memoryStart.data(), nullptr, request.count.data(), nullptr);
+    }
+
+    std::vector<T> box(std::accumulate(boxDims.begin(), boxDims.end(), static_cast<size_t>(1), std::multiplies<size_t>()));
+    error = error < 0 ? error : H5Dread(m_DatasetID, H5Lite::HDFTypeForPrimitive<T>(), memorySpaceID, fileSpaceID, H5P_DEFAULT, box.data());
+    H5Sclose(memorySpaceID);
+    H5Sclose(fileSpaceID);
+    if(error < 0)
+    {
+      return error;
+    }
+    m_NumReads++;
+
+    // Copy each region out of the box one row of the fastest dimension at a time
+    std::vector<hsize_t> index(rank);
+    for(size_t member : members)
+    {
+      const Request& request = m_Requests[member];
+      const size_t rowLength = static_cast<size_t>(request.count[rank - 1]);
+      const size_t numRows = std::accumulate(request.count.begin(), request.count.end() - 1, static_cast<size_t>(1), std::multiplies<size_t>());
+      std::fill(index.begin(), index.end(), 0);
+      for(size_t row = 0; row < numRows; row++)
+      {
+        size_t offset = 0;
+        for(size_t i = 0; i < rank; i++)
+        {
+          offset = offset * boxDims[i] + (request.start[i] - boxStart[i] + index[i]);
+        }
+        std::copy(box.begin() + offset, box.begin() + offset + rowLength, request.buffer + row * rowLength);
+        for(size_t i = rank - 1; i-- > 0;)
+        {
+          if(++index[i] < request.count[i])
+          {
+            break;
+          }
+          index[i] = 0;
+        }
+      }
+    }
+    return error;
+  }
+};
+
+}; // namespace H5Support
@@ -0,0 +1,669 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <hdf5.h>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5MemoryBudget.h"
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5ReadFarm class reads datasets with several worker processes. This scales
+ * reads with the number of cores even if the HDF5 library is not thread-safe, because
+ * every process has its own copy of the library. The workers are forked for each call,
+ * open the file read-only and read their share of the data straight into memory that is
+ * shared with the calling process.
+ *
+ * The workers are forked from the calling process, so no other thread may be inside an
+ * HDF5 call while a read is running, and the file should not be open for writing in the
+ * calling process. On Windows, or with a single process, the reads run in the calling
+ * process instead. The shared memory is reserved against H5MemoryBudget::global() for as
+ * long as it exists.
+ */
+class H5ReadFarm
+{
+public:
+  /**
+   * @brief The SharedBuffer class owns memory that worker processes can write into
+   */
+  class SharedBuffer
+  {
+  public:
+    SharedBuffer() = default;
+
+    ~SharedBuffer()
+    {
+      release();
+    }
+
+    SharedBuffer(const SharedBuffer&) = delete;            // Copy Constructor Not Implemented
+    SharedBuffer& operator=(const SharedBuffer&) = delete; // Copy Assignment Not Implemented
+
+    SharedBuffer(SharedBuffer&& other) noexcept
+    : m_Data(other.m_Data)
+    , m_Size(other.m_Size)
+    , m_Reservation(std::move(other.m_Reservation))
+    {
+      other.m_Data = nullptr;
+      other.m_Size = 0;
+    }
+
+    SharedBuffer& operator=(SharedBuffer&& other) noexcept
+    {
+      if(this != &other)
+      {
+        release();
+        m_Data = other.m_Data;
+        m_Size = other.m_Size;
+        m_Reservation = std::move(other.m_Reservation);
+        other.m_Data = nullptr;
+        other.m_Size = 0;
+      }
+      return *this;
+    }
+
+    /**
+     * @brief Replaces the buffer with a new one of the given size
+     * @param size Number of bytes
+     * @return Standard HDF5 error condition
+     */
+    herr_t allocate(size_t size)
+    {
+      release();
+      if(size == 0)
+      {
+        return 0;
+      }
+      m_Reservation = H5MemoryBudget::Reservation(size);
+      if(!m_Reservation.isValid())
+      {
+        std::cout << "H5ReadFarm: Error reserving " << size << " bytes of shared memory" << std::endl;
+        return -1;
+      }
+#if defined(_WIN32)
+      void* data = std::malloc(size);
+#else
+      void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      data = data == MAP_FAILED ? nullptr : data;
+#endif
+      if(data == nullptr)
+      {
+        std::cout << "H5ReadFarm: Error allocating " << size << " bytes of shared memory" << std::endl;
+        m_Reservation.release();
+        return -1;
+      }
+      m_Data = static_cast<uint8_t*>(data);
+      m_Size = size;
+      return 0;
+    }
+
+    /**
+     * @brief Frees the buffer
+     */
+    void release()
+    {
+      if(m_Data != nullptr)
+      {
+#if defined(_WIN32)
+        std::free(m_Data);
+#else
+        munmap(m_Data, m_Size);
+#endif
+      }
+      m_Data = nullptr;
+      m_Size = 0;
+      m_Reservation.release();
+    }
+
+    /**
+     * @brief Returns the start of the buffer
+     * @return
+     */
+    uint8_t* data() const
+    {
+      return m_Data;
+    }
+
+    /**
+     * @brief Returns the number of bytes in the buffer
+     * @return
+     */
+    size_t size() const
+    {
+      return m_Size;
+    }
+
+  private:
+    uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+    H5MemoryBudget::Reservation m_Reservation;
+  };
+
+  /**
+   * @brief The View class holds the values of a dataset in the memory the workers read
+   * them into, so they can be used without copying them out first
+   */
+  template <typename T>
+  class View
+  {
+  public:
+    using value_type = T;
+
+    View() = default;
+    ~View() = default;
+
+    View(const View&) = delete;            // Copy Constructor Not Implemented
+    View& operator=(const View&) = delete; // Copy Assignment Not Implemented
+
+    View(View&& other) noexcept
+    : m_Buffer(std::move(other.m_Buffer))
+    , m_Size(other.m_Size)
+    {
+      other.m_Size = 0;
+    }
+
+    View& operator=(View&& other) noexcept
+    {
+      if(this != &other)
+      {
+        m_Buffer = std::move(other.m_Buffer);
+        m_Size = other.m_Size;
+        other.m_Size = 0;
+      }
+      return *this;
+    }
+
+    T* data() const
+    {
+      return reinterpret_cast<T*>(m_Buffer.data());
+    }
+
+    size_t size() const
+    {
+      return m_Size;
+    }
+
+    bool empty() const
+    {
+      return m_Size == 0;
+    }
+
+    T* begin() const
+    {
+      return data();
+    }
+
+    T* end() const
+    {
+      return data() + m_Size;
+    }
+
+    T& operator[](size_t index) const
+    {
+      return data()[index];
+    }
+
+  private:
+    friend class H5ReadFarm;
+
+    SharedBuffer m_Buffer;
+    size_t m_Size = 0;
+  };
+
+  /**
+   * @brief Prepares reading from a file
+   * @param filePath The file to read
+   * @param numProcesses Number of worker processes. Zero uses the number of hardware threads.
+   */
+  explicit H5ReadFarm(const std::string& filePath, size_t numProcesses = 0)
+  : m_FilePath(filePath)
+  , m_NumProcesses(numProcesses == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : numProcesses)
+  {
+  }
+
+  /**
+   * @brief Returns true if reads can be spread over worker processes on this platform
+   * @return
+   */
+  static bool isAvailable()
+  {
+#if defined(_WIN32)
+    return false;
+#else
+    return true;
+#endif
+  }
+
+  /**
+   * @brief Returns the number of worker processes
+   * @return
+   */
+  size_t numProcesses() const
+  {
+    return m_NumProcesses;
+  }
+
+  /**
+   * @brief Reads a dataset with the rows of its slowest dimension split over the worker
+   * processes. The values stay in the shared memory the workers wrote them to.
+   * @param datasetName The path of the dataset
+   * @param view Set to the values of the dataset
+   * @return Standard HDF5 error condition
+   */
+  template <typename T>
+  herr_t readDataset(const std::string& datasetName, View<T>& view)
+  {
+    view = View<T>();
+    std::vector<Task> tasks;
+    std::vector<hsize_t> dims;
+    size_t numBytes = 0;
+    if(planDataset(datasetName, H5Lite::HDFTypeForPrimitive<T>(), sizeof(T), m_NumProcesses, tasks, numBytes, dims) < 0 || view.m_Buffer.allocate(numBytes) < 0)
+    {
+      return -1;
+    }
+    herr_t error = run(tasks, sharedDestinations(tasks, view.m_Buffer), true);
+    view.m_Size = error < 0 ? 0 : numBytes / sizeof(T);
+    return error;
+  }
+
+  /**
+   * @brief Reads a dataset with the rows of its slowest dimension split over the worker
+   * processes. With more than one worker the values are copied out of the shared memory
+   * once; use readDataset() to avoid the copy.
+   * @param datasetName The path of the dataset
+   * @param data Set to the values of the dataset
+   * @return Standard HDF5 error condition
+   */
+  template <typename T>
+  herr_t readVectorDataset(const std::string& datasetName, std::vector<T>& data)
+  {
+    std::vector<Task> tasks;
+    std::vector<hsize_t> dims;
+    size_t numBytes = 0;
+    if(planDataset(datasetName, H5Lite::HDFTypeForPrimitive<T>(), sizeof(T), m_NumProcesses, tasks, numBytes, dims) < 0)
+    {
+      return -1;
+    }
+    if(!usesWorkers(tasks))
+    {
+      data.resize(numBytes / sizeof(T));
+      std::vector<uint8_t*> destinations;
+      for(const auto& task : tasks)
+      {
+        destinations.push_back(reinterpret_cast<uint8_t*>(data.data()) + task.offset);
+      }
+      return run(tasks, destinations, false);
+    }
+    SharedBuffer buffer;
+    if(buffer.allocate(numBytes) < 0)
+    {
+      return -1;
+    }
+    herr_t error = run(tasks, sharedDestinations(tasks, buffer), true);
+    if(error >= 0)
+    {
+      const T* values = reinterpret_cast<const T*>(buffer.data());
+      data.assign(values, values + numBytes / sizeof(T));
+    }
+    return error;
+  }
+
+  /**
+   * @brief Reads whole datasets with the datasets spread over the worker processes, largest
+   * first. With more than one worker each dataset is copied out of the shared memory once.
+   * @param datasetNames The paths of the datasets
+   * @param data Set to the values of each dataset
+   * @return Standard HDF5 error condition
+   */
+  template <typename T>
+  herr_t readVectorDatasets(const std::vector<std::string>& datasetNames, std::vector<std::vector<T>>& data)
+  {
+    std::vector<Task> tasks;
+    std::vector<hsize_t> dims;
+    size_t numBytes = 0;
+    for(const auto& datasetName : datasetNames)
+    {
+      if(planDataset(datasetName, H5Lite::HDFTypeForPrimitive<T>(), sizeof(T), 1, tasks, numBytes, dims) < 0)
+      {
+        return -1;
+      }
+    }
+    data.resize(datasetNames.size());
+    if(!usesWorkers(tasks))
+    {
+      std::vector<uint8_t*> destinations;
+      for(size_t i = 0; i < tasks.size(); i++)
+      {
+        data[i].resize(tasks[i].numElements);
+        destinations.push_back(reinterpret_cast<uint8_t*>(data[i].data()));
+      }
+      return run(tasks, destinations, false);
+    }
+    SharedBuffer buffer;
+    if(buffer.allocate(numBytes) < 0)
+    {
+      return -1;
+    }
+    herr_t error = run(tasks, sharedDestinations(tasks, buffer), true);
+    for(size_t i = 0; i < tasks.size() && error >= 0; i++)
+    {
+      const T* values = reinterpret_cast<const T*>(buffer.data() + tasks[i].offset);
+      data[i].assign(values, values + tasks[i].numElements);
+    }
+    return error;
+  }
+
+  /**
+   * @brief Reads whole datasets into the storage described by each entry, with the datasets
+   * spread over the worker processes, largest first. Each entry either provides the storage
+   * or a resize function, as H5Lite::makeDatasetBuffer does, and its dims are set to the
+   * shape of the dataset. With more than one worker each dataset is copied out of the shared
+   * memory once.
+   * @param datasets
+   * @return Standard HDF5 error condition
+   */
+  herr_t readDatasets(std::vector<H5Lite::DatasetBuffer>& datasets)
+  {
+    std::vector<Task> tasks;
+    size_t numBytes = 0;
+    for(auto& dataset : datasets)
+    {
+      size_t typeSize = dataset.dataType >= 0 ? H5Tget_size(dataset.dataType) : 0;
+      if(typeSize == 0 || planDataset(dataset.name, dataset.dataType, typeSize, 1, tasks, numBytes, dataset.dims) < 0)
+      {
+        return -1;
+      }
+      const size_t numElements = tasks.back().numElements;
+      if(dataset.resize)
+      {
+        dataset.data = dataset.resize(numElements);
+        dataset.numElements = numElements;
+      }
+      if(dataset.numElements < numElements || (numElements > 0 && dataset.data == nullptr))
+      {
+        std::cout << "H5ReadFarm: No room to read dataset '" << dataset.name << "'" << std::endl;
+        return -1;
+      }
+    }
+    if(!usesWorkers(tasks))
+    {
+      std::vector<uint8_t*> destinations;
+      for(const auto& dataset : datasets)
+      {
+        destinations.push_back(static_cast<uint8_t*>(dataset.data));
+      }
+      return run(tasks, destinations, false);
+    }
+    SharedBuffer buffer;
+    if(buffer.allocate(numBytes) < 0)
+    {
+      return -1;
+    }
+    herr_t error = run(tasks, sharedDestinations(tasks, buffer), true);
+    for(size_t i = 0; i < tasks.size() && error >= 0; i++)
+    {
+      std::memcpy(datasets[i].data, buffer.data() + tasks[i].offset, tasks[i].numElements * tasks[i].typeSize);
+    }
+    return error;
+  }
+
+private:
+  /**
+   * @brief Part of a dataset that one worker reads
+   */
+  struct Task
+  {
+    std::string datasetName;
+    hid_t dataType = -1; // Type of the values in memory
+    size_t typeSize = 0;
+    hsize_t firstRow = 0;
+    hsize_t numRows = 0;
+    bool wholeDataset = true;
+    size_t offset = 0;      // Byte position of the first value in the shared buffer
+    size_t numElements = 0; // Number of values the task reads
+  };
+
+  std::string m_FilePath;
+  size_t m_NumProcesses = 1;
+
+  /**
+   * @brief Splits a dataset into at most numParts tasks along its slowest dimension. The
+   * tasks are placed after numBytes, which grows by the size of the dataset in memory.
+   */
+  herr_t planDataset(const std::string& datasetName, hid_t dataType, size_t typeSize, size_t numParts, std::vector<Task>& tasks, size_t& numBytes, std::vector<hsize_t>& dims) const
+  {
+    hid_t fileID = H5Fopen(m_FilePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(fileID < 0)
+    {
+      std::cout << "H5ReadFarm: Error opening file '" << m_FilePath << "'" << std::endl;
+      return -1;
+    }
+    hid_t datasetID = H5Dopen(fileID, datasetName.c_str(), H5P_DEFAULT);
+    if(datasetID < 0)
+    {
+      std::cout << "H5ReadFarm: Error opening dataset '" << datasetName << "'" << std::endl;
+      H5Fclose(fileID);
+      return -1;
+    }
+    hid_t dataspaceID = H5Dget_space(datasetID);
+    dims.assign(std::max(H5Sget_simple_extent_ndims(dataspaceID), 0), 0);
+    H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+    size_t datasetElements = static_cast<size_t>(std::max<hssize_t>(H5Sget_simple_extent_npoints(dataspaceID), 0));
+    H5Sclose(dataspaceID);
+    H5Dclose(datasetID);
+    H5Fclose(fileID);
+
+    if(numParts <= 1 || dims.empty() || dims[0] < 2)
+    {
+      tasks.push_back({datasetName, dataType, typeSize, 0, dims.empty() ? 1 : dims[0], true, numBytes, datasetElements});
+      numBytes += datasetElements * typeSize;
+      return 0;
+    }
+    const size_t rowElements = datasetElements / dims[0];
+    const hsize_t rowsPerPart = (dims[0] + numParts - 1) / numParts;
+    for(hsize_t row = 0; row < dims[0]; row += rowsPerPart)
+    {
+      hsize_t numRows = std::min(rowsPerPart, dims[0] - row);
+      tasks.push_back({datasetName, dataType, typeSize, row, numRows, false, numBytes, static_cast<size_t>(numRows) * rowElements});
+      numBytes += tasks.back().numElements * typeSize;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Returns true if the tasks are spread over more than one worker process
+   */
+  bool usesWorkers(const std::vector<Task>& tasks) const
+  {
+    return isAvailable() && std::min(m_NumProcesses, tasks.size()) > 1;
+  }
+
+  /**
+   * @brief Returns where each task writes its values in a shared buffer
+   */
+  static std::vector<uint8_t*> sharedDestinations(const std::vector<Task>& tasks, const SharedBuffer& buffer)
+  {
+    std::vector<uint8_t*> destinations;
+    for(const auto& task : tasks)
+    {
+      destinations.push_back(buffer.data() == nullptr ? nullptr : buffer.data() + task.offset);
+    }
+    return destinations;
+  }
+
+  /**
+   * @brief Reads a list of tasks, each into its own destination. This runs inside the worker processes.
+   */
+  static herr_t readTasks(const std::string& filePath, const std::vector<Task>& tasks, const std::vector<size_t>& taskIndices, const std::vector<uint8_t*>& destinations)
+  {
+    hid_t fileID = H5Fopen(filePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(fileID < 0)
+    {
+      return -1;
+    }
+    herr_t error = 0;
+    for(size_t index : taskIndices)
+    {
+      const Task& task = tasks[index];
+      hid_t datasetID = H5Dopen(fileID, task.datasetName.c_str(), H5P_DEFAULT);
+      if(datasetID < 0)
+      {
+        error = -1;
+        break;
+      }
+      if(task.wholeDataset)
+      {
+        error = H5Dread(datasetID, task.dataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, destinations[index]);
+      }
+      else
+      {
+        hid_t fileSpaceID = H5Dget_space(datasetID);
+        int32_t rank = H5Sget_simple_extent_ndims(fileSpaceID);
+        std::vector<hsize_t> start(rank, 0);
+        std::vector<hsize_t> count(rank);
+        H5Sget_simple_extent_dims(fileSpaceID, count.data(), nullptr);
+        start[0] = task.firstRow;
+        count[0] = task.numRows;
+        hid_t memorySpaceID = H5Screate_simple(rank, count.data(), nullptr);
+        error = H5Sselect_hyperslab(fileSpaceID, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+        error = error < 0 ? error : H5Dread(datasetID, task.dataType, memorySpaceID, fileSpaceID, H5P_DEFAULT, destinations[index]);
+        H5Sclose(memorySpaceID);
+        H5Sclose(fileSpaceID);
+      }
+      H5Dclose(datasetID);
+      if(error < 0)
+      {
+        break;
+      }
+    }
+    H5Fclose(fileID);
+    return error;
+  }
+
+  /**
+   * @brief Spreads the tasks over the worker processes, largest first. The destinations
+   * have to lie in a SharedBuffer if shared is true; otherwise the tasks are read in the
+   * calling process.
+   */
+  herr_t run(const std::vector<Task>& tasks, const std::vector<uint8_t*>& destinations, bool shared) const
+  {
+    const size_t numWorkers = std::min(m_NumProcesses, tasks.size());
+    std::vector<size_t> order(tasks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&tasks](size_t a, size_t b) { return tasks[a].numElements * tasks[a].typeSize > tasks[b].numElements * tasks[b].typeSize; });
+    std::vector<std::vector<size_t>> assignments(std::max<size_t>(numWorkers, 1));
+    std::vector<size_t> load(assignments.size(), 0);
+    for(size_t index : order)
+    {
+      size_t worker = std::min_element(load.begin(), load.end()) - load.begin();
+      assignments[worker].push_back(index);
+      load[worker] += tasks[index].numElements * tasks[index].typeSize;
+    }
+
+    if(!shared || !usesWorkers(tasks))
+    {
+      herr_t error = readTasks(m_FilePath, tasks, order, destinations);
+      if(error < 0)
+      {
+        std::cout << "H5ReadFarm: Error reading from '" << m_FilePath << "'" << std::endl;
+      }
+      return error;
+    }
+
+#if defined(_WIN32)
+    return -1;
+#else
+    // Anything still buffered would otherwise be written again by every worker
+    std::cout.flush();
+    std::fflush(nullptr);
+    std::vector<pid_t> workers;
+    herr_t error = 0;
+    for(const auto& assignment : assignments)
+    {
+      pid_t pid = fork();
+      if(pid == 0)
+      {
+        herr_t workerError = readTasks(m_FilePath, tasks, assignment, destinations);
+        _exit(workerError < 0 ? 1 : 0);
+      }
+      if(pid < 0)
+      {
+        std::cout << "H5ReadFarm: Error starting a worker process" << std::endl;
+        error = -1;
+        break;
+      }
+      workers.push_back(pid);
+    }
+    for(pid_t pid : workers)
+    {
+      int status = 0;
+      if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      {
+        error = -1;
+      }
+    }
+    if(error < 0)
+    {
+      std::cout << "H5ReadFarm: Error reading from '" << m_FilePath << "'" << std::endl;
+    }
+    return error;
+#endif
+  }
+};
+
+}; // namespace H5Support
@@ -8,3 +8,9 @@
 #else
 #define H5SUPPORT_MUTEX_LOCK()
 #endif
+
+/* Class values of the virtual file drivers in H5Support. HDF5 keeps the values below 256 for its
+ * own drivers and 256 to 511 for testing, so drivers outside of HDF5 have to use 512 or more. */
+#define H5SUPPORT_THREADED_IO_DRIVER_VALUE 680
+#define H5SUPPORT_PAGE_CACHE_DRIVER_VALUE 681
+#define H5SUPPORT_CALLBACK_DRIVER_VALUE 682
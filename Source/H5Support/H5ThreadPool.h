@@ -0,0 +1,152 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "H5Support/H5Support.h"
+
+namespace H5Support
+{
+
+/**
+ * @brief The H5ThreadPool class is a small fixed size pool of worker threads that
+ * service a FIFO queue of tasks. The pool joins all of its threads when it goes
+ * out of scope after finishing any tasks that are still queued.
+ */
+class H5ThreadPool
+{
+public:
+  /**
+   * @brief Creates the pool and starts the worker threads
+   * @param numThreads The number of worker threads. Zero is treated as one.
+   */
+  explicit H5ThreadPool(size_t numThreads = std::thread::hardware_concurrency())
+  {
+    if(numThreads == 0)
+    {
+      numThreads = 1;
+    }
+    m_Workers.reserve(numThreads);
+    for(size_t i = 0; i < numThreads; i++)
+    {
+      m_Workers.emplace_back([this]() { run(); });
+    }
+  }
+
+  ~H5ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for(auto& worker : m_Workers)
+    {
+      worker.join();
+    }
+  }
+
+  H5ThreadPool(const H5ThreadPool&) = delete;            // Copy Constructor Not Implemented
+  H5ThreadPool(H5ThreadPool&&) = delete;                 // Move Constructor Not Implemented
+  H5ThreadPool& operator=(const H5ThreadPool&) = delete; // Copy Assignment Not Implemented
+  H5ThreadPool& operator=(H5ThreadPool&&) = delete;      // Move Assignment Not Implemented
+
+  /**
+   * @brief Queues a task for execution on one of the worker threads
+   * @param func The callable to execute
+   * @return A future that holds the result of the callable
+   */
+  template <typename Func>
+  std::future<std::invoke_result_t<std::decay_t<Func>>> submit(Func&& func)
+  {
+    using ResultType = std::invoke_result_t<std::decay_t<Func>>;
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Func>(func));
+    std::future<ResultType> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Tasks.emplace_back([task]() { (*task)(); });
+    }
+    m_Condition.notify_one();
+    return result;
+  }
+
+  /**
+   * @brief Returns the number of worker threads
+   * @return
+   */
+  size_t size() const
+  {
+    return m_Workers.size();
+  }
+
+private:
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  bool m_Stopping = false;
+
+  void run()
+  {
+    while(true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+        if(m_Tasks.empty())
+        {
+          return;
+        }
+        task = std::move(m_Tasks.front());
+        m_Tasks.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+}; // namespace H5Support
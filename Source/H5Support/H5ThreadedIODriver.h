@@ -0,0 +1,509 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "H5Support/H5Support.h"
+#include "H5Support/H5ThreadPool.h"
+
+#if !defined(_WIN32)
+#define H5Support_HAVE_THREADED_IO_DRIVER 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace H5Support
+{
+
+/**
+ * @brief HDF5 virtual file driver that services large transfers with several
+ * pread/pwrite calls running in parallel. Any read or write above the split
+ * threshold is cut into one slice per thread. Sequential reads also issue
+ * posix_fadvise read-ahead hints for the region that follows them.
+ *
+ * Files written through this driver are ordinary sec2 compatible HDF5 files.
+ * On platforms without pread/pwrite the sec2 driver is used instead.
+ */
+namespace H5ThreadedIODriver
+{
+
+/**
+ * @brief Driver settings stored in the file access property list
+ */
+struct Config
+{
+  size_t splitThreshold = 8 * 1024 * 1024; // Transfers of at least this many bytes are split
+  size_t numThreads = 4;                   // Number of slices (and worker threads) per split transfer
+  bool readAheadHints = true;              // Issue posix_fadvise hints for sequential reads
+};
+
+namespace detail
+{
+#ifdef H5Support_HAVE_THREADED_IO_DRIVER
+
+inline constexpr haddr_t k_MaxAddress = (static_cast<haddr_t>(1) << (8 * sizeof(off_t) - 1)) - 1;
+inline constexpr size_t k_SliceAlignment = 4096;
+
+/**
+ * @brief Per-file driver state. The H5FD_t member must stay first so HDF5 can
+ * treat a pointer to this struct as a pointer to its public file struct.
+ */
+struct File
+{
+  H5FD_t pub;
+  int fd;
+  haddr_t eoa;
+  haddr_t eof;
+  dev_t device;
+  ino_t inode;
+  haddr_t lastReadEnd;
+  Config config;
+  H5ThreadPool* pool;
+  std::mutex* poolMutex;
+};
+
+inline File* toFile(H5FD_t* file)
+{
+  return reinterpret_cast<File*>(file);
+}
+
+inline const File* toFile(const H5FD_t* file)
+{
+  return reinterpret_cast<const File*>(file);
+}
+
+/**
+ * @brief Reads size bytes at offset, retrying short reads and zero filling anything past the end of file
+ */
+inline herr_t readRange(int fd, haddr_t offset, size_t size, unsigned char* buffer)
+{
+  while(size > 0)
+  {
+    ssize_t bytesRead = ::pread(fd, buffer, size, static_cast<off_t>(offset));
+    if(bytesRead < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    if(bytesRead == 0)
+    {
+      std::memset(buffer, 0, size);
+      break;
+    }
+    size -= static_cast<size_t>(bytesRead);
+    offset += static_cast<haddr_t>(bytesRead);
+    buffer += bytesRead;
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes size bytes at offset, retrying short writes
+ */
+inline herr_t writeRange(int fd, haddr_t offset, size_t size, const unsigned char* buffer)
+{
+  while(size > 0)
+  {
+    ssize_t bytesWritten = ::pwrite(fd, buffer, size, static_cast<off_t>(offset));
+    if(bytesWritten < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    size -= static_cast<size_t>(bytesWritten);
+    offset += static_cast<haddr_t>(bytesWritten);
+    buffer += bytesWritten;
+  }
+  return 0;
+}
+
+/**
+ * @brief Runs rangeFunc either directly or as one slice per thread when the transfer is large enough.
+ * The calling thread services the first slice itself.
+ */
+template <typename Buffer, typename RangeFunc>
+herr_t transfer(File* file, haddr_t addr, size_t size, Buffer buffer, RangeFunc rangeFunc)
+{
+  size_t numSlices = std::max<size_t>(file->config.numThreads, 1);
+  if(size < file->config.splitThreshold || numSlices == 1)
+  {
+    return rangeFunc(file->fd, addr, size, buffer);
+  }
+
+  size_t sliceSize = (size + numSlices - 1) / numSlices;
+  sliceSize = ((sliceSize + k_SliceAlignment - 1) / k_SliceAlignment) * k_SliceAlignment;
+
+  {
+    std::lock_guard<std::mutex> lock(*file->poolMutex);
+    if(file->pool == nullptr)
+    {
+      file->pool = new H5ThreadPool(numSlices - 1);
+    }
+  }
+
+  std::vector<std::future<herr_t>> pending;
+  for(size_t offset = sliceSize; offset < size; offset += sliceSize)
+  {
+    size_t count = std::min(sliceSize, size - offset);
+    int fd = file->fd;
+    pending.push_back(file->pool->submit([=]() { return rangeFunc(fd, addr + offset, count, buffer + offset); }));
+  }
+  herr_t error = rangeFunc(file->fd, addr, std::min(sliceSize, size), buffer);
+  for(auto& slice : pending)
+  {
+    if(slice.get() < 0)
+    {
+      error = -1;
+    }
+  }
+  return error;
+}
+
+inline void* faplGet(H5FD_t* file)
+{
+  return new Config(toFile(file)->config);
+}
+
+inline void* faplCopy(const void* fapl)
+{
+  return new Config(*reinterpret_cast<const Config*>(fapl));
+}
+
+inline herr_t faplFree(void* fapl)
+{
+  delete reinterpret_cast<Config*>(fapl);
+  return 0;
+}
+
+inline H5FD_t* open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr)
+{
+  if(name == nullptr || *name == '\0' || maxaddr == 0 || maxaddr == HADDR_UNDEF || maxaddr > k_MaxAddress)
+  {
+    return nullptr;
+  }
+
+  int openFlags = (flags & H5F_ACC_RDWR) != 0 ? O_RDWR : O_RDONLY;
+  if((flags & H5F_ACC_TRUNC) != 0)
+  {
+    openFlags |= O_TRUNC;
+  }
+  if((flags & H5F_ACC_CREAT) != 0)
+  {
+    openFlags |= O_CREAT;
+  }
+  if((flags & H5F_ACC_EXCL) != 0)
+  {
+    openFlags |= O_EXCL;
+  }
+
+  int fd = ::open(name, openFlags, 0666);
+  if(fd < 0)
+  {
+    return nullptr;
+  }
+  struct stat fileStats
+  {
+  };
+  if(::fstat(fd, &fileStats) < 0)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  File* file = new File{};
+  file->fd = fd;
+  file->eof = static_cast<haddr_t>(fileStats.st_size);
+  file->device = fileStats.st_dev;
+  file->inode = fileStats.st_ino;
+  file->lastReadEnd = HADDR_UNDEF;
+  file->poolMutex = new std::mutex;
+
+  const void* driverInfo = H5Pget_driver_info(fapl);
+  if(driverInfo != nullptr)
+  {
+    file->config = *reinterpret_cast<const Config*>(driverInfo);
+  }
+#if defined(POSIX_FADV_SEQUENTIAL)
+  if(file->config.readAheadHints)
+  {
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+#endif
+  return &file->pub;
+}
+
+inline herr_t close(H5FD_t* h5File)
+{
+  File* file = toFile(h5File);
+  delete file->pool;
+  delete file->poolMutex;
+  herr_t error = ::close(file->fd) < 0 ? -1 : 0;
+  delete file;
+  return error;
+}
+
+inline int compare(const H5FD_t* h5File1, const H5FD_t* h5File2)
+{
+  const File* file1 = toFile(h5File1);
+  const File* file2 = toFile(h5File2);
+  if(file1->device != file2->device)
+  {
+    return file1->device < file2->device ? -1 : 1;
+  }
+  if(file1->inode != file2->inode)
+  {
+    return file1->inode < file2->inode ? -1 : 1;
+  }
+  return 0;
+}
+
+inline herr_t query(const H5FD_t* /*file*/, unsigned long* flags)
+{
+  if(flags != nullptr)
+  {
+    *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA | H5FD_FEAT_POSIX_COMPAT_HANDLE |
+             H5FD_FEAT_DEFAULT_VFD_COMPATIBLE;
+  }
+  return 0;
+}
+
+inline haddr_t getEoa(const H5FD_t* file, H5FD_mem_t /*type*/)
+{
+  return toFile(file)->eoa;
+}
+
+inline herr_t setEoa(H5FD_t* file, H5FD_mem_t /*type*/, haddr_t addr)
+{
+  toFile(file)->eoa = addr;
+  return 0;
+}
+
+inline haddr_t getEof(const H5FD_t* file, H5FD_mem_t /*type*/)
+{
+  return toFile(file)->eof;
+}
+
+inline herr_t getHandle(H5FD_t* file, hid_t /*fapl*/, void** fileHandle)
+{
+  if(fileHandle == nullptr)
+  {
+    return -1;
+  }
+  *fileHandle = &(toFile(file)->fd);
+  return 0;
+}
+
+inline herr_t read(H5FD_t* h5File, H5FD_mem_t /*type*/, hid_t /*dxpl*/, haddr_t addr, size_t size, void* buffer)
+{
+  File* file = toFile(h5File);
+  if(addr == HADDR_UNDEF || addr + size > file->eoa)
+  {
+    return -1;
+  }
+#if defined(POSIX_FADV_WILLNEED)
+  if(file->config.readAheadHints && addr == file->lastReadEnd)
+  {
+    size_t window = std::max(size, file->config.splitThreshold);
+    ::posix_fadvise(file->fd, static_cast<off_t>(addr + size), static_cast<off_t>(window), POSIX_FADV_WILLNEED);
+  }
+#endif
+  file->lastReadEnd = addr + size;
+  return transfer(file, addr, size, reinterpret_cast<unsigned char*>(buffer), readRange);
+}
+
+inline herr_t write(H5FD_t* h5File, H5FD_mem_t /*type*/, hid_t /*dxpl*/, haddr_t addr, size_t size, const void* buffer)
+{
+  File* file = toFile(h5File);
+  if(addr == HADDR_UNDEF || addr + size > file->eoa)
+  {
+    return -1;
+  }
+  herr_t error = transfer(file, addr, size, reinterpret_cast<const unsigned char*>(buffer), writeRange);
+  if(error >= 0 && addr + size > file->eof)
+  {
+    file->eof = addr + size;
+  }
+  return error;
+}
+
+inline herr_t truncate(H5FD_t* h5File, hid_t /*dxpl*/, hbool_t /*closing*/)
+{
+  File* file = toFile(h5File);
+  if(file->eoa != file->eof)
+  {
+    if(::ftruncate(file->fd, static_cast<off_t>(file->eoa)) < 0)
+    {
+      return -1;
+    }
+    file->eof = file->eoa;
+  }
+  return 0;
+}
+
+inline herr_t lock(H5FD_t* file, hbool_t readWrite)
+{
+  int operation = (readWrite != 0 ? LOCK_EX : LOCK_SH) | LOCK_NB;
+  if(::flock(toFile(file)->fd, operation) < 0)
+  {
+    // File systems without lock support should not prevent the file from opening
+    return errno == ENOSYS ? 0 : -1;
+  }
+  return 0;
+}
+
+inline herr_t unlock(H5FD_t* file)
+{
+  if(::flock(toFile(file)->fd, LOCK_UN) < 0)
+  {
+    return errno == ENOSYS ? 0 : -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Returns the class description registered with HDF5
+ */
+inline const H5FD_class_t& driverClass()
+{
+  static const H5FD_class_t s_Class = []() {
+    H5FD_class_t driver{};
+#if H5_VERSION_GE(1, 13, 2)
+    driver.version = H5FD_CLASS_VERSION;
+    driver.value = static_cast<H5FD_class_value_t>(H5SUPPORT_THREADED_IO_DRIVER_VALUE);
+#endif
+    driver.name = "h5support_threaded_io";
+    driver.maxaddr = k_MaxAddress;
+    driver.fc_degree = H5F_CLOSE_WEAK;
+    driver.fapl_size = sizeof(Config);
+    driver.fapl_get = faplGet;
+    driver.fapl_copy = faplCopy;
+    driver.fapl_free = faplFree;
+    driver.open = open;
+    driver.close = close;
+    driver.cmp = compare;
+    driver.query = query;
+    driver.get_eoa = getEoa;
+    driver.set_eoa = setEoa;
+    driver.get_eof = getEof;
+    driver.get_handle = getHandle;
+    driver.read = read;
+    driver.write = write;
+    driver.truncate = truncate;
+    driver.lock = lock;
+    driver.unlock = unlock;
+    const H5FD_mem_t freeListMap[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+    std::copy(freeListMap, freeListMap + H5FD_MEM_NTYPES, driver.fl_map);
+    return driver;
+  }();
+  return s_Class;
+}
+#endif
+} // namespace detail
+
+/**
+ * @brief Returns true if the driver is available on this platform
+ * @return
+ */
+inline constexpr bool isAvailable()
+{
+#ifdef H5Support_HAVE_THREADED_IO_DRIVER
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Registers the driver with HDF5 (once per library initialization) and returns its id
+ * @return The driver id. Negative value is error.
+ */
+inline hid_t driverID()
+{
+#ifdef H5Support_HAVE_THREADED_IO_DRIVER
+  static std::mutex s_Mutex;
+  static hid_t s_DriverID = -1;
+  std::lock_guard<std::mutex> lock(s_Mutex);
+  if(H5Iget_type(s_DriverID) != H5I_VFL)
+  {
+    s_DriverID = H5FDregister(&detail::driverClass());
+  }
+  return s_DriverID;
+#else
+  return H5FD_SEC2;
+#endif
+}
+
+/**
+ * @brief Selects the threaded IO driver on a file access property list
+ * @param fileAccessPropertyList The file access property list to modify
+ * @param config The driver settings
+ * @return Standard HDF5 error condition
+ */
+inline herr_t setFileAccessProperties(hid_t fileAccessPropertyList, const Config& config = Config())
+{
+#ifdef H5Support_HAVE_THREADED_IO_DRIVER
+  hid_t driver = driverID();
+  if(driver < 0)
+  {
+    return static_cast<herr_t>(driver);
+  }
+  return H5Pset_driver(fileAccessPropertyList, driver, &config);
+#else
+  return H5Pset_fapl_sec2(fileAccessPropertyList);
+#endif
+}
+
+} // namespace H5ThreadedIODriver
+
+}; // namespace H5Support
@@ -34,16 +34,41 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include <hdf5.h>
 #include "H5Fpublic.h"
 
+#include "H5Support/H5CallbackDriver.h"
 #include "H5Support/H5Lite.h"
+#include "H5Support/H5PageCacheDriver.h"
 #include "H5Support/H5Support.h"
+#include "H5Support/H5ThreadPool.h"
+#include "H5Support/H5ThreadedIODriver.h"
 
 /**
  * Define the libraries features and file compatibility that will be used when opening
@@ -101,31 +126,238 @@ enum class CustomHDFDataTypes : int32_t
   Any = 15
 };
 
+/**
+ * @brief The virtual file driver used when opening or creating a file
+ */
+enum class FileDriver : int32_t
+{
+  Default = 0,    // The HDF5 default driver (sec2)
+  ThreadedIO = 1, // Large transfers are split over several threads. See H5ThreadedIODriver
+  PageCache = 2,  // Reads go through a user-space page cache. See H5PageCacheDriver
+  Callback = 3    // Read only access to a user supplied byte source. See H5CallbackDriver
+};
+
+/**
+ * @brief Options that control how openFile and createFile set up a file
+ */
+struct FileOptions
+{
+  FileDriver driver = FileDriver::Default;
+  H5ThreadedIODriver::Config threadedIO;
+  H5PageCacheDriver::Config pageCache;
+  H5CallbackDriver::Config callback;
+
+  // File space layout used by createFile. Paged files group metadata and small raw data
+  // into fixed size pages so reading them touches fewer distinct blocks. Paged files
+  // need HDF5 1.10 or newer to be read.
+  bool pagedFileSpace = false;      // Use the H5F_FSPACE_STRATEGY_PAGE file space strategy
+  hsize_t fileSpacePageSize = 4096; // Size of a file space page in bytes
+  bool persistFreeSpace = true;     // Keep free space tracking in the file between sessions
+  hsize_t freeSpaceThreshold = 1;   // Smallest free section in bytes that is tracked
+
+  // Page buffer used by openFile and createFile. Only paged files can use it; other files
+  // are created and opened without one.
+  size_t pageBufferSize = 0;                 // Bytes. Zero disables the page buffer
+  uint32_t pageBufferMinMetadataPercent = 0; // Share of the page buffer reserved for metadata pages
+  uint32_t pageBufferMinRawDataPercent = 0;  // Share of the page buffer reserved for raw data pages
+
+  // Metadata cache image. When enabled HDF5 writes the contents of the metadata cache into
+  // the file when a writable file is closed and loads it in one read on the next open, which
+  // skips warming the cache object by object. Opening the file read-write consumes the image.
+  // Files need HDF5 1.10 or newer to be read once an image was written.
+  bool generateCacheImage = false;    // Write a cache image when the file is closed
+  bool saveCacheResizeStatus = false; // Also restore the adaptive cache size on the next open
+
+  // Memory use of long running processes
+  bool evictOnClose = false;       // Drop an object's cached metadata as soon as the object is closed
+  size_t metadataCacheMinSize = 0; // Lower bound of the adaptive metadata cache size. Zero keeps the HDF5 default
+  size_t metadataCacheMaxSize = 0; // Upper bound of the adaptive metadata cache size. Zero keeps the HDF5 default
+};
+
+/**
+ * @brief Size of the metadata cache of one open file in bytes
+ */
+struct MetadataCacheSize
+{
+  size_t maxSize = 0;      // Current upper limit of the cache
+  size_t minCleanSize = 0; // Bytes the cache tries to keep clean
+  size_t currentSize = 0;  // Bytes used by cached entries
+  int32_t numEntries = 0;  // Number of cached entries
+};
+
+/**
+ * @brief Bytes held by the HDF5 free lists of the whole library
+ */
+struct FreeListSizes
+{
+  size_t regular = 0;
+  size_t array = 0;
+  size_t block = 0;
+  size_t factory = 0;
+};
+
+/**
+ * @brief Counters reported by the HDF5 page buffer. Index 0 holds the metadata pages and
+ * index 1 the raw data pages.
+ */
+struct PageBufferStatistics
+{
+  std::array<uint32_t, 2> accesses = {0, 0};
+  std::array<uint32_t, 2> hits = {0, 0};
+  std::array<uint32_t, 2> misses = {0, 0};
+  std::array<uint32_t, 2> evictions = {0, 0};
+  std::array<uint32_t, 2> bypasses = {0, 0};
+};
+
+/**
+ * @brief Creates a file access property list configured from the given options.
+ * The caller is responsible for closing the returned property list.
+ * @param options
+ * @return The property list id. Negative value is error.
+ */
+inline hid_t createFileAccessPropertyList(const FileOptions& options)
+{
+  hid_t fileAccessPropertyList = H5Pcreate(H5P_FILE_ACCESS);
+  if(fileAccessPropertyList < 0)
+  {
+    return fileAccessPropertyList;
+  }
+
+  herr_t error = 0;
+  switch(options.driver)
+  {
+  case FileDriver::ThreadedIO:
+    error = H5ThreadedIODriver::setFileAccessProperties(fileAccessPropertyList, options.threadedIO);
+    break;
+  case FileDriver::PageCache:
+    error = H5PageCacheDriver::setFileAccessProperties(fileAccessPropertyList, options.pageCache);
+    break;
+  case FileDriver::Callback:
+    error = H5CallbackDriver::setFileAccessProperties(fileAccessPropertyList, options.callback);
+    break;
+  case FileDriver::Default:
+    break;
+  }
+
+  if(error < 0)
+  {
+    std::cout << "Error configuring the file driver" << std::endl;
+    H5Pclose(fileAccessPropertyList);
+    return -1;
+  }
+
+#if H5_VERSION_GE(1, 10, 1)
+  if(options.generateCacheImage)
+  {
+    H5AC_cache_image_config_t cacheImageConfig;
+    cacheImageConfig.version = H5AC__CURR_CACHE_IMAGE_CONFIG_VERSION;
+    cacheImageConfig.generate_image = 1;
+    cacheImageConfig.save_resize_status = options.saveCacheResizeStatus ? 1 : 0;
+    cacheImageConfig.entry_ageout = H5AC__CACHE_IMAGE__ENTRY_AGEOUT__NONE;
+    if(H5Pset_mdc_image_config(fileAccessPropertyList, &cacheImageConfig) < 0)
+    {
+      std::cout << "Error configuring the metadata cache image" << std::endl;
+      H5Pclose(fileAccessPropertyList);
+      return -1;
+    }
+  }
+  if(options.evictOnClose && H5Pset_evict_on_close(fileAccessPropertyList, 1) < 0)
+  {
+    std::cout << "Error enabling evict on close" << std::endl;
+    H5Pclose(fileAccessPropertyList);
+    return -1;
+  }
+  if(options.pageBufferSize > 0 && H5Pset_page_buffer_size(fileAccessPropertyList, options.pageBufferSize, options.pageBufferMinMetadataPercent, options.pageBufferMinRawDataPercent) < 0)
+  {
+    std::cout << "Error configuring the page buffer" << std::endl;
+    H5Pclose(fileAccessPropertyList);
+    return -1;
+  }
+#endif
+
+  if(options.metadataCacheMinSize > 0 || options.metadataCacheMaxSize > 0)
+  {
+    H5AC_cache_config_t cacheConfig;
+    cacheConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    error = H5Pget_mdc_config(fileAccessPropertyList, &cacheConfig);
+    if(options.metadataCacheMinSize > 0)
+    {
+      cacheConfig.min_size = options.metadataCacheMinSize;
+    }
+    if(options.metadataCacheMaxSize > 0)
+    {
+      cacheConfig.max_size = options.metadataCacheMaxSize;
+    }
+    cacheConfig.min_size = std::min(cacheConfig.min_size, cacheConfig.max_size);
+    cacheConfig.initial_size = std::max(cacheConfig.min_size, std::min(cacheConfig.initial_size, cacheConfig.max_size));
+    cacheConfig.set_initial_size = 1;
+    if(error < 0 || H5Pset_mdc_config(fileAccessPropertyList, &cacheConfig) < 0)
+    {
+      std::cout << "Error configuring the metadata cache size" << std::endl;
+      H5Pclose(fileAccessPropertyList);
+      return -1;
+    }
+  }
+  return fileAccessPropertyList;
+}
+
+/**
+ * @brief Creates a file creation property list configured from the given options.
+ * The caller is responsible for closing the returned property list.
+ * @param options
+ * @return The property list id. Negative value is error.
+ */
+inline hid_t createFileCreationPropertyList(const FileOptions& options)
+{
+  hid_t fileCreationPropertyList = H5Pcreate(H5P_FILE_CREATE);
+  if(fileCreationPropertyList < 0 || !options.pagedFileSpace)
+  {
+    return fileCreationPropertyList;
+  }
+
+#if H5_VERSION_GE(1, 10, 1)
+  herr_t error = H5Pset_file_space_strategy(fileCreationPropertyList, H5F_FSPACE_STRATEGY_PAGE, options.persistFreeSpace, options.freeSpaceThreshold);
+  if(error >= 0)
+  {
+    error = H5Pset_file_space_page_size(fileCreationPropertyList, options.fileSpacePageSize);
+  }
+  if(error < 0)
+  {
+    std::cout << "Error configuring the paged file space strategy" << std::endl;
+    H5Pclose(fileCreationPropertyList);
+    return -1;
+  }
+#endif
+  return fileCreationPropertyList;
+}
+
 // -----------HDF5 File Operations
 /**
- * @brief Opens a H5 file at path filename. Can be made read only access. Returns the id of the file object.
+ * @brief Opens a H5 file at path filename using the given options. Can be made read only access. Returns the id of the file object.
  * @param filename
  * @param readOnly
+ * @param options
  * @return
  */
-inline hid_t openFile(const std::string& filename, bool readOnly = false)
+inline hid_t openFile(const std::string& filename, bool readOnly, const FileOptions& options)
 {
   H5SUPPORT_MUTEX_LOCK()
 
   HDF_ERROR_HANDLER_OFF
   hid_t fileID = -1;
-  if(readOnly)
-  {
-    fileID = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-  }
-  else
+  /* Create a file access property list */
+  hid_t fileAccessPropertyList = createFileAccessPropertyList(options);
+  if(fileAccessPropertyList >= 0)
   {
-    /* Create a file access property list */
-    hid_t fileAccessPropertyList = H5Pcreate(H5P_FILE_ACCESS);
-
-    /* Set the file access property list */
-    H5Pset_libver_bounds(fileAccessPropertyList, HDF5_VERSION_LIB_LOWER_BOUNDS, HDF5_VERSION_LIB_UPPER_BOUNDS);
-    fileID = H5Fopen(filename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    fileID = H5Fopen(filename.c_str(), readOnly ? H5F_ACC_RDONLY : H5F_ACC_RDWR, fileAccessPropertyList);
+#if H5_VERSION_GE(1, 10, 1)
+    if(fileID < 0 && options.pageBufferSize > 0)
+    {
+      /* HDF5 refuses a page buffer for files without paged file space so try again without one */
+      H5Pset_page_buffer_size(fileAccessPropertyList, 0, 0, 0);
+      fileID = H5Fopen(filename.c_str(), readOnly ? H5F_ACC_RDONLY : H5F_ACC_RDWR, fileAccessPropertyList);
+    }
+#endif
 
     /* Close the file access property list object */
     H5Pclose(fileAccessPropertyList);
@@ -136,29 +368,93 @@ inline hid_t openFile(const std::string& filename, bool readOnly = false)
 }
 
 /**
- * @brief Creates a H5 file at path filename. Returns the id of the file object.
+ * @brief Opens a H5 file at path filename. Can be made read only access. Returns the id of the file object.
  * @param filename
+ * @param readOnly
  * @return
  */
-inline hid_t createFile(const std::string& filename)
+inline hid_t openFile(const std::string& filename, bool readOnly = false)
+{
+  return openFile(filename, readOnly, FileOptions());
+}
+
+/**
+ * @brief Opens a H5 file read only from a seekable stream, for example a file held in
+ * memory or a member of an archive, without writing it to disk first.
+ * @param name The name HDF5 reports for the file
+ * @param stream The stream holding the file contents
+ * @return
+ */
+inline hid_t openFile(const std::string& name, std::shared_ptr<std::istream> stream)
+{
+  FileOptions options;
+  options.driver = FileDriver::Callback;
+  options.callback = H5CallbackDriver::createStreamConfig(std::move(stream));
+  return openFile(name, true, options);
+}
+
+/**
+ * @brief Creates a H5 file at path filename using the given options. Returns the id of the file object.
+ * @param filename
+ * @param options
+ * @return
+ */
+inline hid_t createFile(const std::string& filename, const FileOptions& options)
 {
   H5SUPPORT_MUTEX_LOCK()
 
   /* Create a file access property list */
-  hid_t fileAccessPropertyList = H5Pcreate(H5P_FILE_ACCESS);
+  hid_t fileAccessPropertyList = createFileAccessPropertyList(options);
+  if(fileAccessPropertyList < 0)
+  {
+    return fileAccessPropertyList;
+  }
+
+  /* Create a file creation property list */
+  hid_t fileCreationPropertyList = createFileCreationPropertyList(options);
+  if(fileCreationPropertyList < 0)
+  {
+    H5Pclose(fileAccessPropertyList);
+    return fileCreationPropertyList;
+  }
 
   /* Set the fapl */
   H5Pset_libver_bounds(fileAccessPropertyList, HDF5_VERSION_LIB_LOWER_BOUNDS, HDF5_VERSION_LIB_UPPER_BOUNDS);
+#if H5_VERSION_GE(1, 10, 2)
+  if(options.pagedFileSpace || options.generateCacheImage)
+  {
+    /* The file space info and cache image messages need the 1.10 file format */
+    H5Pset_libver_bounds(fileAccessPropertyList, HDF5_VERSION_LIB_LOWER_BOUNDS, H5F_LIBVER_V110);
+  }
+#endif
+#if H5_VERSION_GE(1, 10, 1)
+  if(options.pageBufferSize > 0 && !options.pagedFileSpace)
+  {
+    /* HDF5 refuses a page buffer for files without paged file space */
+    H5Pset_page_buffer_size(fileAccessPropertyList, 0, 0, 0);
+  }
+#endif
 
-  /* Create a file with this file access property list */
-  hid_t fileID = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fileAccessPropertyList);
+  /* Create a file with these property lists */
+  hid_t fileID = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, fileCreationPropertyList, fileAccessPropertyList);
 
-  /* Close the file access property list object */
+  /* Close the property list objects */
+  H5Pclose(fileCreationPropertyList);
   H5Pclose(fileAccessPropertyList);
 
   return fileID;
 }
 
+/**
+ * @brief Creates a H5 file at path filename. Returns the id of the file object.
+ * @param filename
+ * @return
+ */
+inline hid_t createFile(const std::string& filename)
+{
+  return createFile(filename, FileOptions());
+}
+
 /**
  * @brief Closes the object id
  * @param locId The object id to close
@@ -217,6 +513,99 @@ inline herr_t closeHDF5Object(hid_t objectID)
   return err;
 }
 
+/**
+ * @brief Reads the page buffer counters of a file that was opened with a page buffer
+ * @param fileID
+ * @param statistics
+ * @return Standard HDF5 error condition. Negative if the file has no page buffer.
+ */
+inline herr_t getPageBufferStatistics(hid_t fileID, PageBufferStatistics& statistics)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+#if H5_VERSION_GE(1, 10, 1)
+  HDF_ERROR_HANDLER_OFF
+  herr_t error = H5Fget_page_buffering_stats(fileID, statistics.accesses.data(), statistics.hits.data(), statistics.misses.data(), statistics.evictions.data(), statistics.bypasses.data());
+  HDF_ERROR_HANDLER_ON
+  return error;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * @brief Reads the current size of the metadata cache of an open file
+ * @param fileID
+ * @param cacheSize
+ * @return Standard HDF5 error condition
+ */
+inline herr_t getMetadataCacheSize(hid_t fileID, MetadataCacheSize& cacheSize)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  int numEntries = 0;
+  herr_t error = H5Fget_mdc_size(fileID, &cacheSize.maxSize, &cacheSize.minCleanSize, &cacheSize.currentSize, &numEntries);
+  cacheSize.numEntries = numEntries;
+  return error;
+}
+
+/**
+ * @brief Changes the size limits of the metadata cache of an open file. The cache is
+ * resized right away, evicting entries if it is currently larger than maxSize.
+ * @param fileID
+ * @param minSize Lower bound of the adaptive cache size in bytes
+ * @param maxSize Upper bound of the adaptive cache size in bytes
+ * @return Standard HDF5 error condition
+ */
+inline herr_t resizeMetadataCache(hid_t fileID, size_t minSize, size_t maxSize)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  H5AC_cache_config_t cacheConfig;
+  cacheConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+  herr_t error = H5Fget_mdc_config(fileID, &cacheConfig);
+  if(error < 0)
+  {
+    return error;
+  }
+  cacheConfig.min_size = std::min(minSize, maxSize);
+  cacheConfig.max_size = maxSize;
+  size_t currentSize = 0;
+  H5Fget_mdc_size(fileID, nullptr, nullptr, &currentSize, nullptr);
+  cacheConfig.initial_size = std::max(cacheConfig.min_size, std::min(currentSize, maxSize));
+  cacheConfig.set_initial_size = 1;
+  return H5Fset_mdc_config(fileID, &cacheConfig);
+}
+
+/**
+ * @brief Reads how many bytes the HDF5 free lists are holding on to
+ * @param sizes
+ * @return Standard HDF5 error condition
+ */
+inline herr_t getFreeListSizes(FreeListSizes& sizes)
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+#if H5_VERSION_GE(1, 10, 7)
+  return H5get_free_list_sizes(&sizes.regular, &sizes.array, &sizes.block, &sizes.factory);
+#else
+  sizes = FreeListSizes();
+  return -1;
+#endif
+}
+
+/**
+ * @brief Returns the memory held by the HDF5 free lists to the system. Long running
+ * processes can call this periodically to keep their memory use from creeping up.
+ * @return Standard HDF5 error condition
+ */
+inline herr_t releaseFreeMemory()
+{
+  H5SUPPORT_MUTEX_LOCK()
+
+  return H5garbage_collect();
+}
+
 /**
  * @brief Closes a H5 file object. Returns the H5 error code.
  * @param fileID
@@ -883,6 +1272,718 @@ inline herr_t getAllAttributeNames(hid_t locationID, const std::string& objectNa
   return error;
 }
 
+// -------------- HDF File Maintenance Methods ----------------------------
+/**
+ * @brief Settings for repackFile
+ */
+struct RepackOptions
+{
+  int32_t compressionLevel = -1;        // -1 keeps the filters of each dataset, 0 removes all filters and 1-9 compresses every dataset with deflate
+  bool chunkedToContiguous = false;     // Stores chunked datasets that end up without filters contiguously. Converted datasets can no longer be extended.
+  size_t numThreads = 1;                // Number of threads that copy datasets. Only used if the HDF5 library is thread-safe.
+  size_t bufferSize = 64 * 1024 * 1024; // Upper bound of the memory used to rewrite a dataset whose storage changes
+  FileOptions fileOptions;              // Options used to create the destination file
+};
+
+/**
+ * @brief Summary of a repackFile run
+ */
+struct RepackStatistics
+{
+  hsize_t sourceSize = 0;      // Size of the source file in bytes
+  hsize_t destinationSize = 0; // Size of the repacked file in bytes
+  hsize_t bytesReclaimed = 0;  // Bytes saved by the repack. Zero if the repacked file is larger.
+  size_t numGroups = 0;        // Number of groups that were copied, not counting the root group
+  size_t numDatasets = 0;      // Number of datasets that were copied
+  size_t numRawCopies = 0;     // Number of datasets whose stored bytes were copied without decoding them
+};
+
+namespace detail
+{
+/**
+ * @brief Copies all attributes of one object to another object
+ * @param sourceID
+ * @param destinationID
+ * @return Standard HDF5 error condition
+ */
+inline herr_t copyAttributes(hid_t sourceID, hid_t destinationID)
+{
+  auto copyAttribute = [](hid_t locationID, const char* name, const H5A_info_t* /*info*/, void* data) -> herr_t {
+    hid_t destinationID = *static_cast<hid_t*>(data);
+    hid_t attributeID = H5Aopen(locationID, name, H5P_DEFAULT);
+    if(attributeID < 0)
+    {
+      return -1;
+    }
+    hid_t typeID = H5Aget_type(attributeID);
+    hid_t dataspaceID = H5Aget_space(attributeID);
+    herr_t error = -1;
+    hid_t newAttributeID = H5Acreate(destinationID, name, typeID, dataspaceID, H5P_DEFAULT, H5P_DEFAULT);
+    if(newAttributeID >= 0)
+    {
+      hssize_t numElements = H5Sget_simple_extent_npoints(dataspaceID);
+      std::vector<uint8_t> buffer(std::max<size_t>(static_cast<size_t>(std::max<hssize_t>(numElements, 0)) * H5Tget_size(typeID), 1));
+      error = H5Aread(attributeID, typeID, buffer.data());
+      if(error >= 0)
+      {
+        error = H5Awrite(newAttributeID, typeID, buffer.data());
+        if(H5Tdetect_class(typeID, H5T_VLEN) > 0 || H5Tis_variable_str(typeID) > 0)
+        {
+          H5Dvlen_reclaim(typeID, dataspaceID, H5P_DEFAULT, buffer.data());
+        }
+      }
+      H5Aclose(newAttributeID);
+    }
+    H5Sclose(dataspaceID);
+    H5Tclose(typeID);
+    H5Aclose(attributeID);
+    if(error < 0)
+    {
+      std::cout << "Error copying attribute '" << name << "'" << std::endl;
+    }
+    return error;
+  };
+  hsize_t index = 0;
+  return H5Aiterate2(sourceID, H5_INDEX_NAME, H5_ITER_INC, &index, copyAttribute, &destinationID);
+}
+
+/**
+ * @brief Builds the creation property list a dataset gets in a repacked file
+ * @param sourceDatasetID The dataset that is copied
+ * @param options
+ * @param changed Set to true if the storage of the dataset is different from the source dataset
+ * @param maxDims The maximum dimensions the new dataspace needs to have
+ * @return The property list or a negative value on error
+ */
+inline hid_t createRepackCreationPropertyList(hid_t sourceDatasetID, const RepackOptions& options, bool& changed, std::vector<hsize_t>& maxDims)
+{
+  changed = false;
+  hid_t dcpl = H5Dget_create_plist(sourceDatasetID);
+  if(dcpl < 0)
+  {
+    return dcpl;
+  }
+  hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+  int32_t rank = H5Sget_simple_extent_ndims(dataspaceID);
+  std::vector<hsize_t> dims(std::max(rank, 0));
+  maxDims.resize(dims.size());
+  H5Sget_simple_extent_dims(dataspaceID, dims.data(), maxDims.data());
+  hssize_t numElements = H5Sget_simple_extent_npoints(dataspaceID);
+  H5Sclose(dataspaceID);
+
+  // Datasets of references point into the source file. HDF5 has to translate them so they are never rewritten.
+  hid_t typeID = H5Dget_type(sourceDatasetID);
+  size_t typeSize = H5Tget_size(typeID);
+  bool hasReferences = H5Tdetect_class(typeID, H5T_REFERENCE) > 0;
+  H5Tclose(typeID);
+  if(hasReferences || rank <= 0 || numElements <= 0)
+  {
+    return dcpl;
+  }
+
+  H5D_layout_t layout = H5Pget_layout(dcpl);
+  herr_t error = 0;
+  if(options.compressionLevel == 0 && H5Pget_nfilters(dcpl) > 0)
+  {
+    error = H5Premove_filter(dcpl, H5Z_FILTER_ALL);
+    changed = true;
+  }
+  else if(options.compressionLevel > 0 && layout != H5D_COMPACT)
+  {
+    if(layout == H5D_CONTIGUOUS)
+    {
+      std::vector<hsize_t> chunks = H5Lite::guessChunkSize(rank, dims.data(), typeSize);
+      error = H5Pset_chunk(dcpl, rank, chunks.data());
+      error = error < 0 ? error : H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_INCR);
+      layout = H5D_CHUNKED;
+    }
+    error = error < 0 ? error : H5Premove_filter(dcpl, H5Z_FILTER_ALL);
+    error = error < 0 ? error : H5Pset_deflate(dcpl, static_cast<uint32_t>(std::min(options.compressionLevel, 9)));
+    changed = true;
+  }
+
+  if(options.chunkedToContiguous && layout == H5D_CHUNKED && H5Pget_nfilters(dcpl) == 0)
+  {
+    error = error < 0 ? error : H5Pset_layout(dcpl, H5D_CONTIGUOUS);
+    error = error < 0 ? error : H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_LATE);
+    maxDims = dims;
+    changed = true;
+  }
+
+  if(changed)
+  {
+    // Every element is written by the copy so there is no reason to write the fill value first
+    error = error < 0 ? error : H5Pset_fill_time(dcpl, H5D_FILL_TIME_NEVER);
+  }
+  if(error < 0)
+  {
+    H5Pclose(dcpl);
+    return -1;
+  }
+  return dcpl;
+}
+
+/**
+ * @brief Copies a single dataset into the repacked file. Datasets whose storage does not
+ * change are copied with H5Ocopy, which moves the stored chunks as they are without running
+ * them through the filter pipeline. All other datasets are read and written again.
+ * @param sourceFileID
+ * @param destinationFileID
+ * @param path Path of the dataset in both files
+ * @param options
+ * @param rawCopy Set to true if the dataset was copied with H5Ocopy
+ * @return Standard HDF5 error condition
+ */
+inline herr_t repackDataset(hid_t sourceFileID, hid_t destinationFileID, const std::string& path, const RepackOptions& options, bool& rawCopy)
+{
+  rawCopy = false;
+  hid_t sourceDatasetID = H5Dopen(sourceFileID, path.c_str(), H5P_DEFAULT);
+  if(sourceDatasetID < 0)
+  {
+    return -1;
+  }
+  hid_t typeID = H5Dget_type(sourceDatasetID);
+  if(typeID >= 0 && H5Tdetect_class(typeID, H5T_REFERENCE) > 0)
+  {
+    std::cout << "Warning: The references in dataset '" << path << "' are copied as they are and may not point at the right objects in the repacked file" << std::endl;
+  }
+  if(typeID >= 0)
+  {
+    H5Tclose(typeID);
+  }
+  bool changed = false;
+  std::vector<hsize_t> maxDims;
+  hid_t dcpl = createRepackCreationPropertyList(sourceDatasetID, options, changed, maxDims);
+  if(dcpl < 0)
+  {
+    H5Dclose(sourceDatasetID);
+    return -1;
+  }
+
+  herr_t error = 0;
+  if(!changed)
+  {
+    error = H5Ocopy(sourceFileID, path.c_str(), destinationFileID, path.c_str(), H5P_DEFAULT, H5P_DEFAULT);
+    rawCopy = error >= 0;
+  }
+  else
+  {
+    hid_t typeID = H5Dget_type(sourceDatasetID);
+    hid_t dataspaceID = H5Dget_space(sourceDatasetID);
+    std::vector<hsize_t> dims(maxDims.size());
+    H5Sget_simple_extent_dims(dataspaceID, dims.data(), nullptr);
+    H5Sset_extent_simple(dataspaceID, static_cast<int32_t>(dims.size()), dims.data(), maxDims.data());
+    hid_t destinationDatasetID = H5Dcreate(destinationFileID, path.c_str(), typeID, dataspaceID, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    if(destinationDatasetID < 0)
+    {
+      error = -1;
+    }
+    else
+    {
+      error = H5Lite::detail::copyDatasetElements(sourceDatasetID, destinationDatasetID, 0, options.bufferSize);
+      error = error < 0 ? error : copyAttributes(sourceDatasetID, destinationDatasetID);
+      H5Dclose(destinationDatasetID);
+    }
+    H5Sclose(dataspaceID);
+    H5Tclose(typeID);
+  }
+  H5Pclose(dcpl);
+  H5Dclose(sourceDatasetID);
+  if(error < 0)
+  {
+    std::cout << "Error repacking dataset '" << path << "'" << std::endl;
+  }
+  return error;
+}
+} // namespace detail
+
+/**
+ * @brief Copies everything that is reachable from the root group of a file into a new
+ * file. Space that was left behind by deleted or rewritten objects is not carried over
+ * and the data of each dataset ends up in one place, so the new file is usually smaller
+ * and faster to read. Hard links to the same object, soft links and external links are
+ * recreated. The destination file is overwritten if it exists.
+ *
+ * Every dataset is copied on its own, so object and region references stored in datasets
+ * or attributes are not updated. Objects usually end up at different addresses in the new
+ * file, so such references have to be rewritten by the caller. A warning is printed for
+ * datasets that hold references.
+ * @param sourceFile The file to repack
+ * @param destinationFile The repacked file
+ * @param options
+ * @param statistics Optional summary of the repack
+ * @return Standard HDF5 error condition
+ */
+inline herr_t repackFile(const std::string& sourceFile, const std::string& destinationFile, const RepackOptions& options, RepackStatistics* statistics = nullptr)
+{
+  RepackStatistics stats;
+  hid_t sourceFileID = openFile(sourceFile, true);
+  if(sourceFileID < 0)
+  {
+    return -1;
+  }
+  hid_t destinationFileID = createFile(destinationFile, options.fileOptions);
+  if(destinationFileID < 0)
+  {
+    closeFile(sourceFileID);
+    return -1;
+  }
+  H5Fget_filesize(sourceFileID, &stats.sourceSize);
+
+  struct LinkCopy
+  {
+    hid_t sourceFileID;
+    hid_t destinationFileID;
+    std::map<haddr_t, std::string> objects;
+    std::vector<std::string> datasets;
+    std::vector<std::pair<std::string, std::string>> hardLinks;
+    size_t numGroups;
+  } linkCopy{sourceFileID, destinationFileID, {}, {}, {}, 0};
+
+  // Groups, named datatypes and links are created in the order H5Lvisit reports them, which
+  // always lists a group before its members. Datasets are only collected here.
+  auto copyLink = [](hid_t rootID, const char* name, const H5L_info_t* info, void* data) -> herr_t {
+    auto* state = static_cast<LinkCopy*>(data);
+    herr_t error = 0;
+    if(info->type == H5L_TYPE_SOFT || info->type == H5L_TYPE_EXTERNAL)
+    {
+      std::vector<char> value(std::max<size_t>(info->u.val_size, 1));
+      error = H5Lget_val(rootID, name, value.data(), value.size(), H5P_DEFAULT);
+      if(error >= 0 && info->type == H5L_TYPE_SOFT)
+      {
+        error = H5Lcreate_soft(value.data(), state->destinationFileID, name, H5P_DEFAULT, H5P_DEFAULT);
+      }
+      else if(error >= 0)
+      {
+        const char* externalFile = nullptr;
+        const char* externalObject = nullptr;
+        error = H5Lunpack_elink_val(value.data(), value.size(), nullptr, &externalFile, &externalObject);
+        error = error < 0 ? error : H5Lcreate_external(externalFile, externalObject, state->destinationFileID, name, H5P_DEFAULT, H5P_DEFAULT);
+      }
+    }
+    else if(info->type == H5L_TYPE_HARD)
+    {
+      auto iter = state->objects.find(info->u.address);
+      if(iter != state->objects.end())
+      {
+        state->hardLinks.emplace_back(iter->second, name);
+        return 0;
+      }
+      state->objects.emplace(info->u.address, name);
+      H5O_info_t objectInfo{};
+      error = H5Oget_info_by_name(rootID, name, &objectInfo, H5P_DEFAULT);
+      if(error >= 0 && objectInfo.type == H5O_TYPE_GROUP)
+      {
+        hid_t sourceGroupID = H5Gopen(rootID, name, H5P_DEFAULT);
+        hid_t gcpl = H5Gget_create_plist(sourceGroupID);
+        hid_t destinationGroupID = H5Gcreate(state->destinationFileID, name, H5P_DEFAULT, gcpl, H5P_DEFAULT);
+        error = destinationGroupID < 0 ? -1 : detail::copyAttributes(sourceGroupID, destinationGroupID);
+        if(destinationGroupID >= 0)
+        {
+          H5Gclose(destinationGroupID);
+        }
+        H5Pclose(gcpl);
+        H5Gclose(sourceGroupID);
+        state->numGroups++;
+      }
+      else if(error >= 0 && objectInfo.type == H5O_TYPE_DATASET)
+      {
+        state->datasets.emplace_back(name);
+      }
+      else if(error >= 0)
+      {
+        error = H5Ocopy(rootID, name, state->destinationFileID, name, H5P_DEFAULT, H5P_DEFAULT);
+      }
+    }
+    if(error < 0)
+    {
+      std::cout << "Error repacking '" << name << "'" << std::endl;
+    }
+    return error;
+  };
+
+  herr_t error = detail::copyAttributes(sourceFileID, destinationFileID);
+  error = error < 0 ? error : H5Lvisit(sourceFileID, H5_INDEX_NAME, H5_ITER_INC, copyLink, &linkCopy);
+
+  // Datasets do not depend on each other so they can be copied concurrently. HDF5 serializes
+  // its API calls with one global lock, so threads mostly overlap filter work and file access.
+  std::vector<char> rawCopies(linkCopy.datasets.size(), 0);
+  hbool_t threadSafe = 0;
+  H5is_library_threadsafe(&threadSafe);
+  if(error >= 0 && options.numThreads > 1 && threadSafe != 0)
+  {
+    H5ThreadPool threadPool(std::min(options.numThreads, linkCopy.datasets.size()));
+    std::vector<std::future<herr_t>> results;
+    results.reserve(linkCopy.datasets.size());
+    for(size_t i = 0; i < linkCopy.datasets.size(); i++)
+    {
+      results.push_back(threadPool.submit([&, i]() {
+        bool rawCopy = false;
+        herr_t datasetError = detail::repackDataset(sourceFileID, destinationFileID, linkCopy.datasets[i], options, rawCopy);
+        rawCopies[i] = rawCopy ? 1 : 0;
+        return datasetError;
+      }));
+    }
+    for(auto& result : results)
+    {
+      error = std::min(error, result.get());
+    }
+  }
+  else
+  {
+    for(size_t i = 0; i < linkCopy.datasets.size() && error >= 0; i++)
+    {
+      bool rawCopy = false;
+      error = detail::repackDataset(sourceFileID, destinationFileID, linkCopy.datasets[i], options, rawCopy);
+      rawCopies[i] = rawCopy ? 1 : 0;
+    }
+  }
+
+  for(size_t i = 0; i < linkCopy.hardLinks.size() && error >= 0; i++)
+  {
+    error = H5Lcreate_hard(destinationFileID, linkCopy.hardLinks[i].first.c_str(), destinationFileID, linkCopy.hardLinks[i].second.c_str(), H5P_DEFAULT, H5P_DEFAULT);
+  }
+
+  closeFile(sourceFileID);
+  herr_t closeError = closeFile(destinationFileID);
+  if(error < 0 || closeError < 0)
+  {
+    std::cout << "Error repacking '" << sourceFile << "' into '" << destinationFile << "'" << std::endl;
+    return -1;
+  }
+
+  if(statistics != nullptr)
+  {
+    hid_t repackedFileID = openFile(destinationFile, true);
+    H5Fget_filesize(repackedFileID, &stats.destinationSize);
+    closeFile(repackedFileID);
+    stats.bytesReclaimed = stats.sourceSize > stats.destinationSize ? stats.sourceSize - stats.destinationSize : 0;
+    stats.numGroups = linkCopy.numGroups;
+    stats.numDatasets = linkCopy.datasets.size();
+    stats.numRawCopies = static_cast<size_t>(std::count(rawCopies.begin(), rawCopies.end(), 1));
+    *statistics = stats;
+  }
+  return 0;
+}
+
+/**
+ * @brief Outcome of visiting one file with scanFiles
+ */
+struct ScanResult
+{
+  size_t index = 0;  // Position of the file in the list given to scanFiles
+  std::string path;  // Path of the file
+  herr_t error = 0;  // Negative if the file could not be opened or the visitor failed
+  std::string value; // Whatever the visitor stored for the file
+};
+
+/**
+ * @brief Called once for every file that scanFiles opens. The file is opened read-only and is
+ * closed again after the visitor returns. The visitor stores its findings in value, which is
+ * what crosses the process boundary when scanFiles uses worker processes.
+ */
+using ScanVisitor = std::function<herr_t(hid_t fileID, const std::string& path, std::string& value)>;
+
+/**
+ * @brief Receives the result of each file on the calling thread, in the order the files finish
+ */
+using ScanResultHandler = std::function<void(const ScanResult&)>;
+
+namespace detail
+{
+/**
+ * @brief Opens a file with prepared file access property lists and runs the visitor on it
+ * @param path
+ * @param fileAccessPropertyList
+ * @param fallbackAccessPropertyList Used when the first open fails, for example because the file has no paged file space. May be negative.
+ * @param visitor
+ * @param value
+ * @return
+ */
+inline herr_t scanFile(const std::string& path, hid_t fileAccessPropertyList, hid_t fallbackAccessPropertyList, const ScanVisitor& visitor, std::string& value)
+{
+  HDF_ERROR_HANDLER_OFF
+  hid_t fileID = H5Fopen(path.c_str(), H5F_ACC_RDONLY, fileAccessPropertyList);
+  if(fileID < 0 && fallbackAccessPropertyList >= 0)
+  {
+    fileID = H5Fopen(path.c_str(), H5F_ACC_RDONLY, fallbackAccessPropertyList);
+  }
+  HDF_ERROR_HANDLER_ON
+  if(fileID < 0)
+  {
+    // The error stack belongs to the scanning thread and would otherwise be left behind when it exits
+    H5Eclear2(H5E_DEFAULT);
+    return -1;
+  }
+  herr_t error = visitor(fileID, path, value);
+  herr_t closeError = closeFile(fileID);
+  if(error < 0 || closeError < 0)
+  {
+    H5Eclear2(H5E_DEFAULT);
+  }
+  return error < 0 ? error : std::min<herr_t>(closeError, 0);
+}
+
+#if !defined(_WIN32)
+/**
+ * @brief Writes or reads exactly size bytes on a pipe
+ * @return False if the pipe was closed or failed first
+ */
+inline bool transferPipe(int fd, void* data, size_t size, bool write)
+{
+  auto* bytes = static_cast<uint8_t*>(data);
+  while(size > 0)
+  {
+    ssize_t count = write ? ::write(fd, bytes, size) : ::read(fd, bytes, size);
+    if(count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if(count <= 0)
+    {
+      return false;
+    }
+    bytes += count;
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+}
+
+/**
+ * @brief Visits files in forked worker processes. The workers take the next file from a counter
+ * in shared memory and send each result back on their own pipe as soon as it is done.
+ */
+inline herr_t scanFilesInProcesses(const std::vector<std::string>& paths, const ScanVisitor& visitor, const ScanResultHandler& onResult, size_t numWorkers, hid_t fileAccessPropertyList,
+                                   hid_t fallbackAccessPropertyList, std::vector<herr_t>& fileErrors)
+{
+  void* shared = mmap(nullptr, sizeof(std::atomic<uint64_t>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(shared == MAP_FAILED)
+  {
+    return -1;
+  }
+  auto* nextIndex = new(shared) std::atomic<uint64_t>(0);
+
+  // Anything still buffered would otherwise be written again by every worker
+  std::cout.flush();
+  std::fflush(nullptr);
+  std::vector<pid_t> workers;
+  std::vector<pollfd> pipes;
+  for(size_t i = 0; i < numWorkers; i++)
+  {
+    std::array<int, 2> fds = {-1, -1};
+    pid_t pid = pipe(fds.data()) == 0 ? fork() : -1;
+    if(pid == 0)
+    {
+      close(fds[0]);
+      for(const auto& other : pipes)
+      {
+        close(other.fd);
+      }
+      for(uint64_t index = nextIndex->fetch_add(1); index < paths.size(); index = nextIndex->fetch_add(1))
+      {
+        std::string value;
+        int32_t error = scanFile(paths[index], fileAccessPropertyList, fallbackAccessPropertyList, visitor, value);
+        uint64_t size = value.size();
+        if(!transferPipe(fds[1], &index, sizeof(index), true) || !transferPipe(fds[1], &error, sizeof(error), true) || !transferPipe(fds[1], &size, sizeof(size), true) ||
+           !transferPipe(fds[1], &value[0], value.size(), true))
+        {
+          _exit(1);
+        }
+      }
+      close(fds[1]);
+      _exit(0);
+    }
+    if(pid < 0)
+    {
+      if(fds[0] >= 0)
+      {
+        close(fds[0]);
+        close(fds[1]);
+      }
+      break;
+    }
+    close(fds[1]);
+    workers.push_back(pid);
+    pipes.push_back({fds[0], POLLIN, 0});
+  }
+
+  herr_t error = workers.empty() ? -1 : 0;
+  while(!pipes.empty())
+  {
+    if(poll(pipes.data(), pipes.size(), -1) < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      error = -1;
+      break;
+    }
+    for(size_t i = pipes.size(); i-- > 0;)
+    {
+      if(pipes[i].revents == 0)
+      {
+        continue;
+      }
+      ScanResult result;
+      uint64_t index = 0;
+      int32_t fileError = 0;
+      uint64_t size = 0;
+      bool received = transferPipe(pipes[i].fd, &index, sizeof(index), false) && transferPipe(pipes[i].fd, &fileError, sizeof(fileError), false) &&
+                      transferPipe(pipes[i].fd, &size, sizeof(size), false) && index < paths.size();
+      if(received)
+      {
+        result.value.resize(size);
+        received = transferPipe(pipes[i].fd, &result.value[0], size, false);
+      }
+      if(!received)
+      {
+        close(pipes[i].fd);
+        pipes.erase(pipes.begin() + i);
+        continue;
+      }
+      result.index = index;
+      result.path = paths[index];
+      result.error = fileError;
+      fileErrors[index] = result.error;
+      onResult(result);
+    }
+  }
+  for(const auto& remaining : pipes)
+  {
+    close(remaining.fd);
+  }
+  for(pid_t pid : workers)
+  {
+    int status = 0;
+    waitpid(pid, &status, 0);
+  }
+  munmap(shared, sizeof(std::atomic<uint64_t>));
+  return error;
+}
+#endif
+} // namespace detail
+
+/**
+ * @brief Opens every file in a list read-only, runs a visitor on it and hands the results to
+ * a handler on the calling thread in the order the files finish. Opening many small files is
+ * bound by latency, so the files are spread over threads if the HDF5 library is thread-safe and
+ * over forked worker processes otherwise. On Windows a library that is not thread-safe visits
+ * the files one at a time. The file access property list is created once from the options and
+ * used for every file.
+ * @param paths The files to visit
+ * @param visitor Called with each open file. With worker processes it runs in a different process,
+ * so only the value it stores reaches the caller.
+ * @param onResult Receives one result per file
+ * @param concurrency Number of threads or processes. Zero uses the number of hardware threads.
+ * @param options Options used to open every file
+ * @return Negative if any file could not be visited
+ */
+inline herr_t scanFiles(const std::vector<std::string>& paths, const ScanVisitor& visitor, const ScanResultHandler& onResult, size_t concurrency = 0, const FileOptions& options = FileOptions())
+{
+  hid_t fileAccessPropertyList = createFileAccessPropertyList(options);
+  if(fileAccessPropertyList < 0)
+  {
+    return -1;
+  }
+  hid_t fallbackAccessPropertyList = -1;
+#if H5_VERSION_GE(1, 10, 1)
+  if(options.pageBufferSize > 0)
+  {
+    /* HDF5 refuses a page buffer for files without paged file space so keep a list without one */
+    fallbackAccessPropertyList = H5Pcopy(fileAccessPropertyList);
+    H5Pset_page_buffer_size(fallbackAccessPropertyList, 0, 0, 0);
+  }
+#endif
+
+  if(concurrency == 0)
+  {
+    concurrency = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  concurrency = std::min(concurrency, paths.size());
+  hbool_t threadSafe = 0;
+  H5is_library_threadsafe(&threadSafe);
+
+  // Files that have not reported back yet are marked with 1
+  std::vector<herr_t> fileErrors(paths.size(), 1);
+  herr_t error = 0;
+  if(concurrency > 1 && threadSafe != 0)
+  {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<ScanResult> finished;
+    std::atomic<size_t> nextIndex(0);
+    H5ThreadPool threadPool(concurrency);
+    for(size_t i = 0; i < concurrency; i++)
+    {
+      threadPool.submit([&]() {
+        for(size_t index = nextIndex++; index < paths.size(); index = nextIndex++)
+        {
+          ScanResult result;
+          result.index = index;
+          result.path = paths[index];
+          result.error = detail::scanFile(paths[index], fileAccessPropertyList, fallbackAccessPropertyList, visitor, result.value);
+          std::lock_guard<std::mutex> lock(mutex);
+          finished.push_back(std::move(result));
+          condition.notify_one();
+        }
+      });
+    }
+    for(size_t count = 0; count < paths.size(); count++)
+    {
+      ScanResult result;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&finished]() { return !finished.empty(); });
+        result = std::move(finished.front());
+        finished.pop_front();
+      }
+      fileErrors[result.index] = result.error;
+      onResult(result);
+    }
+  }
+#if !defined(_WIN32)
+  else if(concurrency > 1)
+  {
+    error = detail::scanFilesInProcesses(paths, visitor, onResult, concurrency, fileAccessPropertyList, fallbackAccessPropertyList, fileErrors);
+  }
+#endif
+  else
+  {
+    for(size_t index = 0; index < paths.size(); index++)
+    {
+      ScanResult result;
+      result.index = index;
+      result.path = paths[index];
+      result.error = detail::scanFile(paths[index], fileAccessPropertyList, fallbackAccessPropertyList, visitor, result.value);
+      fileErrors[index] = result.error;
+      onResult(result);
+    }
+  }
+
+  // Files whose worker process died before reporting back still get a result
+  for(size_t index = 0; index < paths.size(); index++)
+  {
+    if(fileErrors[index] > 0)
+    {
+      ScanResult result;
+      result.index = index;
+      result.path = paths[index];
+      result.error = -1;
+      fileErrors[index] = -1;
+      onResult(result);
+    }
+    error = std::min(error, fileErrors[index]);
+  }
+
+  H5Pclose(fileAccessPropertyList);
+  if(fallbackAccessPropertyList >= 0)
+  {
+    H5Pclose(fallbackAccessPropertyList);
+  }
+  return error;
+}
+
 }; // namespace H5Utilities
 
 ENABLE_BITMASK_OPERATORS(H5Utilities::CustomHDFDataTypes)
@@ -47,6 +47,7 @@
 
 #include <QtCore/QDebug>
 #include <QtCore/QFileInfo>
+#include <QtCore/QIODevice>
 #include <QtCore/QList>
 #include <QtCore/QString>
 #include <QtCore/QVector>
@@ -70,6 +71,44 @@ inline hid_t openFile(const QString& filename, bool readOnly = false)
   return H5Utilities::openFile(filename.toStdString(), readOnly);
 }
 
+/**
+ * @brief Opens a H5 file at path filename using the given options. Can be made read only access. Returns the id of the file object.
+ * @param filename
+ * @param readOnly
+ * @param options
+ * @return
+ */
+inline hid_t openFile(const QString& filename, bool readOnly, const H5Utilities::FileOptions& options)
+{
+  return H5Utilities::openFile(filename.toStdString(), readOnly, options);
+}
+
+/**
+ * @brief Opens a H5 file read only from an open, random access QIODevice such as a Qt
+ * resource, a QBuffer or a file inside an archive without extracting it to disk. The
+ * device must stay open until the file is closed.
+ * @param device
+ * @param name The name HDF5 reports for the file
+ * @return
+ */
+inline hid_t openFile(QIODevice* device, const QString& name = QString())
+{
+  if(device == nullptr || !device->isOpen() || device->isSequential())
+  {
+    qDebug() << "QH5Utilities::openFile: The device must be open and support random access";
+    return -1;
+  }
+  H5Utilities::FileOptions options;
+  options.driver = H5Utilities::FileDriver::Callback;
+  options.callback = H5CallbackDriver::createDeviceConfig(device);
+  QString fileName = name;
+  if(fileName.isEmpty())
+  {
+    fileName = device->objectName().isEmpty() ? QString("QIODevice") : device->objectName();
+  }
+  return H5Utilities::openFile(fileName.toStdString(), true, options);
+}
+
 /**
  * @brief Creates a H5 file at path filename. Returns the id of the file object.
  * @param filename
@@ -80,6 +119,17 @@ inline hid_t createFile(const QString& filename)
   return H5Utilities::createFile(filename.toStdString());
 }
 
+/**
+ * @brief Creates a H5 file at path filename using the given options. Returns the id of the file object.
+ * @param filename
+ * @param options
+ * @return
+ */
+inline hid_t createFile(const QString& filename, const H5Utilities::FileOptions& options)
+{
+  return H5Utilities::createFile(filename.toStdString(), options);
+}
+
 /**
  * @brief Closes a H5 file object. Returns the H5 error code.
  * @param fileID
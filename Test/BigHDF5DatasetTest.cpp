@@ -41,6 +41,8 @@
 #include "H5Support/H5Lite.h"
 #include "H5Support/H5Utilities.h"
 
+using namespace H5Support;
+
 int main(int argc, char* argv[])
 {
   std::string filePath("/tmp/BIG_HDF5_DATASET.h5");
@@ -63,8 +65,14 @@ int main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
+  // Write in slabs so HDF5 never needs temporary buffers for the whole dataset
+  H5Lite::TransferOptions transfer;
+  transfer.splitThreshold = 1024ull * 1024ull * 1024ull;
+  transfer.slabSize = 256ull * 1024ull * 1024ull;
+  transfer.progress = [](uint64_t bytesDone, uint64_t bytesTotal) { std::cout << "  " << (100 * bytesDone / bytesTotal) << "%" << std::endl; };
+
   std::array<hsize_t, 1> dims{size};
-  herr_t error = H5Lite::writePointerDataset(groupId, "TEST", static_cast<int32_t>(dims.size()), dims.data(), data.data());
+  herr_t error = H5Lite::writePointerDataset(groupId, "TEST", static_cast<int32_t>(dims.size()), dims.data(), data.data(), H5Lite::DatasetCreationOptions(), transfer);
   if(error < 0)
   {
     return EXIT_FAILURE;
@@ -0,0 +1,153 @@
+/* ============================================================================
+ * Copyright (c) 2009-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-07-D-5800
+ *    United States Air Force Prime Contract FA8650-10-D-5210
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *    United States Prime Contract Navy N00173-07-C-2068
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <string>
+
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5Utilities.h"
+
+using namespace H5Support;
+
+namespace
+{
+/**
+ * @brief Writes numGroups groups holding datasetsPerGroup scalar datasets each
+ */
+bool writeFile(const std::string& filePath, int32_t numGroups, int32_t datasetsPerGroup, const H5Utilities::FileOptions& options)
+{
+  hid_t fileID = H5Utilities::createFile(filePath, options);
+  if(fileID < 0)
+  {
+    return false;
+  }
+  for(int32_t i = 0; i < numGroups; i++)
+  {
+    hid_t groupID = H5Utilities::createGroup(fileID, "Group_" + std::to_string(i));
+    for(int32_t j = 0; j < datasetsPerGroup; j++)
+    {
+      H5Lite::writeScalarDataset(groupID, "Dataset_" + std::to_string(j), j);
+    }
+    H5Gclose(groupID);
+  }
+  return H5Utilities::closeFile(fileID) >= 0;
+}
+
+/**
+ * @brief Opens the file and lists every object in every group
+ * @return The number of objects found or -1 on error
+ */
+int64_t openAndTraverse(const std::string& filePath)
+{
+  hid_t fileID = H5Utilities::openFile(filePath, true);
+  if(fileID < 0)
+  {
+    return -1;
+  }
+  int64_t count = 0;
+  std::list<std::string> groupNames;
+  H5Utilities::getGroupObjects(fileID, H5Utilities::CustomHDFDataTypes::Group, groupNames);
+  for(const auto& groupName : groupNames)
+  {
+    hid_t groupID = H5Gopen(fileID, groupName.c_str(), H5P_DEFAULT);
+    std::list<std::string> names;
+    H5Utilities::getGroupObjects(groupID, H5Utilities::CustomHDFDataTypes::Any, names);
+    count += static_cast<int64_t>(names.size()) + 1;
+    H5Gclose(groupID);
+  }
+  H5Utilities::closeFile(fileID);
+  return count;
+}
+
+double timeOpenAndTraverse(const std::string& filePath, int32_t iterations, int64_t& count)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int32_t i = 0; i < iterations; i++)
+  {
+    count = openAndTraverse(filePath);
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+} // namespace
+
+/**
+ * @brief Compares opening and walking a metadata heavy file with and without a
+ * metadata cache image. Every iteration opens the file again so the HDF5 metadata
+ * cache starts out empty each time.
+ *
+ * Usage: H5CacheImageBenchmark [directory] [numGroups] [datasetsPerGroup] [iterations]
+ */
+int main(int argc, char* argv[])
+{
+  std::string directory = argc > 1 ? argv[1] : "/tmp";
+  int32_t numGroups = argc > 2 ? std::stoi(argv[2]) : 500;
+  int32_t datasetsPerGroup = argc > 3 ? std::stoi(argv[3]) : 100;
+  int32_t iterations = argc > 4 ? std::stoi(argv[4]) : 5;
+
+  std::string plainFile = directory + "/H5CacheImageBenchmark_Plain.h5";
+  std::string imageFile = directory + "/H5CacheImageBenchmark_Image.h5";
+
+  std::cout << "Writing " << numGroups << " groups with " << datasetsPerGroup << " datasets each" << std::endl;
+  H5Utilities::FileOptions imageOptions;
+  imageOptions.generateCacheImage = true;
+  if(!writeFile(plainFile, numGroups, datasetsPerGroup, H5Utilities::FileOptions()) || !writeFile(imageFile, numGroups, datasetsPerGroup, imageOptions))
+  {
+    std::cout << "Error writing the benchmark files" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int64_t plainCount = 0;
+  int64_t imageCount = 0;
+  double plainTime = timeOpenAndTraverse(plainFile, iterations, plainCount);
+  double imageTime = timeOpenAndTraverse(imageFile, iterations, imageCount);
+  if(plainCount < 0 || plainCount != imageCount)
+  {
+    std::cout << "Error traversing the benchmark files" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Objects traversed:           " << plainCount << std::endl;
+  std::cout << "Open + traverse, no image:   " << plainTime << " ms" << std::endl;
+  std::cout << "Open + traverse, with image: " << imageTime << " ms" << std::endl;
+
+  std::remove(plainFile.c_str());
+  std::remove(imageFile.c_str());
+  return EXIT_SUCCESS;
+}
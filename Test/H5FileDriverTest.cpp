@@ -0,0 +1,338 @@
+/* ============================================================================
+ * Copyright (c) 2007-2019 BlueQuartz Software, LLC
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * Neither the name of BlueQuartz Software, the US Air Force, nor the names of its
+ * contributors may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The code contained herein was partially funded by the following contracts:
+ *    United States Air Force Prime Contract FA8650-04-C-5229
+ *    United States Air Force Prime Contract FA8650-15-D-5231
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "H5Support/H5CallbackDriver.h"
+#include "H5Support/H5Lite.h"
+#include "H5Support/H5PageCacheDriver.h"
+#include "H5Support/H5ThreadedIODriver.h"
+#include "H5Support/H5Utilities.h"
+
+#include "H5SupportTestFileLocations.h"
+
+#include "UnitTestSupport.h"
+
+using namespace H5Support;
+
+class H5FileDriverTest
+{
+public:
+  H5FileDriverTest() = default;
+  ~H5FileDriverTest() = default;
+
+  H5FileDriverTest(const H5FileDriverTest&) = delete;            // Copy Constructor Not Implemented
+  H5FileDriverTest(H5FileDriverTest&&) = delete;                 // Move Constructor Not Implemented
+  H5FileDriverTest& operator=(const H5FileDriverTest&) = delete; // Copy Assignment Not Implemented
+  H5FileDriverTest& operator=(H5FileDriverTest&&) = delete;      // Move Assignment Not Implemented
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void RemoveTestFiles()
+  {
+#if REMOVE_TEST_FILES
+    std::remove(UnitTest::H5FileDriverTest::ThreadedIOFile.c_str());
+    std::remove(UnitTest::H5FileDriverTest::PageCacheFile.c_str());
+    std::remove(UnitTest::H5FileDriverTest::CallbackFile.c_str());
+#endif
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestThreadedIODriver()
+  {
+    H5Utilities::FileOptions options;
+    options.driver = H5Utilities::FileDriver::ThreadedIO;
+    options.threadedIO.splitThreshold = 64 * 1024;
+    options.threadedIO.numThreads = 4;
+
+    constexpr size_t numElements = 1024 * 1024 + 17;
+    std::vector<int32_t> data(numElements);
+    for(size_t i = 0; i < numElements; i++)
+    {
+      data[i] = static_cast<int32_t>(i * 3);
+    }
+
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5FileDriverTest::ThreadedIOFile, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    if(H5ThreadedIODriver::isAvailable())
+    {
+      hid_t fileAccessPropertyList = H5Fget_access_plist(fileID);
+      H5SUPPORT_REQUIRE(H5Pget_driver(fileAccessPropertyList) == H5ThreadedIODriver::driverID());
+      H5Pclose(fileAccessPropertyList);
+    }
+    std::vector<hsize_t> dims = {numElements};
+    herr_t error = H5Lite::writeVectorDataset(fileID, "Data", dims, data);
+    H5SUPPORT_REQUIRE(error >= 0);
+    error = H5Utilities::closeFile(fileID);
+    H5SUPPORT_REQUIRE(error >= 0);
+
+    // Read back through the driver
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::ThreadedIOFile, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> readData;
+    error = H5Lite::readVectorDataset(fileID, "Data", readData);
+    H5SUPPORT_REQUIRE(error >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    error = H5Utilities::closeFile(fileID);
+    H5SUPPORT_REQUIRE(error >= 0);
+
+    // The file must be readable with the default driver as well
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::ThreadedIOFile, true);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    readData.clear();
+    error = H5Lite::readVectorDataset(fileID, "Data", readData);
+    H5SUPPORT_REQUIRE(error >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    error = H5Utilities::closeFile(fileID);
+    H5SUPPORT_REQUIRE(error >= 0);
+
+    // Modify the file in place through the driver
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::ThreadedIOFile, false, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    error = H5Lite::writeVectorDataset(fileID, "Data2", dims, data);
+    H5SUPPORT_REQUIRE(error >= 0);
+    error = H5Utilities::closeFile(fileID);
+    H5SUPPORT_REQUIRE(error >= 0);
+
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::ThreadedIOFile, true);
+    readData.clear();
+    error = H5Lite::readVectorDataset(fileID, "Data2", readData);
+    H5SUPPORT_REQUIRE(error >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    error = H5Utilities::closeFile(fileID);
+    H5SUPPORT_REQUIRE(error >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestPageCacheDriver()
+  {
+    constexpr int32_t numGroups = 200;
+    {
+      hid_t fileID = H5Utilities::createFile(UnitTest::H5FileDriverTest::PageCacheFile);
+      H5SUPPORT_REQUIRE(fileID > 0);
+      for(int32_t i = 0; i < numGroups; i++)
+      {
+        std::string groupName = "Group_" + std::to_string(i);
+        hid_t groupID = H5Utilities::createGroup(fileID, groupName);
+        H5SUPPORT_REQUIRE(groupID > 0);
+        H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(groupID, "Value", i) >= 0);
+        H5SUPPORT_REQUIRE(H5Lite::writeScalarAttribute(groupID, "Value", "Index", i) >= 0);
+        H5Gclose(groupID);
+      }
+      H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    }
+
+    H5Utilities::FileOptions options;
+    options.driver = H5Utilities::FileDriver::PageCache;
+    options.pageCache.pageSize = 4096;
+    options.pageCache.capacity = 8;
+    options.pageCache.readAheadPages = 2;
+
+    hid_t fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::PageCacheFile, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::list<std::string> names;
+    H5SUPPORT_REQUIRE(H5Utilities::getGroupObjects(fileID, H5Utilities::CustomHDFDataTypes::Group, names) >= 0);
+    H5SUPPORT_REQUIRE(names.size() == numGroups);
+    for(int32_t i = 0; i < numGroups; i++)
+    {
+      std::string groupName = "Group_" + std::to_string(i);
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, groupName + "/Value", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+      value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarAttribute(fileID, groupName + "/Value", "Index", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+    }
+
+    std::shared_ptr<const H5PageCacheDriver::Statistics> statistics = H5PageCacheDriver::getStatistics(fileID);
+    H5SUPPORT_REQUIRE(statistics != nullptr);
+    H5SUPPORT_REQUIRE(statistics->hits > 0);
+    H5SUPPORT_REQUIRE(statistics->misses > 0);
+    H5SUPPORT_REQUIRE(statistics->evictions > 0);
+    // Every backing read serves at least one page so the cache must save round trips
+    H5SUPPORT_REQUIRE(statistics->backingReads < statistics->hits + statistics->misses);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Write through the cache with the threaded driver as the backing store
+    hid_t backingFileAccessPropertyList = H5Pcreate(H5P_FILE_ACCESS);
+    H5ThreadedIODriver::Config threadedConfig;
+    threadedConfig.splitThreshold = 16 * 1024;
+    H5SUPPORT_REQUIRE(H5ThreadedIODriver::setFileAccessProperties(backingFileAccessPropertyList, threadedConfig) >= 0);
+    options.pageCache.backingFileAccessPropertyList = backingFileAccessPropertyList;
+    options.pageCache.statistics = std::make_shared<H5PageCacheDriver::Statistics>();
+
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::PageCacheFile, false, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<float> data(100000);
+    for(size_t i = 0; i < data.size(); i++)
+    {
+      data[i] = static_cast<float>(i) * 0.5f;
+    }
+    std::vector<hsize_t> dims = {data.size()};
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Group_0/Data", dims, data) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Group_1/Extra", 42) >= 0);
+    std::vector<float> readData;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Group_0/Data", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    H5SUPPORT_REQUIRE(H5PageCacheDriver::getStatistics(fileID) == options.pageCache.statistics);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    H5Pclose(backingFileAccessPropertyList);
+
+    fileID = H5Utilities::openFile(UnitTest::H5FileDriverTest::PageCacheFile, true);
+    readData.clear();
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Group_0/Data", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    int32_t value = 0;
+    H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Group_1/Extra", value) >= 0);
+    H5SUPPORT_REQUIRE(value == 42);
+    H5SUPPORT_REQUIRE(H5PageCacheDriver::getStatistics(fileID) == nullptr);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Exact counters for reads that span several pages
+    std::ifstream stream(UnitTest::H5FileDriverTest::PageCacheFile, std::ios::binary);
+    std::vector<unsigned char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    H5SUPPORT_REQUIRE(contents.size() >= 8 * 4096);
+    H5FD_t* backing = H5FDopen(UnitTest::H5FileDriverTest::PageCacheFile.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT, HADDR_UNDEF);
+    H5SUPPORT_REQUIRE(backing != nullptr);
+    H5SUPPORT_REQUIRE(H5FDset_eoa(backing, H5FD_MEM_DEFAULT, contents.size()) >= 0);
+    H5PageCacheDriver::Config config;
+    config.pageSize = 4096;
+    config.capacity = 16;
+    config.readAheadPages = 2;
+    config.statistics = std::make_shared<H5PageCacheDriver::Statistics>();
+    {
+      H5PageCacheDriver::detail::PageCache cache(backing, config);
+      const H5PageCacheDriver::Statistics& counters = *config.statistics;
+      std::vector<unsigned char> buffer(4 * 4096);
+      auto readPages = [&](haddr_t addr, size_t size) {
+        H5SUPPORT_REQUIRE(cache.read(H5FD_MEM_DRAW, H5P_DEFAULT, addr, size, buffer.data()) >= 0);
+        H5SUPPORT_REQUIRE(std::equal(buffer.begin(), buffer.begin() + size, contents.begin() + addr));
+      };
+      // A cold read over pages 0 to 3 is four misses loaded with one backing read
+      readPages(100, 3 * 4096);
+      H5SUPPORT_REQUIRE(counters.misses == 4 && counters.hits == 0 && counters.backingReads == 1);
+      readPages(100, 3 * 4096);
+      H5SUPPORT_REQUIRE(counters.misses == 4 && counters.hits == 4 && counters.backingReads == 1);
+      // Pages 2 and 3 are cached, 4 and 5 are missing and continue the sequence, so 6 and 7 are read ahead
+      readPages(2 * 4096, 4 * 4096);
+      H5SUPPORT_REQUIRE(counters.misses == 6 && counters.hits == 6 && counters.readAheadPages == 2 && counters.backingReads == 2);
+      readPages(6 * 4096, 2 * 4096);
+      H5SUPPORT_REQUIRE(counters.misses == 6 && counters.hits == 8 && counters.backingReads == 2);
+    }
+    H5SUPPORT_REQUIRE(H5FDclose(backing) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestCallbackDriver()
+  {
+    std::vector<int32_t> data(50000);
+    for(size_t i = 0; i < data.size(); i++)
+    {
+      data[i] = static_cast<int32_t>(i * 3);
+    }
+    {
+      hid_t fileID = H5Utilities::createFile(UnitTest::H5FileDriverTest::CallbackFile);
+      H5SUPPORT_REQUIRE(fileID > 0);
+      std::vector<hsize_t> dims = {data.size()};
+      H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Data", dims, data) >= 0);
+      H5SUPPORT_REQUIRE(H5Lite::writeStringAttribute(fileID, "Data", "Name", "Callback") >= 0);
+      H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    }
+
+    // Hold the whole file in memory and read it from there
+    std::ifstream input(UnitTest::H5FileDriverTest::CallbackFile, std::ios::binary);
+    H5SUPPORT_REQUIRE(input.is_open());
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    input.close();
+    auto stream = std::make_shared<std::istringstream>(contents.str());
+
+    hid_t fileID = H5Utilities::openFile("InMemory.h5", stream);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> readData;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Data", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    std::string name;
+    H5SUPPORT_REQUIRE(H5Lite::readStringAttribute(fileID, "Data", "Name", name) >= 0);
+    H5SUPPORT_REQUIRE(name == "Callback");
+
+    // The same stream can back a second open file
+    hid_t secondFileID = H5Utilities::openFile("InMemoryCopy.h5", stream);
+    H5SUPPORT_REQUIRE(secondFileID > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(secondFileID) >= 0);
+
+    // Writing is not supported
+    HDF_ERROR_HANDLER_OFF
+    herr_t error = H5Lite::writeScalarDataset(fileID, "Extra", 1);
+    HDF_ERROR_HANDLER_ON
+    H5SUPPORT_REQUIRE(error < 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    H5Utilities::FileOptions options;
+    options.driver = H5Utilities::FileDriver::Callback;
+    options.callback = H5CallbackDriver::createStreamConfig(stream);
+    H5SUPPORT_REQUIRE(H5Utilities::openFile("InMemory.h5", false, options) < 0);
+
+    // A source that fails to deliver its bytes makes the open fail
+    options.callback.read = [](uint64_t /*offset*/, size_t /*size*/, void* /*buffer*/) -> herr_t { return -1; };
+    H5SUPPORT_REQUIRE(H5Utilities::openFile("InMemory.h5", true, options) < 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void operator()()
+  {
+    H5SUPPORT_REGISTER_TEST(TestThreadedIODriver())
+    H5SUPPORT_REGISTER_TEST(TestPageCacheDriver())
+    H5SUPPORT_REGISTER_TEST(TestCallbackDriver())
+    H5SUPPORT_REGISTER_TEST(RemoveTestFiles())
+  }
+};
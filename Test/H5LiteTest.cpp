@@ -32,12 +32,26 @@
  *
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdio>
+#include <future>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "H5Support/H5AsyncWriter.h"
+#include "H5Support/H5LazyDataset.h"
+#include "H5Support/H5MemoryBudget.h"
 #include "H5Support/H5Lite.h"
+#include "H5Support/H5Pipeline.h"
+#include "H5Support/H5PrefetchReader.h"
+#include "H5Support/H5ReadBatch.h"
 #include "H5Support/H5Utilities.h"
 
 #include "H5SupportTestHelper.h"
@@ -101,6 +115,18 @@ public:
     std::remove(UnitTest::H5LiteTest::FileName.c_str());
     std::remove(UnitTest::H5LiteTest::LargeFile.c_str());
     std::remove(UnitTest::H5LiteTest::VLengthFile.c_str());
+    std::remove(UnitTest::H5LiteTest::CreationOptionsFile.c_str());
+    std::remove(UnitTest::H5LiteTest::RawCopySourceFile.c_str());
+    std::remove(UnitTest::H5LiteTest::RawCopyFile.c_str());
+    std::remove(UnitTest::H5LiteTest::MultiDatasetFile.c_str());
+    std::remove(UnitTest::H5LiteTest::PointsFile.c_str());
+    std::remove(UnitTest::H5LiteTest::ReadBatchFile.c_str());
+    std::remove(UnitTest::H5LiteTest::AsyncWriterFile.c_str());
+    std::remove(UnitTest::H5LiteTest::PrefetchFile.c_str());
+    std::remove(UnitTest::H5LiteTest::PipelineFile.c_str());
+    std::remove(UnitTest::H5LiteTest::LazyDatasetFile.c_str());
+    std::remove(UnitTest::H5LiteTest::MemoryBudgetFile.c_str());
+    std::remove(UnitTest::H5LiteTest::SplitTransferFile.c_str());
 #endif
   }
 
@@ -983,6 +1009,931 @@ public:
     }
   }
 
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void checkCreationProperties(hid_t fileID, const std::string& datasetName, H5D_alloc_time_t allocTime, H5D_fill_time_t fillTime)
+  {
+    hid_t datasetID = H5Dopen(fileID, datasetName.c_str(), H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(datasetID > 0);
+    hid_t propertyListID = H5Dget_create_plist(datasetID);
+    H5D_alloc_time_t datasetAllocTime = H5D_ALLOC_TIME_ERROR;
+    H5D_fill_time_t datasetFillTime = H5D_FILL_TIME_ERROR;
+    H5SUPPORT_REQUIRE(H5Pget_alloc_time(propertyListID, &datasetAllocTime) >= 0);
+    H5SUPPORT_REQUIRE(H5Pget_fill_time(propertyListID, &datasetFillTime) >= 0);
+    H5SUPPORT_REQUIRE(datasetAllocTime == allocTime);
+    H5SUPPORT_REQUIRE(datasetFillTime == fillTime);
+    H5Pclose(propertyListID);
+    H5Dclose(datasetID);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestDatasetCreationOptions()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::CreationOptionsFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+
+    std::vector<float> data(10000);
+    std::iota(data.begin(), data.end(), 0.0f);
+    std::vector<hsize_t> dims = {100, 100};
+
+    // Fully written datasets skip the fill pass by default
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Default", dims, data) >= 0);
+    checkCreationProperties(fileID, "Default", H5D_ALLOC_TIME_LATE, H5D_FILL_TIME_NEVER);
+
+    H5Lite::DatasetCreationOptions options;
+    options.allocationTime = H5Lite::AllocationTime::Early;
+    options.fillWrite = H5Lite::FillWrite::Allocation;
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "EarlyFilled", dims, data, options) >= 0);
+    checkCreationProperties(fileID, "EarlyFilled", H5D_ALLOC_TIME_EARLY, H5D_FILL_TIME_ALLOC);
+
+    options.fillWrite = H5Lite::FillWrite::Default;
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "EarlyIfSet", dims, data, options) >= 0);
+    checkCreationProperties(fileID, "EarlyIfSet", H5D_ALLOC_TIME_EARLY, H5D_FILL_TIME_IFSET);
+
+#ifdef H5_HAVE_FILTER_DEFLATE
+    options.allocationTime = H5Lite::AllocationTime::Incremental;
+    std::vector<hsize_t> chunkDims = {10, 100};
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Compressed", dims, data, chunkDims, 5) >= 0);
+    checkCreationProperties(fileID, "Compressed", H5D_ALLOC_TIME_INCR, H5D_FILL_TIME_NEVER);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "CompressedIncremental", dims, data, chunkDims, 5, options) >= 0);
+    checkCreationProperties(fileID, "CompressedIncremental", H5D_ALLOC_TIME_INCR, H5D_FILL_TIME_IFSET);
+#endif
+
+    for(const auto& datasetName : {"Default", "EarlyFilled", "EarlyIfSet"})
+    {
+      std::vector<float> readData;
+      H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, datasetName, readData) >= 0);
+      H5SUPPORT_REQUIRE(readData == data);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  H5D_layout_t getDatasetLayout(hid_t fileID, const std::string& datasetName)
+  {
+    hid_t datasetID = H5Dopen(fileID, datasetName.c_str(), H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(datasetID > 0);
+    hid_t propertyListID = H5Dget_create_plist(datasetID);
+    H5D_layout_t layout = H5Pget_layout(propertyListID);
+    H5Pclose(propertyListID);
+    H5Dclose(datasetID);
+    return layout;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestCompactLayout()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::CreationOptionsFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Scalar", 3.5) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Scalar") == H5D_COMPACT);
+
+    std::vector<int32_t> smallData(1000);
+    std::iota(smallData.begin(), smallData.end(), 0);
+    std::vector<hsize_t> smallDims = {smallData.size()};
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Small", smallDims, smallData) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Small") == H5D_COMPACT);
+
+    std::vector<int32_t> largeData(100000);
+    std::iota(largeData.begin(), largeData.end(), 0);
+    std::vector<hsize_t> largeDims = {largeData.size()};
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Large", largeDims, largeData) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Large") == H5D_CONTIGUOUS);
+
+    // Overrides
+    H5Lite::DatasetCreationOptions options;
+    options.layout = H5Lite::DatasetLayout::Contiguous;
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "ContiguousScalar", 7, options) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "ContiguousScalar") == H5D_CONTIGUOUS);
+
+    options.layout = H5Lite::DatasetLayout::Automatic;
+    options.compactThreshold = 1024;
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "SmallThreshold", smallDims, smallData, options) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "SmallThreshold") == H5D_CONTIGUOUS);
+
+    options.allocationTime = H5Lite::AllocationTime::Late;
+    options.compactThreshold = 16 * 1024;
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "SmallLate", smallDims, smallData, options) >= 0);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "SmallLate") == H5D_CONTIGUOUS);
+
+    double scalar = 0.0;
+    H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Scalar", scalar) >= 0);
+    H5SUPPORT_REQUIRE(scalar == 3.5);
+    for(const auto& datasetName : {"Small", "SmallThreshold", "SmallLate"})
+    {
+      std::vector<int32_t> readData;
+      H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, datasetName, readData) >= 0);
+      H5SUPPORT_REQUIRE(readData == smallData);
+    }
+    std::vector<int32_t> readData;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Large", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == largeData);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  haddr_t getObjectAddress(hid_t fileID, const std::string& objectName)
+  {
+    H5O_info_t objectInfo{};
+    H5SUPPORT_REQUIRE(H5Oget_info_by_name(fileID, objectName.c_str(), &objectInfo, H5P_DEFAULT) >= 0);
+    return objectInfo.addr;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestReplaceDataset()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::CreationOptionsFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+
+    // Rewriting the same shape reuses the storage so the file does not grow
+    std::vector<double> data(20000);
+    std::vector<hsize_t> dims = {data.size()};
+    H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Checkpoint", 1, dims.data(), data.data()) >= 0);
+    haddr_t address = getObjectAddress(fileID, "Checkpoint");
+    hsize_t fileSize = 0;
+    H5SUPPORT_REQUIRE(H5Fget_filesize(fileID, &fileSize) >= 0);
+    for(int32_t iteration = 0; iteration < 20; iteration++)
+    {
+      std::fill(data.begin(), data.end(), static_cast<double>(iteration));
+      H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Checkpoint", 1, dims.data(), data.data()) >= 0);
+    }
+    hsize_t newFileSize = 0;
+    H5SUPPORT_REQUIRE(H5Fget_filesize(fileID, &newFileSize) >= 0);
+    H5SUPPORT_REQUIRE(newFileSize == fileSize);
+    H5SUPPORT_REQUIRE(getObjectAddress(fileID, "Checkpoint") == address);
+    std::vector<double> readData;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Checkpoint", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+
+    // Extendible datasets grow and shrink in place
+    H5Lite::DatasetCreationOptions options;
+    options.extendible = true;
+    std::vector<int32_t> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+    std::vector<hsize_t> valueDims = {values.size()};
+    H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Resizable", 1, valueDims.data(), values.data(), options) >= 0);
+    address = getObjectAddress(fileID, "Resizable");
+    for(size_t size : {4000, 250, 1000})
+    {
+      values.resize(size);
+      std::iota(values.begin(), values.end(), static_cast<int32_t>(size));
+      valueDims[0] = size;
+      H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Resizable", 1, valueDims.data(), values.data()) >= 0);
+      H5SUPPORT_REQUIRE(getObjectAddress(fileID, "Resizable") == address);
+      std::vector<int32_t> readValues;
+      H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Resizable", readValues) >= 0);
+      H5SUPPORT_REQUIRE(readValues == values);
+    }
+
+    // Contiguous datasets with a new shape or type are created again
+    dims[0] = 100;
+    data.resize(100, 2.5);
+    H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Checkpoint", 1, dims.data(), data.data()) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Checkpoint", readData) >= 0);
+    H5SUPPORT_REQUIRE(readData == data);
+    std::vector<float> floats(100, 1.5f);
+    H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Checkpoint", 1, dims.data(), floats.data()) >= 0);
+    std::vector<float> readFloats;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Checkpoint", readFloats) >= 0);
+    H5SUPPORT_REQUIRE(readFloats == floats);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  hsize_t getStorageSize(hid_t fileID, const std::string& datasetPath)
+  {
+    hid_t datasetID = H5Dopen(fileID, datasetPath.c_str(), H5P_DEFAULT);
+    hsize_t storageSize = H5Dget_storage_size(datasetID);
+    H5Dclose(datasetID);
+    return storageSize;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestRawChunkCopy()
+  {
+    const hsize_t numColumns = 50;
+    std::map<std::string, std::vector<int32_t>> sources;
+    hid_t sourceFileID = H5Utilities::createFile(UnitTest::H5LiteTest::RawCopySourceFile);
+    H5SUPPORT_REQUIRE(sourceFileID > 0);
+    int32_t start = 0;
+    for(const auto& source : std::vector<std::pair<std::string, hsize_t>>{{"A", 100}, {"B", 64}, {"C", 30}})
+    {
+      std::vector<int32_t>& values = sources[source.first];
+      values.resize(source.second * numColumns);
+      std::iota(values.begin(), values.end(), start);
+      start += static_cast<int32_t>(values.size());
+      std::vector<hsize_t> chunks = {source.first == "C" ? 16ULL : 32ULL, numColumns};
+      H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(sourceFileID, source.first, {source.second, numColumns}, values, chunks, 5) >= 0);
+    }
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::RawCopyFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+
+    // The chunks are copied as they are so the copy takes up exactly as much space
+    H5SUPPORT_REQUIRE(H5Lite::copyDatasetRaw(sourceFileID, "A", fileID, "A") >= 0);
+    std::vector<int32_t> values;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "A", values) >= 0);
+    H5SUPPORT_REQUIRE(values == sources["A"]);
+    H5SUPPORT_REQUIRE(getStorageSize(fileID, "A") == getStorageSize(sourceFileID, "A"));
+    hid_t sourceDatasetID = H5Dopen(sourceFileID, "A", H5P_DEFAULT);
+    hid_t datasetID = H5Dopen(fileID, "A", H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(H5Lite::canCopyChunksRaw(sourceDatasetID, datasetID));
+    H5Dclose(datasetID);
+
+    // A different chunk shape needs the data to be decoded and compressed again
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    std::vector<hsize_t> chunks = {10, numColumns};
+    H5SUPPORT_REQUIRE(H5Pset_chunk(dcpl, 2, chunks.data()) >= 0);
+    H5SUPPORT_REQUIRE(H5Pset_deflate(dcpl, 1) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::copyDatasetRaw(sourceFileID, "A", fileID, "Rechunked", dcpl) >= 0);
+    H5Pclose(dcpl);
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Rechunked", values) >= 0);
+    H5SUPPORT_REQUIRE(values == sources["A"]);
+    datasetID = H5Dopen(fileID, "Rechunked", H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(!H5Lite::canCopyChunksRaw(sourceDatasetID, datasetID));
+    H5Dclose(datasetID);
+    H5Dclose(sourceDatasetID);
+
+    // B and A start on chunk boundaries, C has a different chunk shape and the last B is not aligned
+    std::vector<std::pair<hid_t, std::string>> concatenated = {{sourceFileID, "B"}, {sourceFileID, "A"}, {sourceFileID, "C"}, {sourceFileID, "B"}};
+    H5SUPPORT_REQUIRE(H5Lite::concatenateDatasetsRaw(concatenated, fileID, "Merged") >= 0);
+    std::vector<int32_t> expected;
+    for(const auto& source : concatenated)
+    {
+      expected.insert(expected.end(), sources[source.second].begin(), sources[source.second].end());
+    }
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Merged", values) >= 0);
+    H5SUPPORT_REQUIRE(values == expected);
+    std::vector<hsize_t> dims;
+    H5T_class_t classType = H5T_NO_CLASS;
+    size_t typeSize = 0;
+    H5SUPPORT_REQUIRE(H5Lite::getDatasetInfo(fileID, "Merged", dims, classType, typeSize) >= 0);
+    H5SUPPORT_REQUIRE(dims.size() == 2 && dims[0] == 258 && dims[1] == numColumns);
+
+    // Datasets with a different number of columns can not be concatenated
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(sourceFileID, "Narrow", {10, 5}, std::vector<int32_t>(50, 1)) >= 0);
+    HDF_ERROR_HANDLER_OFF
+    herr_t error = H5Lite::concatenateDatasetsRaw({{sourceFileID, "A"}, {sourceFileID, "Narrow"}}, fileID, "Invalid");
+    HDF_ERROR_HANDLER_ON
+    H5SUPPORT_REQUIRE(error < 0);
+    H5SUPPORT_REQUIRE(!H5Lite::datasetExists(fileID, "Invalid"));
+
+    // Chunks of variable length strings hold global heap ids of the source file, so they are copied element by element
+    const std::vector<std::string> strings = {"Alpha", "Beta", "A somewhat longer string", "", "Delta", "Epsilon", "Zeta"};
+    std::vector<const char*> stringPointers;
+    for(const auto& value : strings)
+    {
+      stringPointers.push_back(value.c_str());
+    }
+    hid_t stringTypeID = H5Tcopy(H5T_C_S1);
+    H5SUPPORT_REQUIRE(H5Tset_size(stringTypeID, H5T_VARIABLE) >= 0);
+    std::array<hsize_t, 1> stringDims = {strings.size()};
+    std::array<hsize_t, 1> stringChunks = {4};
+    hid_t stringSpaceID = H5Screate_simple(1, stringDims.data(), nullptr);
+    dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5SUPPORT_REQUIRE(H5Pset_chunk(dcpl, 1, stringChunks.data()) >= 0);
+    hid_t stringDatasetID = H5Dcreate(sourceFileID, "Strings", stringTypeID, stringSpaceID, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(stringDatasetID > 0);
+    H5SUPPORT_REQUIRE(H5Dwrite(stringDatasetID, stringTypeID, H5S_ALL, H5S_ALL, H5P_DEFAULT, stringPointers.data()) >= 0);
+    H5Dclose(stringDatasetID);
+    H5Pclose(dcpl);
+    H5Sclose(stringSpaceID);
+    H5Tclose(stringTypeID);
+    H5SUPPORT_REQUIRE(H5Lite::copyDatasetRaw(sourceFileID, "Strings", fileID, "Strings") >= 0);
+    sourceDatasetID = H5Dopen(sourceFileID, "Strings", H5P_DEFAULT);
+    datasetID = H5Dopen(fileID, "Strings", H5P_DEFAULT);
+    H5SUPPORT_REQUIRE(!H5Lite::canCopyChunksRaw(sourceDatasetID, datasetID));
+    H5Dclose(datasetID);
+    H5Dclose(sourceDatasetID);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    fileID = H5Utilities::openFile(UnitTest::H5LiteTest::RawCopyFile, true);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<std::string> copiedStrings;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorOfStringDataset(fileID, "Strings", copiedStrings) >= 0);
+    H5SUPPORT_REQUIRE(copiedStrings == strings);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(sourceFileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestMultiDatasetIO()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::MultiDatasetFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    hid_t groupID = H5Utilities::createGroup(fileID, "Record");
+    H5SUPPORT_REQUIRE(groupID > 0);
+
+    std::vector<float> positions(300);
+    std::iota(positions.begin(), positions.end(), 0.5f);
+    std::vector<double> velocities(100, 2.5);
+    std::vector<int64_t> ids(100);
+    std::iota(ids.begin(), ids.end(), 1000);
+    std::vector<H5Lite::DatasetBuffer> datasets = {H5Lite::makeDatasetBuffer("Positions", positions, {100, 3}), H5Lite::makeDatasetBuffer("Velocities", velocities),
+                                                   H5Lite::makeDatasetBuffer("Ids", ids)};
+    H5SUPPORT_REQUIRE(H5Lite::writeDatasets(groupID, datasets) >= 0);
+
+    std::vector<float> readPositions;
+    std::vector<double> readVelocities;
+    std::vector<int64_t> readIds;
+    std::vector<H5Lite::DatasetBuffer> reads = {H5Lite::makeDatasetBuffer("Record/Positions", readPositions), H5Lite::makeDatasetBuffer("Record/Velocities", readVelocities),
+                                                H5Lite::makeDatasetBuffer("Record/Ids", readIds)};
+    H5SUPPORT_REQUIRE(H5Lite::readDatasets(fileID, reads) >= 0);
+    H5SUPPORT_REQUIRE(readPositions == positions);
+    H5SUPPORT_REQUIRE(readVelocities == velocities);
+    H5SUPPORT_REQUIRE(readIds == ids);
+    H5SUPPORT_REQUIRE(reads[0].dims == std::vector<hsize_t>({100, 3}));
+
+    // Fixed size buffers have to be large enough and the datasets are converted to the buffer type
+    std::array<int32_t, 100> fixedIds = {0};
+    H5Lite::DatasetBuffer fixed;
+    fixed.name = "Ids";
+    fixed.dataType = H5T_NATIVE_INT32;
+    fixed.data = fixedIds.data();
+    fixed.numElements = 99;
+    std::vector<H5Lite::DatasetBuffer> fixedReads = {fixed};
+    H5SUPPORT_REQUIRE(H5Lite::readDatasets(groupID, fixedReads) < 0);
+    fixedReads[0].numElements = fixedIds.size();
+    H5SUPPORT_REQUIRE(H5Lite::readDatasets(groupID, fixedReads) >= 0);
+    H5SUPPORT_REQUIRE(fixedIds[0] == 1000 && fixedIds[99] == 1099);
+
+    // Writing a dataset that already exists fails
+    HDF_ERROR_HANDLER_OFF
+    herr_t error = H5Lite::writeDatasets(groupID, {H5Lite::makeDatasetBuffer("Ids", ids)});
+    std::vector<H5Lite::DatasetBuffer> missing = {H5Lite::makeDatasetBuffer("Missing", readIds)};
+    herr_t missingError = H5Lite::readDatasets(groupID, missing);
+    HDF_ERROR_HANDLER_ON
+    H5SUPPORT_REQUIRE(error < 0);
+    H5SUPPORT_REQUIRE(missingError < 0);
+
+    H5Gclose(groupID);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestPointSelection()
+  {
+    const hsize_t numRows = 1000;
+    const hsize_t numColumns = 200;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::PointsFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> values(numRows * numColumns);
+    std::iota(values.begin(), values.end(), 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Chunked", {numRows, numColumns}, values, {100, 50}, 1) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Contiguous", {values.size()}, values) >= 0);
+
+    // Scattered points, including a duplicate, come back in the order they were asked for
+    std::vector<hsize_t> coords;
+    uint32_t seed = 12345;
+    for(int32_t i = 0; i < 500; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      coords.push_back((seed >> 8) % numRows);
+      seed = seed * 1103515245 + 12345;
+      coords.push_back((seed >> 8) % numColumns);
+    }
+    coords.push_back(coords[0]);
+    coords.push_back(coords[1]);
+    std::vector<int32_t> points;
+    H5SUPPORT_REQUIRE(H5Lite::readPoints(fileID, "Chunked", coords, points) >= 0);
+    H5SUPPORT_REQUIRE(points.size() == coords.size() / 2);
+    for(size_t i = 0; i < points.size(); i++)
+    {
+      H5SUPPORT_REQUIRE(points[i] == static_cast<int32_t>(coords[2 * i] * numColumns + coords[2 * i + 1]));
+    }
+
+    std::vector<hsize_t> indices = {199999, 5, 100000, 5};
+    std::vector<double> converted;
+    H5SUPPORT_REQUIRE(H5Lite::readPoints(fileID, "Contiguous", indices, converted) >= 0);
+    H5SUPPORT_REQUIRE(converted == std::vector<double>({199999.0, 5.0, 100000.0, 5.0}));
+
+    // The last value given for a point is the one that gets written
+    std::vector<hsize_t> writeCoords = {999, 199, 0, 0, 500, 100, 0, 0};
+    H5SUPPORT_REQUIRE(H5Lite::writePoints(fileID, "Chunked", writeCoords, std::vector<int32_t>{-1, -2, -3, -4}) >= 0);
+    std::vector<int32_t> readValues;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Chunked", readValues) >= 0);
+    values[values.size() - 1] = -1;
+    values[0] = -4;
+    values[500 * numColumns + 100] = -3;
+    H5SUPPORT_REQUIRE(readValues == values);
+
+    // Points outside of the dataset and coordinates that do not match the rank are errors
+    HDF_ERROR_HANDLER_OFF
+    herr_t outsideError = H5Lite::readPoints(fileID, "Chunked", {numRows, 0}, points);
+    herr_t rankError = H5Lite::readPoints(fileID, "Chunked", {1, 2, 3}, points);
+    HDF_ERROR_HANDLER_ON
+    H5SUPPORT_REQUIRE(outsideError < 0);
+    H5SUPPORT_REQUIRE(rankError < 0);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestReadBatch()
+  {
+    const hsize_t size = 512;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::ReadBatchFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<uint16_t> values(size * size);
+    std::iota(values.begin(), values.end(), 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Image", {size, size}, values, {64, 64}, 1) >= 0);
+
+    // Three overlapping tiles share chunks and are read together, the last tile is read on its own
+    std::vector<std::pair<std::vector<hsize_t>, std::vector<hsize_t>>> regions = {{{0, 0}, {100, 100}}, {{50, 50}, {100, 100}}, {{60, 60}, {10, 10}}, {{400, 450}, {20, 30}}};
+    std::vector<std::vector<uint16_t>> tiles(regions.size());
+    {
+      H5ReadBatch<uint16_t> batch(fileID, "Image");
+      H5SUPPORT_REQUIRE(batch.isValid());
+      for(size_t i = 0; i < regions.size(); i++)
+      {
+        tiles[i].resize(regions[i].second[0] * regions[i].second[1]);
+        H5SUPPORT_REQUIRE(batch.add(regions[i].first, regions[i].second, tiles[i].data()) >= 0);
+      }
+      H5SUPPORT_REQUIRE(batch.size() == regions.size());
+      H5SUPPORT_REQUIRE(batch.execute() >= 0);
+      H5SUPPORT_REQUIRE(batch.numReads() == 2);
+      for(size_t i = 0; i < regions.size(); i++)
+      {
+        const auto& start = regions[i].first;
+        const auto& count = regions[i].second;
+        for(hsize_t row = 0; row < count[0]; row++)
+        {
+          for(hsize_t column = 0; column < count[1]; column++)
+          {
+            H5SUPPORT_REQUIRE(tiles[i][row * count[1] + column] == values[(start[0] + row) * size + start[1] + column]);
+          }
+        }
+      }
+
+      // Regions outside of the dataset are rejected
+      std::vector<uint16_t> tile(100);
+      H5SUPPORT_REQUIRE(batch.add({size - 5, 0}, {10, 10}, tile.data()) < 0);
+      H5SUPPORT_REQUIRE(batch.add({0}, {10}, tile.data()) < 0);
+      batch.clear();
+      H5SUPPORT_REQUIRE(batch.size() == 0);
+    }
+    H5SUPPORT_REQUIRE(H5Fget_obj_count(fileID, H5F_OBJ_DATASET | H5F_OBJ_GROUP | H5F_OBJ_DATATYPE | H5F_OBJ_ATTR | H5F_OBJ_LOCAL) == 0);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestAsyncWriter()
+  {
+    const int32_t numSteps = 20;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::AsyncWriterFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<std::future<herr_t>> results;
+    {
+      H5AsyncWriter writer(2);
+      std::vector<float> step(1000);
+      for(int32_t i = 0; i < numSteps; i++)
+      {
+        std::fill(step.begin(), step.end(), static_cast<float>(i));
+        // The step buffer is reused right away, so the writer has to take a copy
+        results.push_back(writer.writeVectorDataset(fileID, "Step_" + std::to_string(i), {step.size()}, step));
+        H5SUPPORT_REQUIRE(writer.pending() <= 3);
+      }
+      std::vector<int32_t> ids(4096);
+      std::iota(ids.begin(), ids.end(), 0);
+      results.push_back(writer.writeVectorDatasetCompressed(fileID, "Ids", {64, 64}, std::move(ids), {16, 16}, 5));
+      std::array<hsize_t, 1> dims = {3};
+      std::array<double, 3> origin = {1.0, 2.0, 3.0};
+      results.push_back(writer.writePointerDataset(fileID, "Origin", 1, dims.data(), origin.data()));
+      origin.fill(0.0);
+      H5SUPPORT_REQUIRE(writer.flush(fileID) >= 0);
+      H5SUPPORT_REQUIRE(writer.pending() == 0);
+      for(auto& result : results)
+      {
+        H5SUPPORT_REQUIRE(result.get() >= 0);
+      }
+
+      // Failures are reported through the future and the next drain
+      HDF_ERROR_HANDLER_OFF
+      std::future<herr_t> duplicate = writer.writeVectorDataset(fileID, "Origin", {3}, std::vector<double>(3, 0.0));
+      herr_t error = writer.drain();
+      HDF_ERROR_HANDLER_ON
+      H5SUPPORT_REQUIRE(duplicate.get() < 0);
+      H5SUPPORT_REQUIRE(error < 0);
+      H5SUPPORT_REQUIRE(writer.drain() >= 0);
+    }
+
+    for(int32_t i = 0; i < numSteps; i++)
+    {
+      std::vector<float> step;
+      H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Step_" + std::to_string(i), step) >= 0);
+      H5SUPPORT_REQUIRE(step == std::vector<float>(1000, static_cast<float>(i)));
+    }
+    std::vector<int32_t> ids;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Ids", ids) >= 0);
+    H5SUPPORT_REQUIRE(ids.size() == 4096 && ids[4095] == 4095);
+    std::vector<double> origin;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Origin", origin) >= 0);
+    H5SUPPORT_REQUIRE(origin == std::vector<double>({1.0, 2.0, 3.0}));
+
+    // The failed write has not left any object ids open
+    H5SUPPORT_REQUIRE(H5Fget_obj_count(fileID, H5F_OBJ_DATASET | H5F_OBJ_GROUP | H5F_OBJ_DATATYPE | H5F_OBJ_ATTR | H5F_OBJ_LOCAL) == 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  template <typename T>
+  void checkPrefetchedBlocks(H5PrefetchReader<T>& reader, const std::vector<T>& values, hsize_t numColumns)
+  {
+    const std::vector<T>* data = nullptr;
+    size_t numBlocks = 0;
+    for(int64_t index = reader.next(data); index >= 0; index = reader.next(data))
+    {
+      H5SUPPORT_REQUIRE(static_cast<size_t>(index) == numBlocks);
+      const auto& block = reader.block(index);
+      H5SUPPORT_REQUIRE(data->size() == block.count[0] * block.count[1]);
+      for(hsize_t row = 0; row < block.count[0]; row++)
+      {
+        for(hsize_t column = 0; column < block.count[1]; column++)
+        {
+          H5SUPPORT_REQUIRE((*data)[row * block.count[1] + column] == values[(block.start[0] + row) * numColumns + block.start[1] + column]);
+        }
+      }
+      numBlocks++;
+    }
+    H5SUPPORT_REQUIRE(data == nullptr);
+    H5SUPPORT_REQUIRE(numBlocks == reader.numBlocks());
+    H5SUPPORT_REQUIRE(reader.error() >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestPrefetchReader()
+  {
+    const hsize_t numRows = 1000;
+    const hsize_t numColumns = 300;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::PrefetchFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> values(numRows * numColumns);
+    std::iota(values.begin(), values.end(), 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Chunked", {numRows, numColumns}, values, {100, 128}, 1) >= 0);
+
+    // Chunked datasets are handed out chunk by chunk, including the clipped chunks at the edge
+    {
+      H5PrefetchReader<int32_t> reader(fileID, "Chunked", 3);
+      H5SUPPORT_REQUIRE(reader.isValid());
+      H5SUPPORT_REQUIRE(reader.numBlocks() == 30);
+      checkPrefetchedBlocks(reader, values, numColumns);
+    }
+
+    // Blocks of rows with a single buffer ahead
+    {
+      H5PrefetchReader<int32_t> reader(fileID, "Chunked", H5PrefetchReader<int32_t>::rowBlocks({numRows, numColumns}, 64), 1);
+      H5SUPPORT_REQUIRE(reader.numBlocks() == 16);
+      checkPrefetchedBlocks(reader, values, numColumns);
+    }
+
+    // Stopping part way through does not wait for the remaining blocks
+    {
+      H5PrefetchReader<int32_t> reader(fileID, "Chunked", 2);
+      const std::vector<int32_t>* data = nullptr;
+      H5SUPPORT_REQUIRE(reader.next(data) == 0);
+      H5SUPPORT_REQUIRE(reader.next(data) == 1);
+    }
+
+    {
+      HDF_ERROR_HANDLER_OFF
+      H5PrefetchReader<int32_t> missing(fileID, "Missing");
+      HDF_ERROR_HANDLER_ON
+      const std::vector<int32_t>* data = nullptr;
+      H5SUPPORT_REQUIRE(!missing.isValid());
+      H5SUPPORT_REQUIRE(missing.next(data) < 0);
+    }
+
+    // Every reader has closed its dataset again
+    H5SUPPORT_REQUIRE(H5Fget_obj_count(fileID, H5F_OBJ_DATASET | H5F_OBJ_GROUP | H5F_OBJ_DATATYPE | H5F_OBJ_ATTR | H5F_OBJ_LOCAL) == 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestPipeline()
+  {
+    const hsize_t numRows = 700;
+    const hsize_t numColumns = 300;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::PipelineFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> values(numRows * numColumns);
+    std::iota(values.begin(), values.end(), 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Input", {numRows, numColumns}, values, {100, 100}, 1) >= 0);
+
+    using Block = H5PrefetchReader<int32_t>::Block;
+    std::atomic<size_t> numBlocks(0);
+    auto halve = [&numBlocks](const Block& /*block*/, const std::vector<int32_t>& input, std::vector<float>& output) -> herr_t {
+      output.resize(input.size());
+      std::transform(input.begin(), input.end(), output.begin(), [](int32_t value) { return static_cast<float>(value) * 0.5f; });
+      numBlocks++;
+      return 0;
+    };
+    H5Pipeline::Config config;
+    config.numThreads = 4;
+    config.queueDepth = 3;
+    config.chunkDims = {64, 300};
+    config.compressionLevel = 3;
+    H5SUPPORT_REQUIRE((H5Pipeline::transformDataset<int32_t, float>(fileID, "Input", fileID, "Output", halve, config)) >= 0);
+    H5SUPPORT_REQUIRE(numBlocks == 11);
+
+    std::vector<float> output;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Output", output) >= 0);
+    H5SUPPORT_REQUIRE(output.size() == values.size());
+    for(size_t i = 0; i < values.size(); i++)
+    {
+      H5SUPPORT_REQUIRE(output[i] == static_cast<float>(values[i]) * 0.5f);
+    }
+    hid_t datasetID = H5Dopen(fileID, "Output", H5P_DEFAULT);
+    hid_t dcpl = H5Dget_create_plist(datasetID);
+    std::array<hsize_t, 2> chunkDims = {0, 0};
+    H5SUPPORT_REQUIRE(H5Pget_chunk(dcpl, 2, chunkDims.data()) == 2);
+    H5SUPPORT_REQUIRE(chunkDims[0] == 64 && chunkDims[1] == 300);
+    H5SUPPORT_REQUIRE(H5Pget_nfilters(dcpl) == 1);
+    H5Pclose(dcpl);
+    H5Dclose(datasetID);
+
+    // A failing transform stops the pipeline
+    auto fail = [](const Block& block, const std::vector<int32_t>& input, std::vector<int32_t>& output) -> herr_t {
+      output = input;
+      return block.start[0] >= 300 ? -1 : 0;
+    };
+    H5SUPPORT_REQUIRE((H5Pipeline::transformDataset<int32_t, int32_t>(fileID, "Input", fileID, "Failed", fail)) < 0);
+
+    // Neither the finished nor the failed transform has left any object ids open
+    H5SUPPORT_REQUIRE(H5Fget_obj_count(fileID, H5F_OBJ_DATASET | H5F_OBJ_GROUP | H5F_OBJ_DATATYPE | H5F_OBJ_ATTR | H5F_OBJ_LOCAL) == 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestLazyDataset()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::LazyDatasetFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<float> volume(40 * 30 * 20);
+    std::iota(volume.begin(), volume.end(), 0.0f);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Volume", {40, 30, 20}, volume, {10, 10, 10}, 1) >= 0);
+    std::vector<double> image(3000 * 700);
+    std::iota(image.begin(), image.end(), 0.0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Image", {3000, 700}, image) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Scalar", 5) >= 0);
+
+    {
+      // Chunked datasets are cached chunk by chunk
+      const size_t chunkBytes = 10 * 10 * 10 * sizeof(float);
+      H5LazyDataset<float> lazy(fileID, "Volume", 4 * chunkBytes);
+      H5SUPPORT_REQUIRE(lazy.isValid());
+      H5SUPPORT_REQUIRE(lazy.size() == volume.size());
+      H5SUPPORT_REQUIRE(lazy.blockDims() == std::vector<hsize_t>({10, 10, 10}));
+      for(hsize_t i = 0; i < 10; i++)
+      {
+        for(hsize_t j = 0; j < 10; j++)
+        {
+          for(hsize_t k = 0; k < 10; k++)
+          {
+            H5SUPPORT_REQUIRE(lazy(i, j, k) == volume[(i * 30 + j) * 20 + k]);
+          }
+        }
+      }
+      H5SUPPORT_REQUIRE(lazy.statistics().misses == 1);
+      H5SUPPORT_REQUIRE(lazy.statistics().hits == 999);
+
+      // Only four chunks fit, so the fifth one pushes out the least recently used
+      for(size_t index : {6000, 12000, 18000, 200})
+      {
+        H5SUPPORT_REQUIRE(lazy[index] == volume[index]);
+      }
+      H5SUPPORT_REQUIRE(lazy.statistics().evictions == 1);
+      H5SUPPORT_REQUIRE(lazy.statistics().cachedBytes == 4 * chunkBytes);
+      H5SUPPORT_REQUIRE(lazy[volume.size() - 1] == volume.back());
+
+      float value = 0.0f;
+      HDF_ERROR_HANDLER_OFF
+      H5SUPPORT_REQUIRE(lazy.get({40, 0, 0}, value) < 0);
+      H5SUPPORT_REQUIRE(lazy.get({0, 0}, value) < 0);
+      HDF_ERROR_HANDLER_ON
+      H5SUPPORT_REQUIRE(lazy(1, 2) == 0.0f);
+    }
+
+    {
+      // Contiguous datasets are cached in blocks of about 1 MB along the fastest dimensions
+      H5LazyDataset<double> lazy(fileID, "Image", 8 * 1024 * 1024);
+      H5SUPPORT_REQUIRE(lazy.blockDims()[1] == 700);
+      H5SUPPORT_REQUIRE(lazy.blockDims()[0] * 700 * sizeof(double) <= 1024 * 1024);
+      H5SUPPORT_REQUIRE(lazy.prefetch({100, 0}, {1000, 700}) >= 0);
+      const size_t prefetched = lazy.statistics().prefetched;
+      H5SUPPORT_REQUIRE(prefetched > 1);
+      for(size_t row = 100; row < 1100; row += 37)
+      {
+        H5SUPPORT_REQUIRE(lazy(row, row % 700) == image[row * 700 + row % 700]);
+      }
+      H5SUPPORT_REQUIRE(lazy.statistics().misses == 0);
+
+      // Prefetching stops once the cache is full
+      H5SUPPORT_REQUIRE(lazy.prefetch({0, 0}, {3000, 700}) >= 0);
+      H5SUPPORT_REQUIRE(lazy.statistics().cachedBytes <= 8 * 1024 * 1024);
+      lazy.clearCache();
+      H5SUPPORT_REQUIRE(lazy.statistics().cachedBytes == 0);
+      H5SUPPORT_REQUIRE(lazy[image.size() - 1] == image.back());
+    }
+
+    {
+      H5LazyDataset<int32_t> scalar(fileID, "Scalar");
+      H5SUPPORT_REQUIRE(scalar[0] == 5);
+      HDF_ERROR_HANDLER_OFF
+      H5LazyDataset<int32_t> missing(fileID, "Missing");
+      HDF_ERROR_HANDLER_ON
+      H5SUPPORT_REQUIRE(!missing.isValid());
+      H5SUPPORT_REQUIRE(missing.size() == 0);
+    }
+
+    // Every lazy dataset has closed its dataset again
+    H5SUPPORT_REQUIRE(H5Fget_obj_count(fileID, H5F_OBJ_DATASET | H5F_OBJ_GROUP | H5F_OBJ_DATATYPE | H5F_OBJ_ATTR | H5F_OBJ_LOCAL) == 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestMemoryBudget()
+  {
+    {
+      // Reservations that do not fit fail right away with the fail fast policy
+      H5MemoryBudget budget(1000, H5MemoryBudget::Policy::FailFast);
+      H5MemoryBudget::Reservation first(600, budget);
+      H5SUPPORT_REQUIRE(first.isValid());
+      H5MemoryBudget::Reservation second(600, budget);
+      H5SUPPORT_REQUIRE(!second.isValid());
+      H5SUPPORT_REQUIRE(!H5MemoryBudget::Reservation::tryReserve(401, budget).isValid());
+      H5SUPPORT_REQUIRE(H5MemoryBudget::Reservation::tryReserve(400, budget).isValid());
+      H5SUPPORT_REQUIRE(budget.current() == 600);
+      H5SUPPORT_REQUIRE(budget.peak() == 1000);
+      first.release();
+      H5SUPPORT_REQUIRE(budget.current() == 0);
+      budget.resetPeak();
+      H5SUPPORT_REQUIRE(budget.peak() == 0);
+      H5SUPPORT_REQUIRE(budget.numDenied() == 1);
+    }
+
+    {
+      // With the blocking policy a reservation waits until enough bytes are released
+      H5MemoryBudget budget(1000, H5MemoryBudget::Policy::Block);
+      H5MemoryBudget::Reservation held(800, budget);
+      auto waiting = std::async(std::launch::async, [&budget]() { return H5MemoryBudget::Reservation(400, budget).isValid(); });
+      while(budget.numWaits() == 0)
+      {
+        std::this_thread::yield();
+      }
+      H5SUPPORT_REQUIRE(budget.current() == 800);
+      held.release();
+      H5SUPPORT_REQUIRE(waiting.get());
+      H5SUPPORT_REQUIRE(budget.current() == 0);
+      H5SUPPORT_REQUIRE(budget.peak() == 800);
+
+      // A reservation larger than the whole limit can never fit
+      H5SUPPORT_REQUIRE(!H5MemoryBudget::Reservation(1001, budget).isValid());
+    }
+
+    // Readers and writers reserve their buffers against the global budget
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::MemoryBudgetFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> small(100, 1);
+    std::vector<int32_t> large(10000, 2);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Small", {small.size()}, small) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Large", {large.size()}, large) >= 0);
+
+    H5MemoryBudget& budget = H5MemoryBudget::global();
+    budget.setLimit(4096);
+    budget.setPolicy(H5MemoryBudget::Policy::FailFast);
+    budget.resetPeak();
+    std::vector<int32_t> data;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Small", data) >= 0);
+    H5SUPPORT_REQUIRE(data == small);
+    H5SUPPORT_REQUIRE(budget.peak() == small.size() * sizeof(int32_t));
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Large", data) < 0);
+    {
+      H5AsyncWriter writer;
+      H5SUPPORT_REQUIRE(writer.writeVectorDataset(fileID, "Rejected", {large.size()}, large).get() < 0);
+      H5SUPPORT_REQUIRE(writer.writeVectorDataset(fileID, "Accepted", {small.size()}, small).get() >= 0);
+    }
+    H5SUPPORT_REQUIRE(budget.current() == 0);
+    budget.setLimit(0);
+    budget.setPolicy(H5MemoryBudget::Policy::Block);
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Large", data) >= 0);
+    H5SUPPORT_REQUIRE(data == large);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestSplitTransfers()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5LiteTest::SplitTransferFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<int32_t> values(1000 * 250);
+    std::iota(values.begin(), values.end(), 0);
+    const uint64_t totalBytes = values.size() * sizeof(int32_t);
+    std::vector<uint64_t> progress;
+    H5Lite::TransferOptions transfer;
+    transfer.splitThreshold = 64 * 1024;
+    transfer.slabSize = 100 * 1024;
+    transfer.conversionBufferSize = 4096;
+    transfer.progress = [&progress](uint64_t bytesDone, uint64_t bytesTotal) {
+      H5SUPPORT_REQUIRE(bytesDone <= bytesTotal);
+      progress.push_back(bytesDone);
+    };
+
+    // 102 rows of 1000 bytes fit into a slab
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Split", {1000, 250}, values, H5Lite::DatasetCreationOptions(), transfer) >= 0);
+    H5SUPPORT_REQUIRE(progress.size() == 10);
+    H5SUPPORT_REQUIRE(progress.front() == 102 * 1000);
+    H5SUPPORT_REQUIRE(progress.back() == totalBytes);
+    H5SUPPORT_REQUIRE(std::is_sorted(progress.begin(), progress.end()));
+
+    // Reading converts the type slab by slab through the small conversion buffer. Slabs are
+    // sized in memory bytes, so twice as many are needed for doubles.
+    progress.clear();
+    std::vector<double> converted(values.size());
+    H5SUPPORT_REQUIRE(H5Lite::readPointerDataset(fileID, "Split", converted.data(), transfer) >= 0);
+    H5SUPPORT_REQUIRE(progress.size() == 20);
+    for(size_t i = 0; i < values.size(); i++)
+    {
+      H5SUPPORT_REQUIRE(converted[i] == static_cast<double>(values[i]));
+    }
+
+    progress.clear();
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Compressed", {1000, 250}, values, {50, 250}, 1, H5Lite::DatasetCreationOptions(), transfer) >= 0);
+    H5SUPPORT_REQUIRE(progress.size() == 10);
+    std::vector<int32_t> data;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Compressed", data) >= 0);
+    H5SUPPORT_REQUIRE(data == values);
+
+    // Transfers below the threshold are done in one piece
+    progress.clear();
+    transfer.splitThreshold = totalBytes;
+    H5SUPPORT_REQUIRE(H5Lite::readPointerDataset(fileID, "Split", data.data(), transfer) >= 0);
+    H5SUPPORT_REQUIRE(progress.size() == 1);
+    H5SUPPORT_REQUIRE(data == values);
+
+    // Cancelling stops the transfer before the next slab
+    progress.clear();
+    transfer.splitThreshold = 64 * 1024;
+    transfer.cancel = [&progress]() { return progress.size() == 3; };
+    H5SUPPORT_REQUIRE(H5Lite::readPointerDataset(fileID, "Split", converted.data(), transfer) < 0);
+    H5SUPPORT_REQUIRE(progress.size() == 3);
+
+    // A cancelled write removes its partly written dataset instead of leaving undefined rows behind
+    progress.clear();
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Cancelled", {1000, 250}, values, H5Lite::DatasetCreationOptions(), transfer) < 0);
+    H5SUPPORT_REQUIRE(progress.size() == 3);
+    H5SUPPORT_REQUIRE(H5Lexists(fileID, "Cancelled", H5P_DEFAULT) == 0);
+    progress.clear();
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "CancelledCompressed", {1000, 250}, values, {50, 250}, 1, H5Lite::DatasetCreationOptions(), transfer) < 0);
+    H5SUPPORT_REQUIRE(progress.size() == 3);
+    H5SUPPORT_REQUIRE(H5Lexists(fileID, "CancelledCompressed", H5P_DEFAULT) == 0);
+
+    // The name is free again once the write is not cancelled
+    transfer.cancel = nullptr;
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Cancelled", {1000, 250}, values, H5Lite::DatasetCreationOptions(), transfer) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Cancelled", data) >= 0);
+    H5SUPPORT_REQUIRE(data == values);
+
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
   // -----------------------------------------------------------------------------
   //
   // -----------------------------------------------------------------------------
@@ -991,6 +1942,19 @@ public:
     H5SUPPORT_REGISTER_TEST(TestVLengStringReadWrite())
     H5SUPPORT_REGISTER_TEST(TestTypeDetection())
     H5SUPPORT_REGISTER_TEST(Test())
+    H5SUPPORT_REGISTER_TEST(TestDatasetCreationOptions())
+    H5SUPPORT_REGISTER_TEST(TestCompactLayout())
+    H5SUPPORT_REGISTER_TEST(TestReplaceDataset())
+    H5SUPPORT_REGISTER_TEST(TestRawChunkCopy())
+    H5SUPPORT_REGISTER_TEST(TestMultiDatasetIO())
+    H5SUPPORT_REGISTER_TEST(TestPointSelection())
+    H5SUPPORT_REGISTER_TEST(TestReadBatch())
+    H5SUPPORT_REGISTER_TEST(TestAsyncWriter())
+    H5SUPPORT_REGISTER_TEST(TestPrefetchReader())
+    H5SUPPORT_REGISTER_TEST(TestPipeline())
+    H5SUPPORT_REGISTER_TEST(TestLazyDataset())
+    H5SUPPORT_REGISTER_TEST(TestMemoryBudget())
+    H5SUPPORT_REGISTER_TEST(TestSplitTransfers())
     H5SUPPORT_REGISTER_TEST(RemoveTestFiles())
   }
 };
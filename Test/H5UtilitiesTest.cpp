@@ -32,15 +32,24 @@
  *
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+#include <array>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <list>
+#include <numeric>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "H5Support/H5BulkLoadSession.h"
+#include "H5Support/H5FilePool.h"
 #include "H5Support/H5Lite.h"
+#include "H5Support/H5ParallelDatasetLoader.h"
+#include "H5Support/H5ReadFarm.h"
 #include "H5Support/H5Utilities.h"
 
 #include "H5SupportTestHelper.h"
@@ -71,6 +80,8 @@ public:
   H5UtilitiesTest& operator=(const H5UtilitiesTest&) = delete; // Copy Assignment Not Implemented
   H5UtilitiesTest& operator=(H5UtilitiesTest&&) = delete;      // Move Assignment Not Implemented
 
+  static constexpr int32_t k_NumScanFiles = 24;
+
   // -----------------------------------------------------------------------------
   //
   // -----------------------------------------------------------------------------
@@ -79,6 +90,21 @@ public:
 #if REMOVE_TEST_FILES
     std::remove(UnitTest::H5UtilTest::FileName.c_str());
     std::remove(UnitTest::H5UtilTest::GroupTest.c_str());
+    std::remove(UnitTest::H5UtilTest::PagedFile.c_str());
+    std::remove(UnitTest::H5UtilTest::CacheImageFile.c_str());
+    std::remove(UnitTest::H5UtilTest::BulkLoadFile.c_str());
+    std::remove(UnitTest::H5UtilTest::RepackSourceFile.c_str());
+    std::remove(UnitTest::H5UtilTest::RepackedFile.c_str());
+    std::remove(UnitTest::H5UtilTest::ParallelLoadFile.c_str());
+    std::remove(UnitTest::H5UtilTest::ReadFarmFile.c_str());
+    for(int32_t i = 0; i < k_NumScanFiles; i++)
+    {
+      std::remove((UnitTest::H5UtilTest::ScanFilePrefix + std::to_string(i) + ".h5").c_str());
+    }
+    for(const std::string name : {"A", "B", "C"})
+    {
+      std::remove((UnitTest::H5UtilTest::FilePoolPrefix + name + ".h5").c_str());
+    }
 #endif
   }
 
@@ -220,6 +246,725 @@ public:
     H5SUPPORT_REQUIRE(error == 0);
   }
 
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestPagedFileSpace()
+  {
+    H5Utilities::FileOptions options;
+    options.pagedFileSpace = true;
+    options.fileSpacePageSize = 8192;
+    options.pageBufferSize = 16 * 8192;
+
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5UtilTest::PagedFile, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    for(int32_t i = 0; i < 50; i++)
+    {
+      std::string groupName = "Group_" + std::to_string(i);
+      hid_t groupID = H5Utilities::createGroup(fileID, groupName);
+      H5SUPPORT_REQUIRE(groupID > 0);
+      H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(groupID, "Value", i) >= 0);
+      H5Gclose(groupID);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // The creation properties are stored in the file
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::PagedFile, true);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    hid_t fileCreationPropertyList = H5Fget_create_plist(fileID);
+    H5F_fspace_strategy_t strategy = H5F_FSPACE_STRATEGY_FSM_AGGR;
+    hbool_t persist = 0;
+    hsize_t threshold = 0;
+    hsize_t pageSize = 0;
+    H5SUPPORT_REQUIRE(H5Pget_file_space_strategy(fileCreationPropertyList, &strategy, &persist, &threshold) >= 0);
+    H5SUPPORT_REQUIRE(H5Pget_file_space_page_size(fileCreationPropertyList, &pageSize) >= 0);
+    H5SUPPORT_REQUIRE(strategy == H5F_FSPACE_STRATEGY_PAGE);
+    H5SUPPORT_REQUIRE(persist != 0);
+    H5SUPPORT_REQUIRE(pageSize == 8192);
+    H5Pclose(fileCreationPropertyList);
+    H5Utilities::PageBufferStatistics statistics;
+    H5SUPPORT_REQUIRE(H5Utilities::getPageBufferStatistics(fileID, statistics) < 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Reading through the page buffer
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::PagedFile, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    for(int32_t i = 0; i < 50; i++)
+    {
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Group_" + std::to_string(i) + "/Value", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::getPageBufferStatistics(fileID, statistics) >= 0);
+    H5SUPPORT_REQUIRE(statistics.hits[0] > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Files without paged file space are opened without the page buffer
+    H5Utilities::FileOptions defaultOptions;
+    fileID = H5Utilities::createFile(UnitTest::H5UtilTest::FileName, defaultOptions);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::FileName, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::getPageBufferStatistics(fileID, statistics) < 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // ... and created without one
+    H5Utilities::FileOptions unpagedOptions;
+    unpagedOptions.pageBufferSize = options.pageBufferSize;
+    fileID = H5Utilities::createFile(UnitTest::H5UtilTest::FileName, unpagedOptions);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::getPageBufferStatistics(fileID, statistics) < 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Value", 3) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  int64_t writeGroupsFile(const std::string& filePath, const H5Utilities::FileOptions& options)
+  {
+    hid_t fileID = H5Utilities::createFile(filePath, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    for(int32_t i = 0; i < 200; i++)
+    {
+      hid_t groupID = H5Utilities::createGroup(fileID, "Group_" + std::to_string(i));
+      H5SUPPORT_REQUIRE(groupID > 0);
+      H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(groupID, "Value", i) >= 0);
+      H5Gclose(groupID);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    FILE* file = std::fopen(filePath.c_str(), "rb");
+    H5SUPPORT_REQUIRE(file != nullptr);
+    std::fseek(file, 0, SEEK_END);
+    int64_t fileSize = std::ftell(file);
+    std::fclose(file);
+    return fileSize;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void readGroupsFile(const std::string& filePath, bool readOnly, const H5Utilities::FileOptions& options)
+  {
+    hid_t fileID = H5Utilities::openFile(filePath, readOnly, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::list<std::string> names;
+    H5SUPPORT_REQUIRE(H5Utilities::getGroupObjects(fileID, H5Utilities::CustomHDFDataTypes::Group, names) >= 0);
+    H5SUPPORT_REQUIRE(names.size() == 200);
+    for(int32_t i = 0; i < 200; i++)
+    {
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Group_" + std::to_string(i) + "/Value", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestCacheImage()
+  {
+    H5Utilities::FileOptions defaultOptions;
+    int64_t plainSize = writeGroupsFile(UnitTest::H5UtilTest::CacheImageFile, defaultOptions);
+
+    H5Utilities::FileOptions options;
+    options.generateCacheImage = true;
+    int64_t imageSize = writeGroupsFile(UnitTest::H5UtilTest::CacheImageFile, options);
+    // The image is stored in the file next to the regular metadata
+    H5SUPPORT_REQUIRE(imageSize > plainSize);
+
+    // Read only opens load the image and leave it in place
+    readGroupsFile(UnitTest::H5UtilTest::CacheImageFile, true, defaultOptions);
+    readGroupsFile(UnitTest::H5UtilTest::CacheImageFile, true, defaultOptions);
+
+    // Read write opens consume the image and write a new one when asked to
+    readGroupsFile(UnitTest::H5UtilTest::CacheImageFile, false, options);
+    readGroupsFile(UnitTest::H5UtilTest::CacheImageFile, false, defaultOptions);
+    readGroupsFile(UnitTest::H5UtilTest::CacheImageFile, true, defaultOptions);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  int32_t readGroupsAndCountCacheEntries(const H5Utilities::FileOptions& options)
+  {
+    hid_t fileID = H5Utilities::openFile(UnitTest::H5UtilTest::CacheImageFile, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    for(int32_t i = 0; i < 200; i++)
+    {
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Group_" + std::to_string(i) + "/Value", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+    }
+    H5Utilities::MetadataCacheSize cacheSize;
+    H5SUPPORT_REQUIRE(H5Utilities::getMetadataCacheSize(fileID, cacheSize) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    return cacheSize.numEntries;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestMemoryControls()
+  {
+    writeGroupsFile(UnitTest::H5UtilTest::CacheImageFile, H5Utilities::FileOptions());
+
+    // Closed datasets leave their object headers in the cache unless evict on close is set
+    H5Utilities::FileOptions options;
+    int32_t numEntries = readGroupsAndCountCacheEntries(options);
+    options.evictOnClose = true;
+    int32_t numEntriesEvicted = readGroupsAndCountCacheEntries(options);
+    H5SUPPORT_REQUIRE(numEntriesEvicted < numEntries);
+
+    options.metadataCacheMinSize = 256 * 1024;
+    options.metadataCacheMaxSize = 1024 * 1024;
+    hid_t fileID = H5Utilities::openFile(UnitTest::H5UtilTest::CacheImageFile, true, options);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5Utilities::MetadataCacheSize cacheSize;
+    H5SUPPORT_REQUIRE(H5Utilities::getMetadataCacheSize(fileID, cacheSize) >= 0);
+    H5SUPPORT_REQUIRE(cacheSize.maxSize >= options.metadataCacheMinSize);
+    H5SUPPORT_REQUIRE(cacheSize.maxSize <= options.metadataCacheMaxSize);
+    H5SUPPORT_REQUIRE(cacheSize.currentSize <= cacheSize.maxSize);
+
+    H5SUPPORT_REQUIRE(H5Utilities::resizeMetadataCache(fileID, 64 * 1024, 128 * 1024) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::getMetadataCacheSize(fileID, cacheSize) >= 0);
+    H5SUPPORT_REQUIRE(cacheSize.maxSize <= 128 * 1024);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    H5Utilities::FreeListSizes freeListSizes;
+#if H5_VERSION_GE(1, 10, 7)
+    H5SUPPORT_REQUIRE(H5Utilities::getFreeListSizes(freeListSizes) >= 0);
+#endif
+    H5SUPPORT_REQUIRE(H5Utilities::releaseFreeMemory() >= 0);
+    H5Utilities::FreeListSizes collectedSizes;
+#if H5_VERSION_GE(1, 10, 7)
+    H5SUPPORT_REQUIRE(H5Utilities::getFreeListSizes(collectedSizes) >= 0);
+    H5SUPPORT_REQUIRE(collectedSizes.regular <= freeListSizes.regular);
+    H5SUPPORT_REQUIRE(collectedSizes.block <= freeListSizes.block);
+#endif
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestBulkLoadSession()
+  {
+    const int32_t numGroups = 2000;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5UtilTest::BulkLoadFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    {
+      H5BulkLoadSession session(fileID);
+      H5SUPPORT_REQUIRE(session.isActive());
+      H5AC_cache_config_t cacheConfig;
+      cacheConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+      H5SUPPORT_REQUIRE(H5Fget_mdc_config(fileID, &cacheConfig) >= 0);
+      H5SUPPORT_REQUIRE(cacheConfig.evictions_enabled == 0);
+
+      for(int32_t i = 0; i < numGroups; i++)
+      {
+        hid_t groupID = H5Utilities::createGroup(fileID, "Group_" + std::to_string(i));
+        H5SUPPORT_REQUIRE(groupID > 0);
+        H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(groupID, "Value", i) >= 0);
+        H5SUPPORT_REQUIRE(H5Lite::writeScalarAttribute(groupID, "Value", "Index", i) >= 0);
+        H5Gclose(groupID);
+      }
+    }
+
+    H5AC_cache_config_t cacheConfig;
+    cacheConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    H5SUPPORT_REQUIRE(H5Fget_mdc_config(fileID, &cacheConfig) >= 0);
+    H5SUPPORT_REQUIRE(cacheConfig.evictions_enabled != 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::BulkLoadFile, true);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    for(int32_t i = 0; i < numGroups; i += 97)
+    {
+      std::string datasetPath = "Group_" + std::to_string(i) + "/Value";
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, datasetPath, value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+      value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarAttribute(fileID, datasetPath, "Index", value) >= 0);
+      H5SUPPORT_REQUIRE(value == i);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  H5D_layout_t getDatasetLayout(hid_t fileID, const std::string& datasetPath, int32_t& numFilters)
+  {
+    hid_t datasetID = H5Dopen(fileID, datasetPath.c_str(), H5P_DEFAULT);
+    hid_t dcpl = H5Dget_create_plist(datasetID);
+    H5D_layout_t layout = H5Pget_layout(dcpl);
+    numFilters = H5Pget_nfilters(dcpl);
+    H5Pclose(dcpl);
+    H5Dclose(datasetID);
+    return layout;
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void checkRepackedFile(const std::vector<float>& chunkedData, const std::vector<int32_t>& contiguousData)
+  {
+    hid_t fileID = H5Utilities::openFile(UnitTest::H5UtilTest::RepackedFile, true);
+    H5SUPPORT_REQUIRE(fileID > 0);
+
+    std::vector<float> floats;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Data/Chunked", floats) >= 0);
+    H5SUPPORT_REQUIRE(floats == chunkedData);
+    std::vector<int32_t> ints;
+    H5SUPPORT_REQUIRE(H5Lite::readVectorDataset(fileID, "Data/Contiguous", ints) >= 0);
+    H5SUPPORT_REQUIRE(ints == contiguousData);
+    int32_t scalar = 0;
+    H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(fileID, "Data/Sub/Scalar", scalar) >= 0);
+    H5SUPPORT_REQUIRE(scalar == 42);
+
+    std::string value;
+    H5SUPPORT_REQUIRE(H5Lite::readStringAttribute(fileID, "/", "Version", value) >= 0);
+    H5SUPPORT_REQUIRE(value == "1.0");
+    H5SUPPORT_REQUIRE(H5Lite::readStringAttribute(fileID, "Data", "Description", value) >= 0);
+    H5SUPPORT_REQUIRE(value == "Repack test");
+    H5SUPPORT_REQUIRE(H5Lite::readStringAttribute(fileID, "Data/Chunked", "Units", value) >= 0);
+    H5SUPPORT_REQUIRE(value == "mm");
+    H5SUPPORT_REQUIRE(H5Lite::readStringAttribute(fileID, "Data/Contiguous", "Units", value) >= 0);
+    H5SUPPORT_REQUIRE(value == "count");
+
+    H5SUPPORT_REQUIRE(!H5Utilities::objectExists(fileID, "Scratch"));
+    H5L_info_t linkInfo{};
+    H5SUPPORT_REQUIRE(H5Lget_info(fileID, "SoftLink", &linkInfo, H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(linkInfo.type == H5L_TYPE_SOFT);
+    H5O_info_t objectInfo{};
+    H5O_info_t aliasInfo{};
+    H5SUPPORT_REQUIRE(H5Oget_info_by_name(fileID, "Data/Chunked", &objectInfo, H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(H5Oget_info_by_name(fileID, "HardLink", &aliasInfo, H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(objectInfo.addr == aliasInfo.addr);
+    H5SUPPORT_REQUIRE(objectInfo.rc == 2);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestRepackFile()
+  {
+    std::vector<float> chunkedData(64 * 1024);
+    std::iota(chunkedData.begin(), chunkedData.end(), 0.0f);
+    std::vector<int32_t> contiguousData(16 * 1024);
+    std::iota(contiguousData.begin(), contiguousData.end(), 0);
+
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5UtilTest::RepackSourceFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeStringAttribute(fileID, "/", "Version", "1.0") >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::createGroupsFromPath("Data/Sub", fileID) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeStringAttribute(fileID, "Data", "Description", "Repack test") >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Data/Chunked", {256, 256}, chunkedData, {64, 64}, 5) >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeStringAttribute(fileID, "Data/Chunked", "Units", "mm") >= 0);
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Data/Sub/Scalar", 42) >= 0);
+
+    // Rewriting the dataset with a new shape and deleting a large dataset leaves unused space behind
+    std::vector<int32_t> scratch(256 * 1024, 7);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Scratch", {256, 1024}, scratch) >= 0);
+    for(hsize_t rows = 1; rows <= 16; rows *= 2)
+    {
+      std::array<hsize_t, 2> dims = {rows, contiguousData.size() / rows};
+      H5SUPPORT_REQUIRE(H5Lite::replacePointerDataset(fileID, "Data/Contiguous", 2, dims.data(), contiguousData.data()) >= 0);
+    }
+    H5SUPPORT_REQUIRE(H5Lite::writeStringAttribute(fileID, "Data/Contiguous", "Units", "count") >= 0);
+    H5SUPPORT_REQUIRE(H5Ldelete(fileID, "Scratch", H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(H5Lcreate_soft("/Data/Sub/Scalar", fileID, "SoftLink", H5P_DEFAULT, H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(H5Lcreate_hard(fileID, "Data/Chunked", fileID, "HardLink", H5P_DEFAULT, H5P_DEFAULT) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Keeping the storage of every dataset copies all of them without decoding
+    H5Utilities::RepackOptions options;
+    H5Utilities::RepackStatistics statistics;
+    H5SUPPORT_REQUIRE(H5Utilities::repackFile(UnitTest::H5UtilTest::RepackSourceFile, UnitTest::H5UtilTest::RepackedFile, options, &statistics) >= 0);
+    H5SUPPORT_REQUIRE(statistics.numGroups == 2);
+    H5SUPPORT_REQUIRE(statistics.numDatasets == 3);
+    H5SUPPORT_REQUIRE(statistics.numRawCopies == 3);
+    H5SUPPORT_REQUIRE(statistics.bytesReclaimed > 1024 * 1024);
+    H5SUPPORT_REQUIRE(statistics.destinationSize + statistics.bytesReclaimed == statistics.sourceSize);
+    checkRepackedFile(chunkedData, contiguousData);
+
+    // Removing the filters lets the chunked dataset be stored contiguously
+    options.compressionLevel = 0;
+    options.chunkedToContiguous = true;
+    H5SUPPORT_REQUIRE(H5Utilities::repackFile(UnitTest::H5UtilTest::RepackSourceFile, UnitTest::H5UtilTest::RepackedFile, options, &statistics) >= 0);
+    H5SUPPORT_REQUIRE(statistics.numRawCopies == 2);
+    checkRepackedFile(chunkedData, contiguousData);
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::RepackedFile, true);
+    int32_t numFilters = -1;
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Data/Chunked", numFilters) == H5D_CONTIGUOUS);
+    H5SUPPORT_REQUIRE(numFilters == 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Recompressing chunks the contiguous dataset, small datasets keep their compact layout
+    options.compressionLevel = 9;
+    options.chunkedToContiguous = false;
+    options.numThreads = 4;
+    options.bufferSize = 4096;
+    H5SUPPORT_REQUIRE(H5Utilities::repackFile(UnitTest::H5UtilTest::RepackSourceFile, UnitTest::H5UtilTest::RepackedFile, options, &statistics) >= 0);
+    H5SUPPORT_REQUIRE(statistics.numRawCopies == 1);
+    checkRepackedFile(chunkedData, contiguousData);
+    fileID = H5Utilities::openFile(UnitTest::H5UtilTest::RepackedFile, true);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Data/Chunked", numFilters) == H5D_CHUNKED);
+    H5SUPPORT_REQUIRE(numFilters == 1);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Data/Contiguous", numFilters) == H5D_CHUNKED);
+    H5SUPPORT_REQUIRE(numFilters == 1);
+    H5SUPPORT_REQUIRE(getDatasetLayout(fileID, "Data/Sub/Scalar", numFilters) == H5D_COMPACT);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestParallelDatasetLoader()
+  {
+    const size_t numDatasets = 40;
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5UtilTest::ParallelLoadFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    H5SUPPORT_REQUIRE(H5Utilities::createGroupsFromPath("Model", fileID) >= 0);
+    for(size_t i = 0; i < numDatasets; i++)
+    {
+      std::vector<int32_t> values((i % 7 + 1) * 5000);
+      std::iota(values.begin(), values.end(), static_cast<int32_t>(i));
+      H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Model/Layer_" + std::to_string(i), {values.size()}, values, {1000}, 1) >= 0);
+    }
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    H5ParallelDatasetLoader loader(UnitTest::H5UtilTest::ParallelLoadFile, 4);
+    hbool_t threadSafe = 0;
+    H5is_library_threadsafe(&threadSafe);
+    H5ParallelDatasetLoader::Strategy expectedStrategy = H5ReadFarm::isAvailable() ? H5ParallelDatasetLoader::Strategy::Processes : H5ParallelDatasetLoader::Strategy::Sequential;
+    if(threadSafe != 0)
+    {
+      expectedStrategy = H5ParallelDatasetLoader::Strategy::Threads;
+    }
+    H5SUPPORT_REQUIRE(loader.strategy() == expectedStrategy);
+    H5SUPPORT_REQUIRE(H5ParallelDatasetLoader(UnitTest::H5UtilTest::ParallelLoadFile, 1).strategy() == H5ParallelDatasetLoader::Strategy::Sequential);
+
+    // Returned buffers are sized to the datasets and the post processing sees every dataset once
+    std::vector<std::vector<double>> layers(numDatasets);
+    std::vector<int64_t> sums(numDatasets, 0);
+    std::vector<H5Lite::DatasetBuffer> datasets;
+    for(size_t i = 0; i < numDatasets; i++)
+    {
+      datasets.push_back(H5Lite::makeDatasetBuffer("Model/Layer_" + std::to_string(i), layers[i]));
+    }
+    auto sum = [&sums](H5Lite::DatasetBuffer& dataset) -> herr_t {
+      size_t index = std::stoul(dataset.name.substr(dataset.name.find('_') + 1));
+      const double* values = static_cast<const double*>(dataset.data);
+      sums[index] = static_cast<int64_t>(std::accumulate(values, values + dataset.numElements, 0.0));
+      return 0;
+    };
+    H5SUPPORT_REQUIRE(loader.load(datasets, sum) >= 0);
+    for(size_t i = 0; i < numDatasets; i++)
+    {
+      const int64_t size = static_cast<int64_t>((i % 7 + 1) * 5000);
+      H5SUPPORT_REQUIRE(layers[i].size() == static_cast<size_t>(size));
+      H5SUPPORT_REQUIRE(layers[i].front() == static_cast<double>(i));
+      H5SUPPORT_REQUIRE(datasets[i].dims == std::vector<hsize_t>({static_cast<hsize_t>(size)}));
+      H5SUPPORT_REQUIRE(sums[i] == size * static_cast<int64_t>(i) + size * (size - 1) / 2);
+    }
+
+    // Caller provided buffers have to be large enough
+    std::vector<int32_t> buffer(5000);
+    H5Lite::DatasetBuffer fixed;
+    fixed.name = "Model/Layer_0";
+    fixed.dataType = H5T_NATIVE_INT32;
+    fixed.data = buffer.data();
+    fixed.numElements = buffer.size();
+    std::vector<H5Lite::DatasetBuffer> fixedDatasets = {fixed};
+    H5SUPPORT_REQUIRE(loader.load(fixedDatasets) >= 0);
+    H5SUPPORT_REQUIRE(buffer[4999] == 4999);
+    fixedDatasets[0].name = "Model/Layer_1";
+    H5SUPPORT_REQUIRE(loader.load(fixedDatasets) < 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestReadFarm()
+  {
+    hid_t fileID = H5Utilities::createFile(UnitTest::H5UtilTest::ReadFarmFile);
+    H5SUPPORT_REQUIRE(fileID > 0);
+    std::vector<float> volume(1001 * 30);
+    std::iota(volume.begin(), volume.end(), 0.0f);
+    H5SUPPORT_REQUIRE(H5Lite::writeVectorDatasetCompressed(fileID, "Volume", {1001, 30}, volume, {64, 30}, 1) >= 0);
+    for(size_t i = 0; i < 6; i++)
+    {
+      std::vector<float> values((i + 1) * 1000, static_cast<float>(i));
+      H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Slice_" + std::to_string(i), {values.size()}, values) >= 0);
+    }
+    H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Scalar", 7.0f) >= 0);
+    H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+
+    // Rows of one dataset spread over the workers, including a row count that does not divide evenly
+    H5ReadFarm farm(UnitTest::H5UtilTest::ReadFarmFile, 4);
+    H5SUPPORT_REQUIRE(farm.numProcesses() == 4);
+    std::vector<float> data;
+    H5SUPPORT_REQUIRE(farm.readVectorDataset("Volume", data) >= 0);
+    H5SUPPORT_REQUIRE(data == volume);
+    std::vector<double> converted;
+    H5SUPPORT_REQUIRE(farm.readVectorDataset("Scalar", converted) >= 0);
+    H5SUPPORT_REQUIRE(converted == std::vector<double>({7.0}));
+
+    // A view keeps the values in the memory the workers read them into
+    H5ReadFarm::View<float> view;
+    H5SUPPORT_REQUIRE(farm.readDataset("Volume", view) >= 0);
+    H5SUPPORT_REQUIRE(view.size() == volume.size());
+    H5SUPPORT_REQUIRE(std::equal(view.begin(), view.end(), volume.begin()));
+    H5ReadFarm::View<float> moved = std::move(view);
+    H5SUPPORT_REQUIRE(view.empty() && moved.size() == volume.size() && moved[1000] == volume[1000]);
+
+    // Whole datasets spread over the workers
+    std::vector<std::string> names;
+    for(size_t i = 0; i < 6; i++)
+    {
+      names.push_back("Slice_" + std::to_string(i));
+    }
+    std::vector<std::vector<float>> slices;
+    H5SUPPORT_REQUIRE(farm.readVectorDatasets(names, slices) >= 0);
+    H5SUPPORT_REQUIRE(slices.size() == names.size());
+    for(size_t i = 0; i < slices.size(); i++)
+    {
+      H5SUPPORT_REQUIRE(slices[i] == std::vector<float>((i + 1) * 1000, static_cast<float>(i)));
+    }
+
+    // A single process gives the same result
+    H5ReadFarm single(UnitTest::H5UtilTest::ReadFarmFile, 1);
+    std::vector<float> singleData;
+    H5SUPPORT_REQUIRE(single.readVectorDataset("Volume", singleData) >= 0);
+    H5SUPPORT_REQUIRE(singleData == volume);
+    H5ReadFarm::View<float> singleView;
+    H5SUPPORT_REQUIRE(single.readDataset("Volume", singleView) >= 0);
+    H5SUPPORT_REQUIRE(std::equal(singleView.begin(), singleView.end(), volume.begin()));
+    std::vector<std::vector<float>> singleSlices;
+    H5SUPPORT_REQUIRE(single.readVectorDatasets(names, singleSlices) >= 0);
+    H5SUPPORT_REQUIRE(singleSlices == slices);
+
+    // Dataset buffers may each use their own memory type, as H5ParallelDatasetLoader needs
+    for(H5ReadFarm* reader : {&farm, &single})
+    {
+      std::vector<double> doubles;
+      std::vector<int32_t> integers;
+      std::vector<float> floats;
+      std::vector<H5Lite::DatasetBuffer> buffers = {H5Lite::makeDatasetBuffer("Slice_2", doubles), H5Lite::makeDatasetBuffer("Volume", integers), H5Lite::makeDatasetBuffer("Scalar", floats)};
+      H5SUPPORT_REQUIRE(reader->readDatasets(buffers) >= 0);
+      H5SUPPORT_REQUIRE(doubles == std::vector<double>(3000, 2.0));
+      H5SUPPORT_REQUIRE(integers.size() == volume.size() && integers[1234] == 1234 && integers.back() == static_cast<int32_t>(volume.back()));
+      H5SUPPORT_REQUIRE(floats == std::vector<float>({7.0f}));
+      H5SUPPORT_REQUIRE(buffers[1].dims == std::vector<hsize_t>({1001, 30}));
+    }
+
+    HDF_ERROR_HANDLER_OFF
+    H5SUPPORT_REQUIRE(farm.readVectorDataset("Missing", data) < 0);
+    H5SUPPORT_REQUIRE(farm.readDataset("Missing", view) < 0 && view.empty());
+    names.push_back("Missing");
+    H5SUPPORT_REQUIRE(farm.readVectorDatasets(names, slices) < 0);
+    HDF_ERROR_HANDLER_ON
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestScanFiles()
+  {
+    std::vector<std::string> paths;
+    for(int32_t i = 0; i < k_NumScanFiles; i++)
+    {
+      paths.push_back(UnitTest::H5UtilTest::ScanFilePrefix + std::to_string(i) + ".h5");
+      hid_t fileID = H5Utilities::createFile(paths.back());
+      H5SUPPORT_REQUIRE(fileID > 0);
+      std::vector<int32_t> values(100, i);
+      H5SUPPORT_REQUIRE(H5Lite::writeVectorDataset(fileID, "Values", {values.size()}, values) >= 0);
+      H5SUPPORT_REQUIRE(H5Lite::writeScalarAttribute(fileID, "Values", "Index", i) >= 0);
+      H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    }
+
+    // The visitor summarizes each file into a string that is handed back with the result
+    auto visitor = [](hid_t fileID, const std::string& /*path*/, std::string& value) -> herr_t {
+      int32_t index = -1;
+      std::vector<int32_t> values;
+      herr_t error = H5Lite::readScalarAttribute(fileID, "Values", "Index", index);
+      error = error < 0 ? error : H5Lite::readVectorDataset(fileID, "Values", values);
+      value = std::to_string(index) + ":" + std::to_string(std::accumulate(values.begin(), values.end(), 0));
+      return error;
+    };
+    std::vector<std::string> values(paths.size());
+    std::vector<int32_t> counts(paths.size() + 1, 0);
+    auto collect = [&](const H5Utilities::ScanResult& result) {
+      counts[result.index]++;
+      if(result.error >= 0)
+      {
+        values[result.index] = result.value;
+      }
+    };
+    auto checkValues = [&](int32_t expectedCount) {
+      for(size_t i = 0; i < paths.size(); i++)
+      {
+        H5SUPPORT_REQUIRE(counts[i] == expectedCount);
+        H5SUPPORT_REQUIRE(values[i] == std::to_string(i) + ":" + std::to_string(i * 100));
+      }
+    };
+    H5SUPPORT_REQUIRE(H5Utilities::scanFiles(paths, visitor, collect, 4) >= 0);
+    checkValues(1);
+    H5SUPPORT_REQUIRE(H5Utilities::scanFiles(paths, visitor, collect, 1) >= 0);
+    checkValues(2);
+
+    // Worker processes are what a library that is not thread-safe uses
+#if !defined(_WIN32)
+    hid_t fileAccessPropertyList = H5Utilities::createFileAccessPropertyList(H5Utilities::FileOptions());
+    std::vector<herr_t> fileErrors(paths.size(), 1);
+    H5SUPPORT_REQUIRE(H5Utilities::detail::scanFilesInProcesses(paths, visitor, collect, 3, fileAccessPropertyList, -1, fileErrors) >= 0);
+    H5Pclose(fileAccessPropertyList);
+    H5SUPPORT_REQUIRE(std::all_of(fileErrors.begin(), fileErrors.end(), [](herr_t error) { return error == 0; }));
+    checkValues(3);
+#endif
+
+    // A file that cannot be opened still produces exactly one result
+    paths.push_back(UnitTest::H5UtilTest::ScanFilePrefix + "Missing.h5");
+    H5SUPPORT_REQUIRE(H5Utilities::scanFiles(paths, visitor, collect, 4) < 0);
+    H5SUPPORT_REQUIRE(counts.back() == 1);
+
+    // A failed open or visit leaves nothing on the error stack of the scanning thread, which
+    // would otherwise keep HDF5 from shutting down once that thread has exited
+    std::string value;
+    H5SUPPORT_REQUIRE(H5Utilities::detail::scanFile(paths.back(), H5P_DEFAULT, -1, visitor, value) < 0);
+    H5SUPPORT_REQUIRE(H5Eget_num(H5E_DEFAULT) == 0);
+    auto failingVisitor = [](hid_t fileID, const std::string& /*path*/, std::string& /*value*/) -> herr_t {
+      HDF_ERROR_HANDLER_OFF
+      hid_t datasetID = H5Dopen(fileID, "Missing", H5P_DEFAULT);
+      HDF_ERROR_HANDLER_ON
+      return datasetID < 0 ? -1 : H5Dclose(datasetID);
+    };
+    H5SUPPORT_REQUIRE(H5Utilities::detail::scanFile(paths.front(), H5P_DEFAULT, -1, failingVisitor, value) < 0);
+    H5SUPPORT_REQUIRE(H5Eget_num(H5E_DEFAULT) == 0);
+  }
+
+  // -----------------------------------------------------------------------------
+  //
+  // -----------------------------------------------------------------------------
+  void TestFilePool()
+  {
+    const std::vector<std::string> paths = {UnitTest::H5UtilTest::FilePoolPrefix + "A.h5", UnitTest::H5UtilTest::FilePoolPrefix + "B.h5", UnitTest::H5UtilTest::FilePoolPrefix + "C.h5"};
+    const std::string replacement = UnitTest::H5UtilTest::FilePoolPrefix + "Replacement.h5";
+    auto writeFile = [](const std::string& path, int32_t value) {
+      hid_t fileID = H5Utilities::createFile(path);
+      H5SUPPORT_REQUIRE(fileID > 0);
+      H5SUPPORT_REQUIRE(H5Lite::writeScalarDataset(fileID, "Value", value) >= 0);
+      H5SUPPORT_REQUIRE(H5Utilities::closeFile(fileID) >= 0);
+    };
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+      writeFile(paths[i], static_cast<int32_t>(i));
+    }
+    auto readValue = [](const H5FilePool::Lease& lease) {
+      int32_t value = -1;
+      H5SUPPORT_REQUIRE(H5Lite::readScalarDataset(lease.id(), "Value", value) >= 0);
+      return value;
+    };
+
+    H5FilePool pool(2);
+    {
+      // Leases of the same file share the open file, also when the path is spelled differently
+      H5FilePool::Lease first = pool.acquire(paths[0]);
+      H5SUPPORT_REQUIRE(first.isValid());
+      H5FilePool::Lease second = pool.acquire(UnitTest::TestTempDir + "/./" + H5Utilities::getObjectNameFromPath(paths[0]));
+      H5SUPPORT_REQUIRE(second.id() == first.id());
+      H5SUPPORT_REQUIRE(readValue(second) == 0);
+      H5SUPPORT_REQUIRE(pool.statistics().hits == 1);
+      H5SUPPORT_REQUIRE(pool.statistics().misses == 1);
+    }
+    H5SUPPORT_REQUIRE(pool.size() == 1);
+
+    // Idle files are closed least recently used first once the capacity is reached
+    pool.acquire(paths[1]);
+    pool.acquire(paths[0]);
+    pool.acquire(paths[2]);
+    H5SUPPORT_REQUIRE(pool.size() == 2);
+    H5SUPPORT_REQUIRE(pool.statistics().evictions == 1);
+    H5SUPPORT_REQUIRE(pool.statistics().hits == 2);
+    {
+      // Leased files stay open beyond the capacity
+      std::vector<H5FilePool::Lease> leases;
+      for(const auto& path : paths)
+      {
+        leases.push_back(pool.acquire(path));
+      }
+      H5SUPPORT_REQUIRE(pool.size() == 3);
+    }
+    H5SUPPORT_REQUIRE(pool.size() == 2);
+
+    // A file replaced on disk is opened again while the old lease keeps reading the old file
+    H5FilePool::Lease before = pool.acquire(paths[0]);
+    writeFile(replacement, 42);
+    H5SUPPORT_REQUIRE(std::rename(replacement.c_str(), paths[0].c_str()) == 0);
+    H5FilePool::Lease after = pool.acquire(paths[0]);
+    H5SUPPORT_REQUIRE(after.isValid());
+    H5SUPPORT_REQUIRE(after.id() != before.id());
+    H5SUPPORT_REQUIRE(readValue(after) == 42);
+    H5SUPPORT_REQUIRE(readValue(before) == 0);
+    H5SUPPORT_REQUIRE(pool.statistics().reopens == 1);
+    size_t openFiles = pool.size();
+    before.release();
+    H5SUPPORT_REQUIRE(pool.size() == openFiles - 1);
+
+    // A file rewritten in place keeps its inode and cannot be opened again while it is leased
+    {
+      std::ofstream rewrite(paths[0], std::ios::binary | std::ios::app);
+      rewrite << "Appended in place";
+    }
+    H5SUPPORT_REQUIRE(!pool.acquire(paths[0]).isValid());
+    H5SUPPORT_REQUIRE(readValue(after) == 42);
+    after.release();
+    H5FilePool::Lease rewritten = pool.acquire(paths[0]);
+    H5SUPPORT_REQUIRE(rewritten.isValid());
+    H5SUPPORT_REQUIRE(readValue(rewritten) == 42);
+    H5SUPPORT_REQUIRE(pool.statistics().reopens == 2);
+    rewritten.release();
+
+    pool.clear();
+    H5SUPPORT_REQUIRE(pool.size() == 0);
+
+    // Files are opened without holding the pool lock, so concurrent acquires of a file that is
+    // not open yet may race; only one of them keeps its file and the others share it
+    hbool_t threadSafe = 0;
+    H5is_library_threadsafe(&threadSafe);
+    if(threadSafe != 0)
+    {
+      const H5FilePool::Statistics previous = pool.statistics();
+      std::vector<H5FilePool::Lease> leases(8);
+      std::vector<std::thread> threads;
+      for(auto& lease : leases)
+      {
+        threads.emplace_back([&pool, &lease, &paths]() { lease = pool.acquire(paths[1]); });
+      }
+      for(auto& thread : threads)
+      {
+        thread.join();
+      }
+      for(const auto& lease : leases)
+      {
+        H5SUPPORT_REQUIRE(lease.isValid() && lease.id() == leases.front().id());
+      }
+      H5SUPPORT_REQUIRE(pool.size() == 1);
+      H5SUPPORT_REQUIRE(pool.statistics().misses == previous.misses + 1);
+      H5SUPPORT_REQUIRE(pool.statistics().hits == previous.hits + leases.size() - 1);
+      H5SUPPORT_REQUIRE(readValue(leases.back()) == 1);
+    }
+    pool.clear();
+    H5SUPPORT_REQUIRE(pool.size() == 0);
+    H5SUPPORT_REQUIRE(!pool.acquire(UnitTest::H5UtilTest::FilePoolPrefix + "Missing.h5").isValid());
+  }
+
   // -----------------------------------------------------------------------------
   //
   // -----------------------------------------------------------------------------
@@ -227,6 +972,15 @@ public:
   {
     H5SUPPORT_REGISTER_TEST(Test())
     H5SUPPORT_REGISTER_TEST(TestOpenSameFile2x())
+    H5SUPPORT_REGISTER_TEST(TestPagedFileSpace())
+    H5SUPPORT_REGISTER_TEST(TestCacheImage())
+    H5SUPPORT_REGISTER_TEST(TestMemoryControls())
+    H5SUPPORT_REGISTER_TEST(TestBulkLoadSession())
+    H5SUPPORT_REGISTER_TEST(TestRepackFile())
+    H5SUPPORT_REGISTER_TEST(TestParallelDatasetLoader())
+    H5SUPPORT_REGISTER_TEST(TestReadFarm())
+    H5SUPPORT_REGISTER_TEST(TestScanFiles())
+    H5SUPPORT_REGISTER_TEST(TestFilePool())
     H5SUPPORT_REGISTER_TEST(RemoveTestFiles())
   }
 };
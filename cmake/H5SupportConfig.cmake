@@ -17,6 +17,7 @@ endif()
 
 include(CMakeFindDependencyMacro)
 find_dependency(HDF5 NAMES hdf5)
+find_dependency(Threads)
 
 include("${CMAKE_CURRENT_LIST_DIR}/H5SupportTargets.cmake")
 